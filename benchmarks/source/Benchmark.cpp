@@ -0,0 +1,231 @@
+#include "Benchmark.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#if JUCE_WINDOWS
+ #include <malloc.h>
+#endif
+
+namespace
+{
+	std::atomic<juce::int64> allocationCount{ 0 };
+
+	std::vector<BenchmarkResult>& getResults()
+	{
+		static std::vector<BenchmarkResult> results;
+		return results;
+	}
+
+	juce::StringArray& getFailures()
+	{
+		static juce::StringArray failures;
+		return failures;
+	}
+}
+
+//==============================================================================
+// With glibc, malloc, calloc and realloc are replaced, so every allocation is
+// counted, including the HeapBlocks inside JUCE's AudioBuffers. Elsewhere only
+// operator new is counted, which misses JUCE's own heap blocks.
+#if defined(__GLIBC__)
+extern "C"
+{
+	void* __libc_malloc(size_t size);
+	void* __libc_calloc(size_t count, size_t size);
+	void* __libc_realloc(void* block, size_t size);
+
+	void* malloc(size_t size) __THROW
+	{
+		++allocationCount;
+		return __libc_malloc(size);
+	}
+
+	void* calloc(size_t count, size_t size) __THROW
+	{
+		++allocationCount;
+		return __libc_calloc(count, size);
+	}
+
+	void* realloc(void* block, size_t size) __THROW
+	{
+		++allocationCount;
+		return __libc_realloc(block, size);
+	}
+}
+
+const char* getAllocationCounter()
+{
+	return "malloc";
+}
+#else
+const char* getAllocationCounter()
+{
+	return "operator new";
+}
+#endif
+
+void* operator new(std::size_t size)
+{
+   #if ! defined(__GLIBC__)
+	++allocationCount;
+   #endif
+	if (void* block = std::malloc(size > 0 ? size : 1))
+	{
+		return block;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* block) noexcept
+{
+	std::free(block);
+}
+
+void operator delete[](void* block) noexcept
+{
+	std::free(block);
+}
+
+void operator delete(void* block, std::size_t) noexcept
+{
+	std::free(block);
+}
+
+void operator delete[](void* block, std::size_t) noexcept
+{
+	std::free(block);
+}
+
+// Over-aligned types go through these, which do not call malloc, so they are counted here
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	++allocationCount;
+	size_t align = juce::jmax((size_t) alignment, sizeof(void*));
+   #if JUCE_WINDOWS
+	void* block = _aligned_malloc(size > 0 ? size : 1, align);
+   #else
+	void* block = nullptr;
+	if (posix_memalign(&block, align, size > 0 ? size : 1) != 0)
+	{
+		block = nullptr;
+	}
+   #endif
+	if (block != nullptr)
+	{
+		return block;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void operator delete(void* block, std::align_val_t) noexcept
+{
+   #if JUCE_WINDOWS
+	_aligned_free(block);
+   #else
+	std::free(block);
+   #endif
+}
+
+void operator delete[](void* block, std::align_val_t alignment) noexcept
+{
+	operator delete(block, alignment);
+}
+
+void operator delete(void* block, std::size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(block, alignment);
+}
+
+void operator delete[](void* block, std::size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(block, alignment);
+}
+
+juce::int64 getAllocationCount()
+{
+	return allocationCount;
+}
+
+//==============================================================================
+void printResult(const BenchmarkResult& result)
+{
+	std::cout << result.name << ": mean " << result.meanNs / 1000.0 << " us, p99 "
+			  << result.p99Ns / 1000.0 << " us";
+	if (result.samplesPerRun > 0)
+	{
+		std::cout << ", " << result.meanNs / result.samplesPerRun << " ns/sample";
+	}
+	if (result.allocationsPerRun > 0)
+	{
+		std::cout << ", " << result.allocationsPerRun << " allocations/run";
+	}
+	std::cout << " (" << result.iterations << " runs)" << std::endl;
+
+	getResults().push_back(result);
+}
+
+void reportFailure(const juce::String& message)
+{
+	std::cerr << message << std::endl;
+	getFailures().add(message);
+}
+
+int getNumFailures()
+{
+	return getFailures().size();
+}
+
+bool writeResultsJson(const juce::File& file)
+{
+	juce::Array<juce::var> results;
+	for (const BenchmarkResult& result : getResults())
+	{
+		juce::DynamicObject::Ptr entry = new juce::DynamicObject();
+		entry->setProperty("name", result.name);
+		entry->setProperty("iterations", result.iterations);
+		entry->setProperty("meanNs", result.meanNs);
+		entry->setProperty("p99Ns", result.p99Ns);
+		if (result.samplesPerRun > 0)
+		{
+			entry->setProperty("samplesPerRun", result.samplesPerRun);
+			entry->setProperty("nsPerSample", result.meanNs / result.samplesPerRun);
+		}
+		entry->setProperty("allocationsPerRun", result.allocationsPerRun);
+		results.add(juce::var(entry.get()));
+	}
+
+	// Enough about the machine and build to tell whether two reports are comparable
+	juce::DynamicObject::Ptr report = new juce::DynamicObject();
+	report->setProperty("date", juce::Time::getCurrentTime().toISO8601(true));
+	report->setProperty("cpu", juce::SystemStats::getCpuModel());
+	report->setProperty("os", juce::SystemStats::getOperatingSystemName());
+	report->setProperty("juceVersion", juce::SystemStats::getJUCEVersion());
+   #if JUCE_DEBUG
+	report->setProperty("configuration", "Debug");
+   #else
+	report->setProperty("configuration", "Release");
+   #endif
+	report->setProperty("allocationCounter", getAllocationCounter());
+	report->setProperty("results", results);
+	if (! getFailures().isEmpty())
+	{
+		juce::Array<juce::var> failures;
+		for (const juce::String& failure : getFailures())
+		{
+			failures.add(failure);
+		}
+		report->setProperty("failures", failures);
+	}
+
+	return file.replaceWithText(juce::JSON::toString(juce::var(report.get())));
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <algorithm>
+#include <vector>
+
+// Timing statistics for one benchmark case
+struct BenchmarkResult
+{
+    juce::String name;
+    int iterations = 0;
+    double meanNs = 0.0;
+    double p99Ns = 0.0;
+    // Audio cases set the samples processed per run, so time per sample can be reported
+    int samplesPerRun = 0;
+    double allocationsPerRun = 0.0;
+};
+
+// Number of allocations since the program started, counted as getAllocationCounter() says
+juce::int64 getAllocationCount();
+// "malloc" where every heap allocation is counted, "operator new" where only those are
+const char* getAllocationCounter();
+
+// Call fn(iteration) the given number of times and collect how long each call took
+template <typename Function>
+BenchmarkResult runBenchmark(const juce::String& name, int iterations, Function&& fn)
+{
+    std::vector<double> timesNs;
+    timesNs.reserve((size_t) iterations);
+
+    juce::int64 allocationsBefore = getAllocationCount();
+    for (int i = 0; i < iterations; ++i)
+    {
+        juce::int64 start = juce::Time::getHighResolutionTicks();
+        fn(i);
+        juce::int64 end = juce::Time::getHighResolutionTicks();
+        timesNs.push_back(juce::Time::highResolutionTicksToSeconds(end - start) * 1.0e9);
+    }
+    juce::int64 allocations = getAllocationCount() - allocationsBefore;
+
+    BenchmarkResult result;
+    result.name = name;
+    result.iterations = iterations;
+    result.allocationsPerRun = iterations > 0 ? (double) allocations / iterations : 0.0;
+    if (! timesNs.empty())
+    {
+        std::sort(timesNs.begin(), timesNs.end());
+        double total = 0.0;
+        for (double t : timesNs)
+        {
+            total += t;
+        }
+        result.meanNs = total / timesNs.size();
+        result.p99Ns = timesNs[(size_t) ((timesNs.size() - 1) * 0.99)];
+    }
+    return result;
+}
+
+// Print one line per result to stdout and keep it for the JSON report
+void printResult(const BenchmarkResult& result);
+
+// Print why a benchmark could not measure what it is meant to, and make the run fail
+void reportFailure(const juce::String& message);
+int getNumFailures();
+
+// Write every printed result, with details of the machine, to a JSON file
+bool writeResultsJson(const juce::File& file);
+
+// Plays a block of noise over and over, so the sources cost next to nothing
+class NoiseSource : public juce::AudioSource
+{
+public:
+    NoiseSource(int seed)
+    {
+        juce::Random random(seed);
+        noise.setSize(2, 8192);
+        for (int channel = 0; channel < noise.getNumChannels(); ++channel)
+        {
+            for (int i = 0; i < noise.getNumSamples(); ++i)
+            {
+                noise.setSample(channel, i, random.nextFloat() * 2.0f - 1.0f);
+            }
+        }
+    }
+
+    void prepareToPlay(int, double) override {}
+    void releaseResources() override {}
+
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override
+    {
+        for (int channel = 0; channel < bufferToFill.buffer->getNumChannels(); ++channel)
+        {
+            bufferToFill.buffer->copyFrom(channel, bufferToFill.startSample,
+                                          noise, channel % 2, position, bufferToFill.numSamples);
+        }
+        position = (position + bufferToFill.numSamples) % (noise.getNumSamples() - bufferToFill.numSamples);
+    }
+
+private:
+    juce::AudioBuffer<float> noise;
+    int position = 0;
+};
+
+// Benchmark groups, one per source file
+void runSearchBenchmarks();
+void runMixerBenchmarks();
+void runPlayerBenchmarks();
+void runResamplerBenchmarks();
+void runSeekBenchmarks();
+void runLoudnessBenchmarks();
@@ -0,0 +1,41 @@
+#include "Benchmark.h"
+#include "../../source/LoudnessMeter.h"
+
+namespace
+{
+	const double sampleRate = 48000.0;
+	// The analyser feeds the meter blocks of this size
+	const int blockSize = 16384;
+	const int iterations = 500;
+
+	void printWithSpeed(BenchmarkResult result)
+	{
+		result.samplesPerRun = blockSize;
+		printResult(result);
+		// How much faster than playback a track is measured
+		std::cout << "    " << blockSize / sampleRate * 1.0e9 / result.meanNs << "x realtime" << std::endl;
+	}
+}
+
+void runLoudnessBenchmarks()
+{
+	juce::AudioBuffer<float> noise(2, blockSize);
+	juce::Random random(1);
+	for (int channel = 0; channel < noise.getNumChannels(); ++channel)
+	{
+		for (int i = 0; i < blockSize; ++i)
+		{
+			noise.setSample(channel, i, random.nextFloat() * 2.0f - 1.0f);
+		}
+	}
+
+	for (int numChannels : { 1, 2 })
+	{
+		LoudnessMeter meter(sampleRate, numChannels);
+		juce::String name = numChannels == 1 ? "loudness: measure mono" : "loudness: measure stereo";
+		printWithSpeed(runBenchmark(name, iterations, [&](int)
+		{
+			meter.process(noise.getArrayOfReadPointers(), blockSize);
+		}));
+	}
+}
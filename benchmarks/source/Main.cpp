@@ -0,0 +1,70 @@
+/*
+  ==============================================================================
+
+    Command line benchmarks for the Otodecks library and audio code.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "Benchmark.h"
+
+//==============================================================================
+// Usage: Otodecks_Benchmarks [search] [mixer] [player] [resampler] [seek] [loudness] [--json <file>]
+// With no group names every group runs.
+int main (int argc, char* argv[])
+{
+    // The players start timers, which need a message manager on this thread
+    juce::MessageManager::getInstance();
+
+    juce::StringArray groups;
+    juce::File jsonFile;
+    for (int i = 1; i < argc; ++i)
+    {
+        juce::String arg (argv[i]);
+        if (arg == "--json" && i + 1 < argc)
+        {
+            jsonFile = juce::File::getCurrentWorkingDirectory().getChildFile (argv[++i]);
+        }
+        else
+        {
+            groups.add (arg);
+        }
+    }
+
+    if (groups.isEmpty() || groups.contains ("search"))
+    {
+        runSearchBenchmarks();
+    }
+    if (groups.isEmpty() || groups.contains ("mixer"))
+    {
+        runMixerBenchmarks();
+    }
+    if (groups.isEmpty() || groups.contains ("player"))
+    {
+        runPlayerBenchmarks();
+    }
+    if (groups.isEmpty() || groups.contains ("resampler"))
+    {
+        runResamplerBenchmarks();
+    }
+    if (groups.isEmpty() || groups.contains ("seek"))
+    {
+        runSeekBenchmarks();
+    }
+    if (groups.isEmpty() || groups.contains ("loudness"))
+    {
+        runLoudnessBenchmarks();
+    }
+
+    int exitCode = getNumFailures() > 0 ? 1 : 0;
+    if (jsonFile != juce::File() && ! writeResultsJson (jsonFile))
+    {
+        std::cerr << "Could not write " << jsonFile.getFullPathName() << std::endl;
+        exitCode = 1;
+    }
+
+    juce::DeletedAtShutdown::deleteAll();
+    juce::MessageManager::deleteInstance();
+    return exitCode;
+}
@@ -0,0 +1,53 @@
+#include "Benchmark.h"
+#include "../../source/DeckMixer.h"
+
+void runMixerBenchmarks()
+{
+	const double sampleRate = 44100.0;
+	const int blockSizes[] = { 64, 256, 1024 };
+	const int iterations = 20000;
+
+	for (int blockSize : blockSizes)
+	{
+		juce::AudioBuffer<float> output(2, blockSize);
+		juce::AudioSourceChannelInfo info(&output, 0, blockSize);
+		juce::String suffix = " (" + juce::String(blockSize) + " samples)";
+
+		// The mixer the application used before, no crossfader or master gain
+		{
+			NoiseSource left(1), right(2);
+			juce::MixerAudioSource mixer;
+			mixer.addInputSource(&left, false);
+			mixer.addInputSource(&right, false);
+			mixer.prepareToPlay(blockSize, sampleRate);
+			printResult(runBenchmark("mixer: MixerAudioSource" + suffix, iterations, [&](int)
+			{
+				mixer.getNextAudioBlock(info);
+			}));
+			mixer.removeAllInputs();
+		}
+
+		// Steady crossfader and master gain
+		{
+			NoiseSource left(1), right(2);
+			DeckMixer mixer(left, right);
+			mixer.prepareToPlay(blockSize, sampleRate);
+			printResult(runBenchmark("mixer: DeckMixer steady" + suffix, iterations, [&](int)
+			{
+				mixer.getNextAudioBlock(info);
+			}));
+		}
+
+		// Crossfader moving every block, so the gains are always ramping
+		{
+			NoiseSource left(1), right(2);
+			DeckMixer mixer(left, right);
+			mixer.prepareToPlay(blockSize, sampleRate);
+			printResult(runBenchmark("mixer: DeckMixer ramping" + suffix, iterations, [&](int i)
+			{
+				mixer.setCrossfader((i % 100) / 99.0f);
+				mixer.getNextAudioBlock(info);
+			}));
+		}
+	}
+}
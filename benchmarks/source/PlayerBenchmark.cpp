@@ -0,0 +1,202 @@
+#include "Benchmark.h"
+#include "../../source/DJAudioPlayer.h"
+#include "../../source/DeckMixer.h"
+
+namespace
+{
+	// Settings for one run of the player chain, the defaults are the baseline each sweep varies
+	struct ChainSettings
+	{
+		int blockSize = 512;
+		double sampleRate = 48000.0;
+		double speed = 1.0;
+		float roomSize = 0.5f;
+		float damping = 0.5f;
+		// Beats at 120 BPM, zero plays straight through the track
+		double loopBeats = 0.0;
+	};
+
+	// Write a stereo test track, noise over a tone so every stage has real work to do
+	bool writeTestTrack(const juce::File& file, double sampleRate, double seconds)
+	{
+		std::unique_ptr<juce::FileOutputStream> stream(file.createOutputStream());
+		if (stream == nullptr)
+		{
+			return false;
+		}
+		juce::WavAudioFormat wavFormat;
+		std::unique_ptr<juce::AudioFormatWriter> writer(wavFormat.createWriterFor(stream.get(), sampleRate, 2, 16, {}, 0));
+		if (writer == nullptr)
+		{
+			return false;
+		}
+		stream.release();
+
+		juce::Random random(7);
+		juce::AudioBuffer<float> buffer(2, 4096);
+		juce::int64 totalSamples = (juce::int64) (sampleRate * seconds);
+		for (juce::int64 done = 0; done < totalSamples; done += buffer.getNumSamples())
+		{
+			for (int i = 0; i < buffer.getNumSamples(); ++i)
+			{
+				float tone = 0.5f * (float) std::sin((done + i) * 440.0 * juce::MathConstants<double>::twoPi / sampleRate);
+				buffer.setSample(0, i, tone + 0.1f * (random.nextFloat() - 0.5f));
+				buffer.setSample(1, i, tone + 0.1f * (random.nextFloat() - 0.5f));
+			}
+			writer->writeFromAudioSampleBuffer(buffer, 0, buffer.getNumSamples());
+		}
+		return true;
+	}
+
+	// Returns false if a loop was asked for but never made it into memory
+	bool setUpPlayer(DJAudioPlayer& player, const juce::File& track, const ChainSettings& settings)
+	{
+		// Decode inline, a read-ahead thread cannot keep up with a loop running faster than realtime
+		player.setReadAhead(false, DJAudioPlayer::defaultReadAheadSamples);
+		player.loadURL(juce::URL{ track });
+		if (settings.loopBeats > 0.0)
+		{
+			player.setLoopLength(settings.loopBeats);
+			player.setLoop();
+			// Wait for the loop thread to decode the loop, otherwise every wrap would seek the track
+			juce::uint32 deadline = juce::Time::getMillisecondCounter() + 10000;
+			while (! player.isLoopInMemory())
+			{
+				if (juce::Time::getMillisecondCounter() > deadline)
+				{
+					return false;
+				}
+				juce::Thread::sleep(5);
+			}
+		}
+		player.setSpeed(settings.speed);
+		player.setReverbRoomSize(settings.roomSize);
+		player.setReverbDamping(settings.damping);
+		return true;
+	}
+
+	// Enough blocks for about twenty seconds of audio
+	int getIterations(const ChainSettings& settings)
+	{
+		return juce::jmax(500, (int) (20.0 * settings.sampleRate / settings.blockSize));
+	}
+
+	void benchmarkPlayer(const juce::String& name, juce::AudioFormatManager& formatManager,
+						 const juce::File& track, const ChainSettings& settings)
+	{
+		DJAudioPlayer player(formatManager);
+		if (! setUpPlayer(player, track, settings))
+		{
+			reportFailure(name + ": the loop was never decoded into memory");
+			return;
+		}
+		player.prepareToPlay(settings.blockSize, settings.sampleRate);
+		player.start();
+
+		juce::AudioBuffer<float> buffer(2, settings.blockSize);
+		juce::AudioSourceChannelInfo info(&buffer, 0, settings.blockSize);
+		for (int i = 0; i < 100; ++i)
+		{
+			player.getNextAudioBlock(info);
+		}
+
+		BenchmarkResult result = runBenchmark(name, getIterations(settings), [&](int)
+		{
+			player.getNextAudioBlock(info);
+		});
+		result.samplesPerRun = settings.blockSize;
+		player.releaseResources();
+		printResult(result);
+	}
+
+	void benchmarkTwoDecks(const juce::String& name, juce::AudioFormatManager& formatManager,
+						   const juce::File& track, const ChainSettings& settings)
+	{
+		DJAudioPlayer left(formatManager);
+		DJAudioPlayer right(formatManager);
+		if (! setUpPlayer(left, track, settings) || ! setUpPlayer(right, track, settings))
+		{
+			reportFailure(name + ": the loop was never decoded into memory");
+			return;
+		}
+
+		DeckMixer mixer(left, right);
+		mixer.prepareToPlay(settings.blockSize, settings.sampleRate);
+		left.start();
+		right.start();
+
+		juce::AudioBuffer<float> buffer(2, settings.blockSize);
+		juce::AudioSourceChannelInfo info(&buffer, 0, settings.blockSize);
+		for (int i = 0; i < 100; ++i)
+		{
+			mixer.getNextAudioBlock(info);
+		}
+
+		BenchmarkResult result = runBenchmark(name, getIterations(settings), [&](int)
+		{
+			mixer.getNextAudioBlock(info);
+		});
+		result.samplesPerRun = settings.blockSize;
+		mixer.releaseResources();
+		printResult(result);
+	}
+}
+
+void runPlayerBenchmarks()
+{
+	juce::AudioFormatManager formatManager;
+	formatManager.registerBasicFormats();
+
+	juce::TemporaryFile track(".wav");
+	// Long enough for twenty seconds at double speed without looping
+	if (! writeTestTrack(track.getFile(), 44100.0, 60.0))
+	{
+		std::cerr << "Could not write the test track" << std::endl;
+		return;
+	}
+
+	// Each sweep changes one setting away from the baseline
+	for (int blockSize : { 64, 128, 256, 512, 1024, 2048 })
+	{
+		ChainSettings settings;
+		settings.blockSize = blockSize;
+		benchmarkPlayer("player: block " + juce::String(blockSize), formatManager, track.getFile(), settings);
+	}
+
+	for (double sampleRate : { 44100.0, 48000.0, 96000.0 })
+	{
+		ChainSettings settings;
+		settings.sampleRate = sampleRate;
+		benchmarkPlayer("player: rate " + juce::String((int) sampleRate), formatManager, track.getFile(), settings);
+	}
+
+	for (double speed : { 0.5, 1.0, 1.1, 2.0 })
+	{
+		ChainSettings settings;
+		settings.speed = speed;
+		benchmarkPlayer("player: speed " + juce::String(speed, 2), formatManager, track.getFile(), settings);
+	}
+
+	for (float roomSize : { 0.0f, 0.5f, 1.0f })
+	{
+		ChainSettings settings;
+		settings.roomSize = roomSize;
+		settings.damping = 1.0f - roomSize;
+		benchmarkPlayer("player: reverb room " + juce::String(roomSize, 1), formatManager, track.getFile(), settings);
+	}
+
+	// The shortest loop wraps several times a block
+	for (double loopBeats : { 1.0 / 32.0, 1.0, 32.0 })
+	{
+		ChainSettings settings;
+		settings.loopBeats = loopBeats;
+		benchmarkPlayer("player: loop " + juce::String(loopBeats, 3) + " beats", formatManager, track.getFile(), settings);
+	}
+
+	for (int blockSize : { 128, 512, 2048 })
+	{
+		ChainSettings settings;
+		settings.blockSize = blockSize;
+		benchmarkTwoDecks("two decks: block " + juce::String(blockSize), formatManager, track.getFile(), settings);
+	}
+}
@@ -0,0 +1,74 @@
+#include "Benchmark.h"
+#include "../../source/PolyphaseResampler.h"
+#include "../../source/TimeStretcher.h"
+
+namespace
+{
+	const double sampleRate = 48000.0;
+	const int blockSize = 512;
+	const int iterations = 5000;
+
+	void printWithLoad(BenchmarkResult result)
+	{
+		result.samplesPerRun = blockSize;
+		printResult(result);
+		// Share of one core a deck would take at this setting
+		std::cout << "    " << result.meanNs / blockSize * sampleRate / 1.0e7 << " % of a core per deck" << std::endl;
+	}
+}
+
+void runResamplerBenchmarks()
+{
+	juce::AudioBuffer<float> output(2, blockSize);
+	juce::AudioSourceChannelInfo info(&output, 0, blockSize);
+
+	const PolyphaseResampler::Quality tiers[] = {
+		PolyphaseResampler::Quality::draft,
+		PolyphaseResampler::Quality::standard,
+		PolyphaseResampler::Quality::mastering
+	};
+	const char* const tierNames[] = { "draft", "standard", "mastering" };
+
+	for (double speed : { 0.5, 1.1, 2.0 })
+	{
+		juce::String suffix = " at " + juce::String(speed, 2) + "x";
+
+		// The linear interpolator the decks used before
+		{
+			NoiseSource noise(1);
+			juce::ResamplingAudioSource resampler(&noise, false, 2);
+			resampler.setResamplingRatio(speed);
+			resampler.prepareToPlay(blockSize, sampleRate);
+			printWithLoad(runBenchmark("resampler: ResamplingAudioSource" + suffix, iterations, [&](int)
+			{
+				resampler.getNextAudioBlock(info);
+			}));
+		}
+
+		for (int tier = 0; tier < juce::numElementsInArray(tiers); ++tier)
+		{
+			NoiseSource noise(1);
+			PolyphaseResampler resampler(&noise, 2);
+			resampler.setQuality(tiers[tier]);
+			resampler.setResamplingRatio(speed);
+			resampler.prepareToPlay(blockSize, sampleRate);
+			printWithLoad(runBenchmark("resampler: polyphase " + juce::String(tierNames[tier]) + suffix, iterations, [&](int)
+			{
+				resampler.getNextAudioBlock(info);
+			}));
+		}
+
+		// Key lock, whose cost should not grow with the speed
+		{
+			NoiseSource noise(1);
+			TimeStretcher stretcher(&noise, 2);
+			stretcher.prepareToPlay(blockSize, sampleRate);
+			stretcher.setEnabled(true);
+			stretcher.setTempo(speed);
+			printWithLoad(runBenchmark("resampler: key lock stretch" + suffix, iterations, [&](int)
+			{
+				stretcher.getNextAudioBlock(info);
+			}));
+		}
+	}
+}
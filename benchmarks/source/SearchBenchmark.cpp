@@ -0,0 +1,81 @@
+#include "Benchmark.h"
+#include "../../source/TrackSearchIndex.h"
+
+namespace
+{
+	// Builds a title of three to six random words, some of them accented
+	juce::String makeTitle(juce::Random& random)
+	{
+		static const char* const words[] = {
+			"midnight", "city", "lights", "dub", "remix", "deep", "house", "stomper", "reggae", "fast",
+			"melody", "drums", "soft", "hard", "bleep", "selection", "inspired", "original", "mix", "edit",
+			"sunrise", "groove", "bass", "vocal", "dreams", "echo", "summer", "night", "drive", "motion"
+		};
+		static const juce::String accented[] = {
+			juce::CharPointer_UTF8("caf\xc3\xa9"), juce::CharPointer_UTF8("se\xc3\xb1or"),
+			juce::CharPointer_UTF8("\xc3\x9c" "ber"), juce::CharPointer_UTF8("Bj\xc3\xb6rk")
+		};
+
+		juce::StringArray parts;
+		int numWords = 3 + random.nextInt(4);
+		for (int i = 0; i < numWords; ++i)
+		{
+			if (random.nextInt(20) == 0)
+			{
+				parts.add(accented[random.nextInt(juce::numElementsInArray(accented))]);
+			}
+			else
+			{
+				parts.add(words[random.nextInt(juce::numElementsInArray(words))]);
+			}
+		}
+		parts.add(juce::String(random.nextInt(1000)));
+		return parts.joinIntoString(" ");
+	}
+}
+
+void runSearchBenchmarks()
+{
+	const int numTitles = 100000;
+	juce::Random random(42);
+
+	TrackSearchIndex index;
+	juce::int64 start = juce::Time::getHighResolutionTicks();
+	for (int i = 0; i < numTitles; ++i)
+	{
+		index.addTitle(makeTitle(random));
+	}
+	std::cout << "Indexed " << numTitles << " titles in "
+	          << juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start) * 1000.0
+	          << " ms" << std::endl;
+
+	// Fresh queries of different lengths and selectivity, alternated so no result is reused
+	const juce::String queries[] = { "night drive", "REGGAE", "cafe", "ber 12", "stomper dub", "xyz" };
+	printResult(runBenchmark("search: fresh query", 600, [&](int i)
+	{
+		index.search(queries[i % juce::numElementsInArray(queries)]);
+	}));
+
+	// The first keystrokes on their own, so the longer queries do not hide their cost
+	const juce::String oneCharacter[] = { "e", "s", "z" };
+	printResult(runBenchmark("search: 1 character query", 600, [&](int i)
+	{
+		index.search(oneCharacter[i % juce::numElementsInArray(oneCharacter)]);
+	}));
+
+	const juce::String twoCharacters[] = { "de", "mi", "qx" };
+	printResult(runBenchmark("search: 2 character query", 600, [&](int i)
+	{
+		index.search(twoCharacters[i % juce::numElementsInArray(twoCharacters)]);
+	}));
+
+	// Typing one character at a time, each query refines the previous results
+	const juce::String typed = "selection deep";
+	printResult(runBenchmark("search: incremental typing", typed.length() * 50, [&](int i)
+	{
+		int length = 1 + i % typed.length();
+		index.search(typed.substring(0, length));
+	}));
+
+	std::cout << "Matches for \"midnight city\": " << index.search("midnight city").size() << std::endl;
+}
@@ -0,0 +1,191 @@
+#include "Benchmark.h"
+#include "../../source/Mp3SeekIndex.h"
+#include "../../source/Mp3SeekingReader.h"
+#include <limits>
+
+namespace
+{
+	const int blockSize = 512;
+
+	// The tracks folder of the repository, looked for above the working directory and the executable
+	juce::File findTracksFolder()
+	{
+		for (juce::File start : { juce::File::getCurrentWorkingDirectory(),
+								  juce::File::getSpecialLocation(juce::File::currentExecutableFile) })
+		{
+			for (juce::File dir = start; dir != dir.getParentDirectory(); dir = dir.getParentDirectory())
+			{
+				juce::File tracks = dir.getChildFile("tracks");
+				if (tracks.isDirectory())
+				{
+					return tracks;
+				}
+			}
+		}
+		return {};
+	}
+
+	// Jump to a random sample and read one block, as a cue or a click on the waveform does
+	BenchmarkResult benchmarkSeeks(const juce::String& name, juce::AudioFormatReader& reader, int iterations)
+	{
+		juce::AudioBuffer<float> buffer((int) reader.numChannels, blockSize);
+		juce::Random random(11);
+		juce::int64 range = juce::jmax((juce::int64) 1, reader.lengthInSamples - blockSize);
+
+		BenchmarkResult result = runBenchmark(name, iterations, [&](int)
+		{
+			// Never negative, the reader would return silence without decoding anything
+			reader.read(&buffer, 0, blockSize, (juce::int64) (random.nextDouble() * range), true, true);
+		});
+		result.samplesPerRun = blockSize;
+		return result;
+	}
+
+	// Offset into the plain decoder's output that best matches the indexed reader's
+	// first samples, which should be the priming. Searched from zero to a frame past
+	// the priming, around a second into the track so it is not silence.
+	int findBestOffset(juce::AudioFormatReader& plain, juce::AudioFormatReader& seeking, const Mp3SeekIndex& index)
+	{
+		const int length = 4096;
+		int maxOffset = index.getPriming() + index.getSamplesPerFrame();
+		int start = (int) juce::jmin((juce::int64) index.getSampleRate(), seeking.lengthInSamples - length - maxOffset);
+		if (start < 0)
+		{
+			return -1;
+		}
+
+		// The plain decoder reads from the start, so it never has to seek
+		juce::AudioBuffer<float> expected(1, start + length + maxOffset);
+		juce::AudioBuffer<float> actual(1, length);
+		plain.read(&expected, 0, expected.getNumSamples(), 0, true, false);
+		seeking.read(&actual, 0, length, start, true, false);
+
+		int bestOffset = -1;
+		float bestError = std::numeric_limits<float>::max();
+		for (int offset = 0; offset <= maxOffset; ++offset)
+		{
+			float error = 0.0f;
+			for (int i = 0; i < length; ++i)
+			{
+				error += std::abs(expected.getSample(0, start + offset + i) - actual.getSample(0, i));
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				bestOffset = offset;
+			}
+		}
+		return bestOffset;
+	}
+
+	// Largest difference between blocks read after a jump and the same blocks read
+	// straight through the plain decoder, priming included, so both the trim and
+	// the sample each jump lands on are checked
+	float checkSeeks(const juce::File& file, std::shared_ptr<const Mp3SeekIndex> index, juce::AudioFormat& mp3Format,
+					 juce::AudioFormatManager& formatManager)
+	{
+		std::unique_ptr<juce::AudioFormatReader> plain(formatManager.createReaderFor(file));
+		std::unique_ptr<Mp3SeekingReader> seeking = Mp3SeekingReader::create(file, index, mp3Format);
+		if (plain == nullptr || seeking == nullptr)
+		{
+			return -1.0f;
+		}
+
+		int numChannels = (int) seeking->numChannels;
+		juce::AudioBuffer<float> expected(numChannels, blockSize);
+		juce::AudioBuffer<float> actual(numChannels, blockSize);
+		float maxError = 0.0f;
+		int priming = index->getPriming();
+
+		// Decode the priming first, so the block reads below carry straight on
+		if (priming > 0)
+		{
+			juce::AudioBuffer<float> skipped(numChannels, priming);
+			plain->read(&skipped, 0, priming, 0, true, true);
+		}
+
+		// Every 97th block, so targets fall at many different places within their frames.
+		// The plain decoder reads every block so it never seeks.
+		for (juce::int64 start = 0; start + blockSize <= seeking->lengthInSamples; start += blockSize)
+		{
+			plain->read(&expected, 0, blockSize, start + priming, true, true);
+			if ((start / blockSize) % 97 != 0)
+			{
+				continue;
+			}
+
+			seeking->read(&actual, 0, blockSize, start, true, true);
+			for (int channel = 0; channel < numChannels; ++channel)
+			{
+				for (int i = 0; i < blockSize; ++i)
+				{
+					maxError = juce::jmax(maxError, std::abs(expected.getSample(channel, i) - actual.getSample(channel, i)));
+				}
+			}
+		}
+		return maxError;
+	}
+}
+
+void runSeekBenchmarks()
+{
+	juce::AudioFormatManager formatManager;
+	formatManager.registerBasicFormats();
+	juce::AudioFormat* mp3Format = formatManager.findFormatForFileExtension("mp3");
+	if (mp3Format == nullptr)
+	{
+		std::cerr << "No MP3 decoder, build with JUCE_USE_MP3AUDIOFORMAT to run the seek benchmarks" << std::endl;
+		return;
+	}
+
+	juce::File tracksFolder = findTracksFolder();
+	juce::Array<juce::File> tracks = tracksFolder.findChildFiles(juce::File::findFiles, false, "*.mp3");
+	if (tracks.isEmpty())
+	{
+		std::cerr << "Could not find the tracks folder" << std::endl;
+		return;
+	}
+	tracks.sort();
+
+	for (const juce::File& track : tracks)
+	{
+		juce::String trackName = track.getFileNameWithoutExtension();
+
+		std::shared_ptr<const Mp3SeekIndex> index;
+		printResult(runBenchmark("seek: " + trackName + " build index", 5, [&](int)
+		{
+			juce::FileInputStream in(track);
+			index = Mp3SeekIndex::build(in);
+		}));
+		if (index == nullptr)
+		{
+			std::cerr << trackName << " is not an MP3 the index understands" << std::endl;
+			continue;
+		}
+
+		std::unique_ptr<juce::AudioFormatReader> plain(formatManager.createReaderFor(track));
+		if (plain != nullptr)
+		{
+			printResult(benchmarkSeeks("seek: " + trackName + " plain", *plain, 50));
+		}
+
+		std::unique_ptr<Mp3SeekingReader> indexed = Mp3SeekingReader::create(track, index, *mp3Format);
+		if (indexed != nullptr)
+		{
+			printResult(benchmarkSeeks("seek: " + trackName + " indexed", *indexed, 500));
+		}
+
+		// The best offset should equal the priming, anything else means jumps land on the wrong sample
+		int bestOffset = -1;
+		std::unique_ptr<juce::AudioFormatReader> reference(formatManager.createReaderFor(track));
+		std::unique_ptr<Mp3SeekingReader> aligned = Mp3SeekingReader::create(track, index, *mp3Format);
+		if (reference != nullptr && aligned != nullptr)
+		{
+			bestOffset = findBestOffset(*reference, *aligned, *index);
+		}
+
+		std::cout << "seek: " << trackName << " " << index->getNumFrames() << " frames, priming "
+				  << index->getPriming() << ", decoder lines up at offset " << bestOffset
+				  << ", max error after seek " << checkSeeks(track, index, *mp3Format, formatManager) << std::endl;
+	}
+}
@@ -0,0 +1,193 @@
+#include "AutoMixSource.h"
+
+AutoMixSource::AutoMixSource(juce::AudioTransportSource& first, juce::AudioTransportSource& second)
+	: slots{ &first, &second }
+{
+}
+
+AutoMixSource::~AutoMixSource()
+{
+}
+
+//==============================================================================
+void AutoMixSource::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+	slots[0]->prepareToPlay(samplesPerBlockExpected, sampleRate);
+	slots[1]->prepareToPlay(samplesPerBlockExpected, sampleRate);
+	// Sized up front so the fade never allocates
+	incomingBuffer.setSize(2, juce::jmax(1, samplesPerBlockExpected));
+}
+
+void AutoMixSource::releaseResources()
+{
+	slots[0]->releaseResources();
+	slots[1]->releaseResources();
+	incomingBuffer.setSize(0, 0);
+}
+
+void AutoMixSource::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+	int current = control.load();
+	int slot = getSlot(current);
+	juce::AudioTransportSource& outgoing = *slots[slot];
+	juce::AudioTransportSource& incoming = *slots[1 - slot];
+
+	switch (getState(current))
+	{
+		case idle:
+			outgoing.getNextAudioBlock(bufferToFill);
+			return;
+
+		case finished:
+			incoming.getNextAudioBlock(bufferToFill);
+			return;
+
+		case armed:
+		{
+			// Sample in this block where the fade has to start to end with the track
+			juce::int64 remaining = outgoing.getTotalLength() - outgoing.getNextReadPosition();
+			juce::int64 fadeStart = remaining - fadeLength;
+			if (! outgoing.isPlaying() || fadeStart >= bufferToFill.numSamples
+				|| ! control.compare_exchange_strong(current, makeControl(fading, slot)))
+			{
+				outgoing.getNextAudioBlock(bufferToFill);
+				return;
+			}
+
+			fadePosition = 0;
+			gainOut = 1.0;
+			gainIn = 0.0;
+			double step = juce::MathConstants<double>::halfPi / juce::jmax(1, fadeLength.load());
+			stepCos = std::cos(step);
+			stepSin = std::sin(step);
+
+			outgoing.getNextAudioBlock(bufferToFill);
+			mixIncoming(bufferToFill, (int) juce::jmax((juce::int64) 0, fadeStart), incoming);
+			return;
+		}
+
+		case fading:
+			outgoing.getNextAudioBlock(bufferToFill);
+			mixIncoming(bufferToFill, 0, incoming);
+			return;
+	}
+}
+
+void AutoMixSource::mixIncoming(const juce::AudioSourceChannelInfo& bufferToFill, int fadeStart, juce::AudioTransportSource& incoming)
+{
+	// Blocks larger than prepared for are mixed in sections, so the fade never allocates
+	int maxSectionSize = incomingBuffer.getNumSamples();
+	if (maxSectionSize == 0)
+	{
+		return;
+	}
+	for (int done = fadeStart; done < bufferToFill.numSamples; done += maxSectionSize)
+	{
+		juce::AudioSourceChannelInfo section(bufferToFill.buffer,
+											 bufferToFill.startSample + done,
+											 juce::jmin(maxSectionSize, bufferToFill.numSamples - done));
+		mixSection(section, incoming);
+	}
+
+	// The fade is over, from the next block on only the incoming track plays
+	if (fadePosition >= fadeLength)
+	{
+		int current = makeControl(fading, getSlot(control.load()));
+		control.compare_exchange_strong(current, makeControl(finished, getSlot(current)));
+	}
+}
+
+void AutoMixSource::mixSection(const juce::AudioSourceChannelInfo& section, juce::AudioTransportSource& incoming)
+{
+	int numSamples = section.numSamples;
+	int numChannels = juce::jmin(section.buffer->getNumChannels(), 2);
+
+	juce::AudioSourceChannelInfo incomingInfo(&incomingBuffer, 0, numSamples);
+	incoming.getNextAudioBlock(incomingInfo);
+
+	int length = fadeLength;
+	for (int i = 0; i < numSamples; ++i)
+	{
+		if (fadePosition >= length)
+		{
+			gainOut = 0.0;
+			gainIn = 1.0;
+		}
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			float* out = section.buffer->getWritePointer(channel, section.startSample);
+			const float* in = incomingBuffer.getReadPointer(channel);
+			out[i] = (float) (out[i] * gainOut + in[i] * gainIn);
+		}
+
+		// Rotate (cos, sin) by one step, cheaper than calling both every sample
+		double nextOut = gainOut * stepCos - gainIn * stepSin;
+		gainIn = gainIn * stepCos + gainOut * stepSin;
+		gainOut = nextOut;
+		++fadePosition;
+	}
+}
+
+//==============================================================================
+int AutoMixSource::getCurrentSlot() const
+{
+	return getSlot(control.load());
+}
+
+int AutoMixSource::getIncomingSlot() const
+{
+	return 1 - getCurrentSlot();
+}
+
+bool AutoMixSource::arm(int fadeLengthSamples)
+{
+	int current = makeControl(idle, getCurrentSlot());
+	fadeLength = juce::jmax(1, fadeLengthSamples);
+	return control.compare_exchange_strong(current, makeControl(armed, getSlot(current)));
+}
+
+bool AutoMixSource::disarm()
+{
+	int current = makeControl(armed, getCurrentSlot());
+	return control.compare_exchange_strong(current, makeControl(idle, getSlot(current)));
+}
+
+void AutoMixSource::finishNow()
+{
+	int slot = getCurrentSlot();
+	int current = makeControl(armed, slot);
+	if (! control.compare_exchange_strong(current, makeControl(finished, slot)))
+	{
+		current = makeControl(fading, slot);
+		control.compare_exchange_strong(current, makeControl(finished, slot));
+	}
+}
+
+bool AutoMixSource::isIdle() const
+{
+	return getState(control.load()) == idle;
+}
+
+bool AutoMixSource::isArmed() const
+{
+	return getState(control.load()) == armed;
+}
+
+bool AutoMixSource::isFading() const
+{
+	return getState(control.load()) == fading;
+}
+
+bool AutoMixSource::hasFinished() const
+{
+	return getState(control.load()) == finished;
+}
+
+void AutoMixSource::completeTransition()
+{
+	int current = control.load();
+	if (getState(current) == finished)
+	{
+		control = makeControl(idle, 1 - getSlot(current));
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+
+// Plays one of two transports and crossfades to the other when the current
+// track is about to end. The message thread loads the next track into the
+// idle transport and arms the transition; the audio thread picks the exact
+// sample the fade starts on and runs an equal-power fade, so nothing is
+// opened, decoded or locked on the audio thread during a transition.
+class AutoMixSource : public juce::AudioSource
+{
+public:
+    AutoMixSource(juce::AudioTransportSource& first, juce::AudioTransportSource& second);
+    ~AutoMixSource() override;
+
+    //==============================================================================
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+    // Transport that is playing, and the one the next track is loaded into
+    int getCurrentSlot() const;
+    int getIncomingSlot() const;
+
+    // Fade to the incoming transport so that the fade ends as the current track does.
+    // The incoming transport must already have its source and be started. Message thread only.
+    bool arm(int fadeLengthSamples);
+
+    // Call off an armed transition before its fade starts, true if the incoming transport is free again
+    bool disarm();
+
+    // Cut straight to the incoming transport, whether or not the fade has started
+    void finishNow();
+
+    bool isIdle() const;
+    bool isArmed() const;
+    bool isFading() const;
+
+    // True once the incoming transport is the only one playing. completeTransition()
+    // then makes it the current one, after which the old transport can be cleared.
+    bool hasFinished() const;
+    void completeTransition();
+
+private:
+    enum State
+    {
+        idle = 0,
+        armed,
+        fading,
+        finished
+    };
+
+    // State and current slot share one atomic, so the audio thread always sees a consistent pair
+    static int makeControl(State state, int currentSlot) { return (int) state * 2 + currentSlot; }
+    static State getState(int control) { return (State) (control / 2); }
+    static int getSlot(int control) { return control % 2; }
+
+    void mixIncoming(const juce::AudioSourceChannelInfo& bufferToFill, int fadeStart, juce::AudioTransportSource& incoming);
+    // Mix one section no longer than incomingBuffer
+    void mixSection(const juce::AudioSourceChannelInfo& section, juce::AudioTransportSource& incoming);
+
+    juce::AudioTransportSource* slots[2];
+    std::atomic<int> control{ makeControl(idle, 0) };
+    std::atomic<int> fadeLength{ 0 };
+
+    // Audio thread only
+    juce::AudioBuffer<float> incomingBuffer;
+    int fadePosition = 0;
+    // Equal-power gains, advanced one sample at a time by a fixed rotation
+    double gainOut = 1.0, gainIn = 0.0;
+    double stepCos = 1.0, stepSin = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AutoMixSource)
+};
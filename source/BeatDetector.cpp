@@ -0,0 +1,252 @@
+#include "BeatDetector.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// Shorter tracks do not hold enough beats to trust a tempo
+	const double minAnalysisSeconds = 10.0;
+	// Kick drums sit below this, they mark the downbeats more often than anything else
+	const double bassCutoffHz = 150.0;
+	// Phase resolution when lining the grid up with the onsets
+	const int phaseBins = 64;
+
+	// Remove the local mean so only onsets standing out from their surroundings count
+	std::vector<float> detrend(const std::vector<float>& onsets, int halfWindow)
+	{
+		int n = (int) onsets.size();
+		std::vector<float> envelope((size_t) n);
+		double sum = 0.0;
+		int start = 0;
+		int end = 0;
+		for (int i = 0; i < n; ++i)
+		{
+			while (end < juce::jmin(n, i + halfWindow + 1))
+			{
+				sum += onsets[(size_t) end++];
+			}
+			while (start < i - halfWindow)
+			{
+				sum -= onsets[(size_t) start++];
+			}
+			float mean = (float) (sum / (end - start));
+			envelope[(size_t) i] = juce::jmax(0.0f, onsets[(size_t) i] - mean);
+		}
+		return envelope;
+	}
+
+	double autocorrelate(const std::vector<float>& envelope, int lag)
+	{
+		int n = (int) envelope.size() - lag;
+		if (n <= 0)
+		{
+			return 0.0;
+		}
+		double sum = 0.0;
+		for (int i = 0; i < n; ++i)
+		{
+			sum += envelope[(size_t) i] * envelope[(size_t) (i + lag)];
+		}
+		return sum / n;
+	}
+
+	// Mild preference for tempos near 120 BPM, settles octave ambiguities
+	double tempoWeight(double bpm)
+	{
+		double octaves = std::log2(bpm / 120.0);
+		return std::exp(-0.5 * octaves * octaves);
+	}
+}
+
+BeatDetector::BeatDetector(double _sampleRate)
+	: sampleRate(_sampleRate),
+	  numBassBins(juce::jlimit(2, fftSize / 2, (int) std::ceil(bassCutoffHz * fftSize / _sampleRate))),
+	  frame((size_t) fftSize),
+	  fftData((size_t) fftSize * 2),
+	  magnitudes((size_t) fftSize / 2 + 1),
+	  previousMagnitudes((size_t) fftSize / 2 + 1),
+	  flux((size_t) fftSize / 2 + 1)
+{
+}
+
+void BeatDetector::process(const float* samples, int numSamples)
+{
+	while (numSamples > 0)
+	{
+		int count = juce::jmin(numSamples, fftSize - frameFill);
+		std::copy(samples, samples + count, frame.begin() + frameFill);
+		frameFill += count;
+		samples += count;
+		numSamples -= count;
+
+		if (frameFill == fftSize)
+		{
+			processFrame();
+			// Frames overlap by half
+			std::copy(frame.begin() + hopSize, frame.end(), frame.begin());
+			frameFill = fftSize - hopSize;
+		}
+	}
+}
+
+void BeatDetector::processFrame()
+{
+	int numBins = fftSize / 2 + 1;
+
+	std::copy(frame.begin(), frame.end(), fftData.begin());
+	window.multiplyWithWindowingTable(fftData.data(), (size_t) fftSize);
+	fft.performFrequencyOnlyForwardTransform(fftData.data());
+
+	// Log compression so quiet passages count as much as loud ones
+	const float scale = 1000.0f / fftSize;
+	for (int bin = 0; bin < numBins; ++bin)
+	{
+		magnitudes[(size_t) bin] = std::log1p(scale * fftData[(size_t) bin]);
+	}
+
+	// Only rising energy marks an onset
+	juce::FloatVectorOperations::subtract(flux.data(), magnitudes.data(), previousMagnitudes.data(), numBins);
+	juce::FloatVectorOperations::max(flux.data(), flux.data(), 0.0f, numBins);
+
+	float bass = 0.0f;
+	float total = 0.0f;
+	for (int bin = 1; bin < numBins; ++bin)
+	{
+		if (bin < numBassBins)
+		{
+			bass += flux[(size_t) bin];
+		}
+		total += flux[(size_t) bin];
+	}
+
+	// The first frame rises from silence, which is not an onset
+	onsets.push_back(onsets.empty() ? 0.0f : total);
+	bassOnsets.push_back(bassOnsets.empty() ? 0.0f : bass);
+	std::swap(magnitudes, previousMagnitudes);
+}
+
+BeatGrid BeatDetector::getBeatGrid() const
+{
+	double envelopeRate = sampleRate / hopSize;
+	if ((double) onsets.size() < envelopeRate * minAnalysisSeconds)
+	{
+		return {};
+	}
+
+	std::vector<float> envelope = detrend(onsets, juce::roundToInt(envelopeRate * 0.25));
+
+	// Autocorrelation of the onsets, each lag also scored by its double so
+	// a period that keeps repeating wins over one that happens to fit once
+	int minLag = (int) std::floor(envelopeRate * 60.0 / maxBpm);
+	int maxLag = (int) std::ceil(envelopeRate * 60.0 / minBpm);
+	std::vector<double> correlation((size_t) maxLag * 2 + 1);
+	for (int lag = minLag; lag < (int) correlation.size(); ++lag)
+	{
+		correlation[(size_t) lag] = autocorrelate(envelope, lag);
+	}
+
+	std::vector<double> scores((size_t) maxLag + 2);
+	int bestLag = 0;
+	for (int lag = minLag; lag <= maxLag; ++lag)
+	{
+		double score = correlation[(size_t) lag] + 0.5 * correlation[(size_t) lag * 2];
+		scores[(size_t) lag] = score * tempoWeight(60.0 * envelopeRate / lag);
+		if (bestLag == 0 || scores[(size_t) lag] > scores[(size_t) bestLag])
+		{
+			bestLag = lag;
+		}
+	}
+	if (scores[(size_t) bestLag] <= 0.0)
+	{
+		return {};
+	}
+
+	// Parabolic interpolation between the neighbouring lags
+	double lag = bestLag;
+	if (bestLag > minLag && bestLag < maxLag)
+	{
+		double before = scores[(size_t) bestLag - 1];
+		double peak = scores[(size_t) bestLag];
+		double after = scores[(size_t) bestLag + 1];
+		double curvature = before - 2.0 * peak + after;
+		if (curvature < 0.0)
+		{
+			lag += 0.5 * (before - after) / curvature;
+		}
+	}
+
+	double period = lag;
+	double phase = 0.0;
+	refinePeriod(envelope, lag, period, phase);
+
+	BeatGrid grid;
+	double beatLength = period * hopSize / sampleRate;
+	grid.bpm = 60.0 / beatLength;
+	// An onset shows most strongly in the frame centred on it
+	double phaseSeconds = (phase * hopSize + fftSize / 2) / sampleRate;
+	grid.firstBeatSeconds = std::fmod(phaseSeconds, beatLength);
+
+	// The beat of the bar with the strongest bass onsets is the downbeat
+	double bestStrength = -1.0;
+	int numBeats = (int) ((onsets.size() * hopSize / sampleRate - grid.firstBeatSeconds) / beatLength);
+	for (int candidate = 0; candidate < BeatGrid::beatsPerBar; ++candidate)
+	{
+		double strength = 0.0;
+		for (int beat = candidate; beat < numBeats; beat += BeatGrid::beatsPerBar)
+		{
+			int hop = juce::roundToInt((grid.getBeatTime(beat) * sampleRate - fftSize / 2) / hopSize);
+			float peak = 0.0f;
+			for (int i = juce::jmax(0, hop - 1); i <= juce::jmin((int) bassOnsets.size() - 1, hop + 1); ++i)
+			{
+				peak = juce::jmax(peak, bassOnsets[(size_t) i]);
+			}
+			strength += peak;
+		}
+		if (strength > bestStrength)
+		{
+			bestStrength = strength;
+			grid.downbeatPhase = candidate;
+		}
+	}
+	return grid;
+}
+
+void BeatDetector::refinePeriod(const std::vector<float>& envelope, double lag, double& period, double& phase) const
+{
+	// A coarse pass a hop either side, then a fine one around the best. The fine
+	// step keeps the drift over a few hundred beats to under a hop.
+	double centre = lag;
+	double bestConcentration = -1.0;
+	for (double step : { 0.05, 0.0025 })
+	{
+		double searchCentre = centre;
+		for (int i = -20; i <= 20; ++i)
+		{
+			double candidate = searchCentre + i * step;
+			if (candidate < 1.0)
+			{
+				continue;
+			}
+
+			// Fold the onsets into one beat, the right period piles them up in a few bins
+			float histogram[phaseBins] = {};
+			for (size_t hop = 0; hop < envelope.size(); ++hop)
+			{
+				double position = std::fmod((double) hop, candidate) / candidate;
+				histogram[juce::jmin(phaseBins - 1, (int) (position * phaseBins))] += envelope[hop];
+			}
+
+			for (int bin = 0; bin < phaseBins; ++bin)
+			{
+				double concentration = histogram[(bin + phaseBins - 1) % phaseBins] + histogram[bin] + histogram[(bin + 1) % phaseBins];
+				if (concentration > bestConcentration)
+				{
+					bestConcentration = concentration;
+					centre = candidate;
+					period = candidate;
+					phase = (bin + 0.5) / phaseBins * candidate;
+				}
+			}
+		}
+	}
+}
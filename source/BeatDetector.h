@@ -0,0 +1,56 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include "BeatGrid.h"
+
+// Finds the tempo and beat grid of a track from its onsets. The track is fed
+// through in blocks and only the onset envelope, one value per hop, is kept, so
+// memory does not grow with the audio. Onsets are the spectral flux of a
+// log-compressed FFT, with a second envelope of the bass bins for the downbeats.
+class BeatDetector
+{
+public:
+    BeatDetector(double _sampleRate);
+
+    // Feed the next block of the track, mixed down to mono
+    void process(const float* samples, int numSamples);
+
+    // Grid from everything fed so far, invalid if no steady tempo was found
+    BeatGrid getBeatGrid() const;
+
+    static constexpr int fftOrder = 10;
+    static constexpr int fftSize = 1 << fftOrder;
+    static constexpr int hopSize = fftSize / 2;
+
+    // Tempos are folded into this range
+    static constexpr double minBpm = 70.0;
+    static constexpr double maxBpm = 180.0;
+
+private:
+    void processFrame();
+
+    // Best beat period and phase near the given lag, both in hops
+    void refinePeriod(const std::vector<float>& envelope, double lag, double& period, double& phase) const;
+
+    double sampleRate;
+    int numBassBins;
+
+    juce::dsp::FFT fft{ fftOrder };
+    juce::dsp::WindowingFunction<float> window{ (size_t) fftSize, juce::dsp::WindowingFunction<float>::hann, false };
+
+    // Samples waiting for the next frame
+    std::vector<float> frame;
+    int frameFill = 0;
+
+    std::vector<float> fftData;
+    std::vector<float> magnitudes;
+    std::vector<float> previousMagnitudes;
+    std::vector<float> flux;
+
+    // One value per hop
+    std::vector<float> onsets;
+    std::vector<float> bassOnsets;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BeatDetector)
+};
@@ -0,0 +1,41 @@
+#include "BeatGrid.h"
+
+bool BeatGrid::isValid() const
+{
+	return bpm > 0.0;
+}
+
+double BeatGrid::getBeatLengthSeconds() const
+{
+	return isValid() ? 60.0 / bpm : 0.0;
+}
+
+double BeatGrid::getBeatTime(double beat) const
+{
+	return firstBeatSeconds + beat * getBeatLengthSeconds();
+}
+
+double BeatGrid::getBeatNumber(double seconds) const
+{
+	return isValid() ? (seconds - firstBeatSeconds) / getBeatLengthSeconds() : 0.0;
+}
+
+bool BeatGrid::isDownbeat(int beat) const
+{
+	// Also right for negative beats
+	return ((beat - downbeatPhase) % beatsPerBar + beatsPerBar) % beatsPerBar == 0;
+}
+
+void BeatGrid::writeTo(juce::OutputStream& out) const
+{
+	out.writeDouble(bpm);
+	out.writeDouble(firstBeatSeconds);
+	out.writeInt(downbeatPhase);
+}
+
+void BeatGrid::readFrom(juce::InputStream& in)
+{
+	bpm = in.readDouble();
+	firstBeatSeconds = in.readDouble();
+	downbeatPhase = juce::jlimit(0, beatsPerBar - 1, in.readInt());
+}
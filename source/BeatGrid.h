@@ -0,0 +1,31 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Constant tempo beat grid of a track, as found by the BeatDetector. Beat 0 is
+// the first beat at or after the start of the track, beats before it have
+// negative numbers. Times are in seconds of the decoded track.
+struct BeatGrid
+{
+    double bpm = 0.0;
+    double firstBeatSeconds = 0.0;
+    // Which of beats 0 - 3 starts a bar
+    int downbeatPhase = 0;
+
+    static constexpr int beatsPerBar = 4;
+
+    // False until the track has been analysed, or when no tempo was found
+    bool isValid() const;
+
+    double getBeatLengthSeconds() const;
+
+    // Time of a beat, fractions give times between beats
+    double getBeatTime(double beat) const;
+    // Beat number of a time, with the fraction of the way to the next beat
+    double getBeatNumber(double seconds) const;
+
+    bool isDownbeat(int beat) const;
+
+    void writeTo(juce::OutputStream& out) const;
+    void readFrom(juce::InputStream& in);
+};
@@ -1,21 +1,189 @@
 #include "DJAudioPlayer.h"
+#include "TrackKey.h"
+#include "Mp3SeekingReader.h"
+#include <cmath>
 #include <deque>
 
-DJAudioPlayer::DJAudioPlayer(juce::AudioFormatManager& _formatManager
-) : formatManager(_formatManager)
+//==============================================================================
+// Prepares a track on the loader thread and parks it until loadURL asks for it
+class DJAudioPlayer::PreloadJob : public juce::ThreadPoolJob
 {
+public:
+	PreloadJob(DJAudioPlayer& _owner, const juce::URL& _url, TrackDetails _details, bool _useReadAhead, int _bufferSizeSamples)
+		: juce::ThreadPoolJob("Preload " + _url.toString(false)),
+		  owner(_owner),
+		  url(_url),
+		  details(std::move(_details)),
+		  useReadAhead(_useReadAhead),
+		  bufferSizeSamples(_bufferSizeSamples)
+	{
+	}
+
+	JobStatus runJob() override
+	{
+		details.seekIndex = owner.loadSeekIndex(url, details);
+
+		// With the PCM cache on, the track is decoded first so it loads ready to seek
+		owner.decodeToCache(url, details.seekIndex, [this] { return shouldExit(); });
+		if (shouldExit())
+		{
+			return jobHasFinished;
+		}
+
+		std::unique_ptr<PreparedTrack> track = owner.prepareTrack(url, details, useReadAhead, bufferSizeSamples);
+		if (track != nullptr && ! shouldExit())
+		{
+			const juce::ScopedLock sl(owner.preparedLock);
+			owner.preparedTrack = std::move(track);
+		}
+		return jobHasFinished;
+	}
+
+private:
+	DJAudioPlayer& owner;
+	juce::URL url;
+	TrackDetails details;
+	bool useReadAhead;
+	int bufferSizeSamples;
 };
 
-DJAudioPlayer::~DJAudioPlayer()
+//==============================================================================
+// Decodes a track that was loaded before it was in the PCM cache, ready for next time
+class DJAudioPlayer::DecodeJob : public juce::ThreadPoolJob
 {
+public:
+	DecodeJob(DJAudioPlayer& _owner, const juce::URL& _url, SeekIndexPtr _seekIndex)
+		: juce::ThreadPoolJob("Decode " + _url.toString(false)),
+		  owner(_owner),
+		  url(_url),
+		  seekIndex(std::move(_seekIndex))
+	{
+	}
+
+	JobStatus runJob() override
+	{
+		owner.decodeToCache(url, seekIndex, [this] { return shouldExit(); });
+		return jobHasFinished;
+	}
 
+private:
+	DJAudioPlayer& owner;
+	juce::URL url;
+	SeekIndexPtr seekIndex;
+};
+
+//==============================================================================
+// Decodes a loop or the window around a hot cue into memory and hands it to the track's loop source
+class DJAudioPlayer::RegionFillJob : public juce::ThreadPoolJob
+{
+public:
+	// A cue index of -1 fills the loop
+	RegionFillJob(DJAudioPlayer& _owner, const PreparedTrack& _track, juce::int64 _start, juce::int64 _end, int _cueIndex)
+		: juce::ThreadPoolJob("Region " + _track.url.toString(false)),
+		  owner(_owner),
+		  url(_track.url),
+		  seekIndex(_track.details.seekIndex),
+		  loopSource(_track.loopSource),
+		  start(_start),
+		  end(_end),
+		  cueIndex(_cueIndex)
+	{
+	}
+
+	JobStatus runJob() override
+	{
+		// Skip loops and cues that were changed again before their turn came
+		if (! isWanted())
+		{
+			return jobHasFinished;
+		}
+
+		// A reader of its own, the audio thread is using the track's
+		std::unique_ptr<juce::AudioFormatReader> reader = owner.createDecodedReader(url);
+		if (reader == nullptr)
+		{
+			reader = owner.createFileReader(url, seekIndex);
+		}
+		if (reader == nullptr || shouldExit())
+		{
+			return jobHasFinished;
+		}
+
+		std::shared_ptr<LoopSource::Region> region = std::make_shared<LoopSource::Region>();
+		region->start = start;
+		region->audio.setSize((int) reader->numChannels, (int) (end - start));
+		reader->read(&region->audio, 0, region->audio.getNumSamples(), start, true, true);
+		if (cueIndex < 0)
+		{
+			loopSource->setRegion(std::move(region));
+		}
+		else
+		{
+			loopSource->setCueRegion(cueIndex, std::move(region));
+		}
+		return jobHasFinished;
+	}
+
+private:
+	bool isWanted() const
+	{
+		if (cueIndex < 0)
+		{
+			return loopSource->isLoopActive() && loopSource->getLoopStart() == start && loopSource->getLoopEnd() == end;
+		}
+		return loopSource->isCueWindow(cueIndex, start, end);
+	}
+
+	DJAudioPlayer& owner;
+	juce::URL url;
+	SeekIndexPtr seekIndex;
+	std::shared_ptr<LoopSource> loopSource;
+	juce::int64 start;
+	juce::int64 end;
+	int cueIndex;
+};
+
+//==============================================================================
+DJAudioPlayer::DJAudioPlayer(juce::AudioFormatManager& _formatManager,
+	juce::TimeSliceThread* _readAheadThread,
+	SeekIndexStore* _seekIndexStore
+) : formatManager(_formatManager),
+	seekIndexStore(_seekIndexStore),
+	readAheadThread(_readAheadThread)
+{
+	// Auto-mix housekeeping, cheap enough to leave running
+	startTimer(50);
+};
+
+DJAudioPlayer::~DJAudioPlayer()
+{
+	stopTimer();
+	loaderPool.removeAllJobs(true, 5000);
+	loopPool.removeAllJobs(true, 5000);
+	clearSlot(0);
+	clearSlot(1);
 };
 
 //==============================================================================
 void DJAudioPlayer::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
 {
-	// Tells transport source to get ready
-	transportSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
+	deviceBlockSize = samplesPerBlockExpected;
+	deviceSampleRate = sampleRate;
+
+	// Start at the current settings rather than ramping to them
+	gainSmoother.reset(sampleRate, 0.05);
+	gainSmoother.setCurrentAndTargetValue(gainTarget);
+	for (int slot = 0; slot < 2; ++slot)
+	{
+		autoGainSmoothers[slot].reset(sampleRate, autoGainRampSeconds);
+		autoGainSmoothers[slot].setCurrentAndTargetValue(autoGainTargets[slot]);
+	}
+	speedSmoother.reset(sampleRate, 0.1);
+	speedSmoother.setCurrentAndTargetValue(speedTarget);
+	resampleSource.setResamplingRatio(speedTarget);
+	applyParameters(0);
+	// Tells both transport sources to get ready
+	autoMixSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
 	// Prepare to play the resampled resource
 	resampleSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
 	// Prepare to play the reverb source
@@ -23,27 +191,441 @@ void DJAudioPlayer::prepareToPlay(int samplesPerBlockExpected, double sampleRate
 }
 void DJAudioPlayer::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
 {
+	applyParameters(bufferToFill.numSamples);
+
+	// Stamp where this block starts in the track, for the GUI to move on from
+	const juce::AudioTransportSource& transport = currentTransport();
+	PlayheadStamp stamp;
+	stamp.positionSeconds = transport.getCurrentPosition();
+	stamp.lengthSeconds = transport.getLengthInSeconds();
+	stamp.rate = transport.isPlaying() ? currentSpeed : 0.0;
+	stamp.ticks = juce::Time::getHighResolutionTicks();
+	publishPlayhead(stamp);
+
 	reverbSource.getNextAudioBlock(bufferToFill);
+	applyGain(bufferToFill);
+
+	// First block played since a load, record how long it took to get here
+	if (awaitingFirstBlock && currentTransport().isPlaying())
+	{
+		juce::int64 now = juce::Time::getHighResolutionTicks();
+		lastLoadLatencyMs = juce::Time::highResolutionTicksToSeconds(loadTicks + now - waitingSinceTicks) * 1000.0;
+		awaitingFirstBlock = false;
+	}
+}
+void DJAudioPlayer::applyParameters(int numSamples)
+{
+	// The resampler and stretcher take one ratio per block, so speed glides block by block
+	speedSmoother.setTargetValue(speedTarget);
+	double speed = speedSmoother.isSmoothing() ? speedSmoother.skip(numSamples) : speedSmoother.getCurrentValue();
+	currentSpeed = speed;
+
+	// With key lock the stretcher takes the speed, the resampler only what is beyond its range
+	bool keyLock = keyLockEnabled;
+	timeStretcher.setEnabled(keyLock);
+	if (positionJumped.exchange(false))
+	{
+		timeStretcher.flush();
+	}
+	if (keyLock)
+	{
+		double tempo = juce::jlimit(TimeStretcher::minTempo, TimeStretcher::maxTempo, speed);
+		timeStretcher.setTempo(tempo);
+		resampleSource.setResamplingRatio(speed / tempo);
+	}
+	else
+	{
+		resampleSource.setResamplingRatio(speed);
+	}
+
+	// Auto gain sits in the transports, so each track of a crossfade keeps its own
+	for (int slot = 0; slot < 2; ++slot)
+	{
+		auto& smoother = autoGainSmoothers[slot];
+		float target = autoGainTargets[slot];
+		if (autoGainJumps[slot].exchange(false))
+		{
+			smoother.setCurrentAndTargetValue(target);
+		}
+		else
+		{
+			smoother.setTargetValue(target);
+		}
+		transportSources[slot].setGain(smoother.isSmoothing() ? smoother.skip(numSamples) : smoother.getCurrentValue());
+	}
+
+	// Balance goes from dry only, through both at full level, to wet only
+	float balance = reverbBalanceTarget;
+	juce::Reverb::Parameters parameters = reverbParameters;
+	parameters.dryLevel = balance <= 0.5f ? 1.0f : 2.0f - balance * 2.0f;
+	parameters.wetLevel = balance <= 0.5f ? balance * 2.0f : 1.0f;
+	parameters.damping = reverbDampingTarget;
+	parameters.roomSize = reverbRoomSizeTarget;
+
+	// The reverb ramps its own gains and filters when its parameters change
+	if (parameters.dryLevel != reverbParameters.dryLevel || parameters.wetLevel != reverbParameters.wetLevel
+		|| parameters.damping != reverbParameters.damping || parameters.roomSize != reverbParameters.roomSize)
+	{
+		reverbParameters = parameters;
+		reverbSource.setParameters(reverbParameters);
+	}
 }
+
+void DJAudioPlayer::applyGain(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+	gainSmoother.setTargetValue(gainTarget);
+	float startGain = gainSmoother.getCurrentValue();
+	float endGain = gainSmoother.skip(bufferToFill.numSamples);
+
+	// A linear ramp over the block is exactly what the smoother would give sample by sample
+	if (startGain != endGain)
+	{
+		bufferToFill.buffer->applyGainRamp(bufferToFill.startSample, bufferToFill.numSamples, startGain, endGain);
+	}
+	else if (endGain != 1.0f)
+	{
+		bufferToFill.buffer->applyGain(bufferToFill.startSample, bufferToFill.numSamples, endGain);
+	}
+}
+
 void DJAudioPlayer::releaseResources()
 {
-	transportSource.releaseResources();
+	autoMixSource.releaseResources();
 	resampleSource.releaseResources();
 	reverbSource.releaseResources();
 }
 
-void DJAudioPlayer::loadURL(juce::URL audioURL)
+void DJAudioPlayer::loadURL(juce::URL audioURL, TrackDetails details)
 {
+	juce::int64 startTicks = juce::Time::getHighResolutionTicks();
+
+	// Use the preloaded track when it is the one being asked for
+	std::unique_ptr<PreparedTrack> track;
+	{
+		const juce::ScopedLock sl(preparedLock);
+		if (preparedTrack != nullptr && preparedTrack->url == audioURL)
+		{
+			track = std::move(preparedTrack);
+		}
+	}
+	// Pressing NEXT on the track the auto-mix is about to fade in cuts straight to it
+	if (track == nullptr && ! autoMixSource.isIdle())
+	{
+		int incoming = autoMixSource.getIncomingSlot();
+		if (slotTracks[incoming] != nullptr && slotTracks[incoming]->url == audioURL)
+		{
+			autoMixSource.finishNow();
+			completeTransition();
+			loadTicks = juce::Time::getHighResolutionTicks() - startTicks;
+			waitingSinceTicks = juce::Time::getHighResolutionTicks();
+			awaitingFirstBlock = true;
+			return;
+		}
+	}
+	cancelTransition();
+
+	if (track == nullptr)
+	{
+		// The cancelled transition may have handed its track back
+		const juce::ScopedLock sl(preparedLock);
+		if (preparedTrack != nullptr && preparedTrack->url == audioURL)
+		{
+			track = std::move(preparedTrack);
+		}
+	}
+	if (track == nullptr)
+	{
+		details.seekIndex = loadSeekIndex(audioURL, details);
+		track = prepareTrack(audioURL, details, readAheadEnabled, readAheadSamples);
+	}
+
+	if (track != nullptr)
+	{
+		if (! track->isDecoded && pcmCache.load() != nullptr)
+		{
+			loaderPool.addJob(new DecodeJob(*this, audioURL, track->details.seekIndex), true);
+		}
+		installTrack(autoMixSource.getCurrentSlot(), std::move(track));
+		positionJumped = true;
+
+		juce::int64 now = juce::Time::getHighResolutionTicks();
+		loadTicks = now - startTicks;
+		waitingSinceTicks = now;
+		awaitingFirstBlock = true;
+	}
+}
+
+void DJAudioPlayer::preloadURL(juce::URL audioURL, TrackDetails details)
+{
+	{
+		const juce::ScopedLock sl(preparedLock);
+		if (preparedTrack != nullptr && preparedTrack->url == audioURL)
+		{
+			return;
+		}
+		preparedTrack.reset();
+	}
+
+	// Only the latest request matters, a preload still running is told to discard its result.
+	// Decodes for the PCM cache are left to finish.
+	struct PreloadJobs : public juce::ThreadPool::JobSelector
+	{
+		bool isJobSuitable(juce::ThreadPoolJob* job) override
+		{
+			return dynamic_cast<PreloadJob*>(job) != nullptr;
+		}
+	};
+	PreloadJobs preloadJobs;
+	loaderPool.removeAllJobs(true, 0, &preloadJobs);
+	if (! audioURL.isEmpty())
+	{
+		loaderPool.addJob(new PreloadJob(*this, audioURL, std::move(details), readAheadEnabled, readAheadSamples), true);
+	}
+}
+
+double DJAudioPlayer::getLastLoadLatencyMs() const
+{
+	return lastLoadLatencyMs;
+}
+
+std::unique_ptr<DJAudioPlayer::PreparedTrack> DJAudioPlayer::prepareTrack(const juce::URL& audioURL,
+																			const TrackDetails& details,
+																			bool useReadAhead,
+																			int bufferSizeSamples)
+{
+	// A decoded copy in the PCM cache is read straight from memory
+	std::unique_ptr<juce::AudioFormatReader> decodedReader = createDecodedReader(audioURL);
+	bool isDecoded = decodedReader != nullptr;
+
+	// Otherwise open the file, through its seek index when there is one
+	auto* reader = isDecoded ? decodedReader.release() : createFileReader(audioURL, details.seekIndex).release();
+	if (reader == nullptr)
+	{
+		return nullptr;
+	}
+
+	std::unique_ptr<PreparedTrack> track(new PreparedTrack());
+	track->url = audioURL;
+	track->sampleRate = reader->sampleRate;
+	track->readerSource.reset(new juce::AudioFormatReaderSource(reader, true));
+	track->isDecoded = isDecoded;
+	track->details = details;
+
+	// Decode on the background thread so the audio callback never waits on the disk.
+	// A decoded track still goes through the buffer, its pages may not be resident and
+	// copying from the mapping could fault in the audio callback.
+	if (useReadAhead && readAheadThread != nullptr)
+	{
+		track->readAheadSource.reset(new ReadAheadSource(track->readerSource.get(), *readAheadThread, bufferSizeSamples, underrunCount));
+
+		prerollTrack(*track);
+	}
+
+	juce::PositionableAudioSource* playbackSource = track->readerSource.get();
+	if (track->readAheadSource != nullptr)
+	{
+		playbackSource = track->readAheadSource.get();
+	}
+	track->loopSource = std::make_shared<LoopSource>(playbackSource);
+
+	// Cues are ready to jump to by the time the track is loaded
+	for (int i = 0; i < HotCues::numCues; ++i)
+	{
+		holdHotCue(*track, i);
+	}
+	return track;
+}
+
+void DJAudioPlayer::decodeToCache(const juce::URL& audioURL, const SeekIndexPtr& seekIndex, const std::function<bool()>& shouldStop)
+{
+	PcmCache* cache = pcmCache;
+	if (cache == nullptr || ! audioURL.isLocalFile())
+	{
+		return;
+	}
+
+	juce::String key = TrackKey::forFile(audioURL.getLocalFile());
+	if (key.isEmpty() || cache->createReader(key) != nullptr)
+	{
+		return;
+	}
+
+	// Decoded through the same reader as playback, so both have the priming trimmed
+	std::unique_ptr<juce::AudioFormatReader> source = createFileReader(audioURL, seekIndex);
+	if (source != nullptr)
+	{
+		cache->decode(key, *source, shouldStop);
+	}
+}
+
+std::unique_ptr<juce::AudioFormatReader> DJAudioPlayer::createFileReader(const juce::URL& audioURL, const SeekIndexPtr& seekIndex)
+{
+	if (audioURL.isLocalFile())
+	{
+		return Mp3SeekingReader::createReaderFor(audioURL.getLocalFile(), seekIndex, formatManager);
+	}
+
 	// Take audio url and convert it into a input stream and place it into a reader
-	auto* reader = formatManager.createReaderFor(audioURL.createInputStream(false));
-	if (reader != nullptr)
+	return std::unique_ptr<juce::AudioFormatReader>(formatManager.createReaderFor(audioURL.createInputStream(false)));
+}
+
+DJAudioPlayer::SeekIndexPtr DJAudioPlayer::loadSeekIndex(const juce::URL& audioURL, const TrackDetails& details)
+{
+	if (details.seekIndex != nullptr || ! details.hasSeekIndex || seekIndexStore == nullptr || ! audioURL.isLocalFile())
+	{
+		return details.seekIndex;
+	}
+	return seekIndexStore->getIndexFor(audioURL.getLocalFile());
+}
+
+std::unique_ptr<juce::AudioFormatReader> DJAudioPlayer::createDecodedReader(const juce::URL& audioURL)
+{
+	PcmCache* cache = pcmCache;
+	if (cache == nullptr || ! audioURL.isLocalFile())
+	{
+		return nullptr;
+	}
+
+	juce::String key = TrackKey::forFile(audioURL.getLocalFile());
+	if (key.isEmpty())
 	{
-		std::unique_ptr<juce::AudioFormatReaderSource> newSource(new juce::AudioFormatReaderSource(reader, true));
-		// Parse audio source into transport source
-		transportSource.setSource(newSource.get(), 0, nullptr, reader->sampleRate);
-		// Pass ownership of pointer to class scope variable, retain access to it
-		readerSource.reset(newSource.release());
+		return nullptr;
 	}
+	return cache->createReader(key);
+}
+
+void DJAudioPlayer::prerollTrack(PreparedTrack& track)
+{
+	// Fill the buffer now, with the same settings the transport's resampler will prepare it with,
+	// so handing it to the transport later does not start the buffering again
+	int blockSize = deviceBlockSize;
+	double sampleRate = deviceSampleRate;
+	if (track.readAheadSource != nullptr && blockSize > 0 && sampleRate > 0)
+	{
+		double ratio = track.sampleRate / sampleRate;
+		track.readAheadSource->prepareToPlay(juce::roundToInt(blockSize * ratio), sampleRate * ratio);
+	}
+}
+
+void DJAudioPlayer::installTrack(int slot, std::unique_ptr<PreparedTrack> track)
+{
+	// The new track's level is in place before its first block
+	autoGainTargets[slot] = autoGainEnabled ? getAutoGain(track->details.loudness) : 1.0f;
+	autoGainJumps[slot] = true;
+
+	// Parse audio source into transport source, then free the track it replaces
+	transportSources[slot].setSource(track->loopSource.get(), 0, nullptr, track->sampleRate);
+	slotTracks[slot] = std::move(track);
+}
+
+void DJAudioPlayer::clearSlot(int slot)
+{
+	// setSource waits for the audio thread to finish with the old source
+	transportSources[slot].setSource(nullptr);
+	slotTracks[slot].reset();
+}
+
+//==============================================================================
+void DJAudioPlayer::setAutoMix(bool enabled, double _crossfadeSeconds)
+{
+	autoMixEnabled = enabled;
+	crossfadeSeconds = juce::jmax(0.1, _crossfadeSeconds);
+	// A fade already under way is left to finish
+	if (! enabled && autoMixSource.isArmed())
+	{
+		cancelTransition();
+	}
+}
+
+bool DJAudioPlayer::isAutoMixEnabled() const
+{
+	return autoMixEnabled;
+}
+
+void DJAudioPlayer::timerCallback()
+{
+	if (autoMixSource.hasFinished())
+	{
+		completeTransition();
+		if (onAutoMixTransition != nullptr)
+		{
+			onAutoMixTransition();
+		}
+	}
+
+	// A looping track never ends, so there is nothing to mix into
+	if (autoMixEnabled && autoMixSource.isIdle() && currentTransport().isPlaying() && ! isLooping())
+	{
+		armNextTrack();
+	}
+}
+
+void DJAudioPlayer::armNextTrack()
+{
+	double sampleRate = deviceSampleRate;
+	if (sampleRate <= 0)
+	{
+		return;
+	}
+
+	// Only a fully prepared track is used, so the transition never waits on the disk
+	std::unique_ptr<PreparedTrack> track;
+	{
+		const juce::ScopedLock sl(preparedLock);
+		track = std::move(preparedTrack);
+	}
+	if (track == nullptr)
+	{
+		return;
+	}
+
+	// The incoming transport is started but nothing pulls it until the fade begins
+	int incoming = autoMixSource.getIncomingSlot();
+	installTrack(incoming, std::move(track));
+	transportSources[incoming].start();
+	autoMixSource.arm(juce::roundToInt(crossfadeSeconds * sampleRate));
+}
+
+void DJAudioPlayer::completeTransition()
+{
+	int outgoing = autoMixSource.getCurrentSlot();
+	autoMixSource.completeTransition();
+	clearSlot(outgoing);
+}
+
+void DJAudioPlayer::cancelTransition()
+{
+	int incoming = autoMixSource.getIncomingSlot();
+	if (autoMixSource.disarm())
+	{
+		// Never played, so give the track back to be loaded by hand or armed again
+		transportSources[incoming].setSource(nullptr);
+		std::unique_ptr<PreparedTrack> track = std::move(slotTracks[incoming]);
+		if (track != nullptr)
+		{
+			prerollTrack(*track);
+			const juce::ScopedLock sl(preparedLock);
+			if (preparedTrack == nullptr)
+			{
+				preparedTrack = std::move(track);
+			}
+		}
+	}
+	else if (! autoMixSource.isIdle())
+	{
+		autoMixSource.finishNow();
+		completeTransition();
+	}
+}
+
+juce::AudioTransportSource& DJAudioPlayer::currentTransport()
+{
+	return transportSources[autoMixSource.getCurrentSlot()];
+}
+
+const juce::AudioTransportSource& DJAudioPlayer::currentTransport() const
+{
+	return transportSources[autoMixSource.getCurrentSlot()];
 }
 
 void DJAudioPlayer::setGain(double gain)
@@ -54,8 +636,40 @@ void DJAudioPlayer::setGain(double gain)
 	}
 	else
 	{
-		transportSource.setGain(gain);
+		gainTarget = (float) gain;
+	}
+}
+
+void DJAudioPlayer::setAutoGain(bool enabled)
+{
+	autoGainEnabled = enabled;
+	// Tracks already loaded glide to their new level
+	for (int slot = 0; slot < 2; ++slot)
+	{
+		autoGainTargets[slot] = enabled && slotTracks[slot] != nullptr ? getAutoGain(slotTracks[slot]->details.loudness) : 1.0f;
+	}
+}
+
+bool DJAudioPlayer::isAutoGainEnabled() const
+{
+	return autoGainEnabled;
+}
+
+float DJAudioPlayer::getAutoGain(const TrackLoudness& loudness)
+{
+	if (! loudness.isMeasured)
+	{
+		return 1.0f;
+	}
+
+	double gainDb = juce::jmin(autoGainTargetLufs - loudness.integratedLufs, maxAutoGainBoostDb);
+	// Loud tracks are always turned down, quiet ones only brought up as far as
+	// their peaks leave room for
+	if (gainDb > 0.0)
+	{
+		gainDb = juce::jmin(gainDb, juce::jmax(0.0, autoGainCeilingDb - loudness.truePeakDb));
 	}
+	return juce::Decibels::decibelsToGain((float) gainDb);
 }
 
 void DJAudioPlayer::setSpeed(double ratio)
@@ -66,13 +680,35 @@ void DJAudioPlayer::setSpeed(double ratio)
 	}
 	else
 	{
-		resampleSource.setResamplingRatio(ratio);
+		// Zero would stall the smoothing, and the deck with it
+		speedTarget = juce::jmax(0.01, ratio);
 	}
 }
 
+void DJAudioPlayer::setKeyLock(bool shouldLockKey)
+{
+	keyLockEnabled = shouldLockKey;
+}
+
+bool DJAudioPlayer::isKeyLockEnabled() const
+{
+	return keyLockEnabled;
+}
+
+void DJAudioPlayer::setResamplerQuality(PolyphaseResampler::Quality quality)
+{
+	resampleSource.setQuality(quality);
+}
+
 void DJAudioPlayer::setPosition(double posInSec)
 {
-	transportSource.setPosition(posInSec);
+	PreparedTrack* track = getCurrentTrack();
+	if (track == nullptr || track->sampleRate <= 0)
+	{
+		currentTransport().setPosition(posInSec);
+		return;
+	}
+	jumpTo(*track, (juce::int64) std::llround(juce::jmax(0.0, posInSec) * track->sampleRate));
 }
 
 void DJAudioPlayer::setPositionRelative(double pos)
@@ -81,7 +717,7 @@ void DJAudioPlayer::setPositionRelative(double pos)
 		std::cout << "DJAudioPlayer::setPositionRelative: relative pos should be between 0 and 1." << std::endl;
 	}
 	else {
-		double posInSecs = transportSource.getLengthInSeconds() * pos;
+		double posInSecs = currentTransport().getLengthInSeconds() * pos;
 		setPosition(posInSecs);
 	}
 }
@@ -96,20 +732,8 @@ void DJAudioPlayer::setReverbBalance(float balanceValue)
 	}
 	else // Reverb values is in range
 	{
-		if (balanceValue >= 0.0 && balanceValue <= 0.5f)
-		{
-			// Set dry level to max while increase the value of wet level 
-			reverbParameters.dryLevel = 1.0f;
-			reverbParameters.wetLevel += balanceValue * 2;
-			reverbSource.setParameters(reverbParameters);
-		}
-		else if (balanceValue > 0.5f && balanceValue <= 1.0f)
-		{
-			// Set wet level to max while decresing the value of dry level 
-			reverbParameters.wetLevel = 1.0f;
-			reverbParameters.dryLevel -= (balanceValue - 0.5f) * 2;
-			reverbSource.setParameters(reverbParameters);
-		}
+		// Turned into wet and dry levels on the audio thread
+		reverbBalanceTarget = balanceValue;
 	}
 };
 
@@ -124,9 +748,7 @@ void DJAudioPlayer::setReverbDamping(float damping)
 	else // Reverb values is in range
 	{
 		// Sets damping level of reverb
-		reverbParameters.damping = damping;
-		// Sets the source parameters
-		reverbSource.setParameters(reverbParameters);
+		reverbDampingTarget = damping;
 	}
 };
 
@@ -141,43 +763,330 @@ void DJAudioPlayer::setReverbRoomSize(float roomSize)
 	else // Reverb values is in range
 	{
 		// Sets room size level of reverb
-		reverbParameters.roomSize = roomSize;
-		// Sets the source parameters
-		reverbSource.setParameters(reverbParameters);
+		reverbRoomSizeTarget = roomSize;
 	}
 };
 
 void DJAudioPlayer::start()
 {
-	transportSource.start();
+	// A track loaded while stopped is timed from here, not from when it was loaded
+	if (awaitingFirstBlock && ! currentTransport().isPlaying())
+	{
+		waitingSinceTicks = juce::Time::getHighResolutionTicks();
+	}
+	currentTransport().start();
+	// Mid-fade both tracks pause and resume together
+	if (autoMixSource.isFading())
+	{
+		transportSources[autoMixSource.getIncomingSlot()].start();
+	}
 }
 void DJAudioPlayer::stop()
 {
-	transportSource.stop();
+	// An armed incoming track is never pulled by the audio thread, stopping it would wait for nothing
+	if (autoMixSource.isFading())
+	{
+		transportSources[autoMixSource.getIncomingSlot()].stop();
+	}
+	currentTransport().stop();
 }
 
 bool DJAudioPlayer::isLooping() const
 {
-	return false;
+	PreparedTrack* track = getCurrentTrack();
+	return track != nullptr && track->loopSource->isLoopActive();
+}
+
+bool DJAudioPlayer::isLoopInMemory() const
+{
+	PreparedTrack* track = getCurrentTrack();
+	if (track == nullptr || ! track->loopSource->isLoopActive())
+	{
+		return false;
+	}
+	return track->loopSource->hasRegionFor(track->loopSource->getLoopStart(), track->loopSource->getLoopEnd());
 }
 
 void DJAudioPlayer::setLoop()
 {
-	if (readerSource != nullptr)
+	// Looping takes priority over a pending auto-mix
+	if (autoMixSource.isArmed())
+	{
+		cancelTransition();
+	}
+	PreparedTrack* track = getCurrentTrack();
+	if (track == nullptr)
 	{
-		readerSource->setLooping(true);
+		return;
 	}
+
+	// Loops shorter than a beat snap to their own length, so a quarter beat loop can start on any quarter beat
+	juce::int64 start = snapToGrid(*track, track->loopSource->getPosition(), juce::jmin(1.0, loopBeats), Snap::down);
+	engageLoop(*track, start, start + (juce::int64) std::llround(loopBeats * getBeatSamples(*track)));
 }
 
 void DJAudioPlayer::unsetLoop()
 {
-	if (readerSource != nullptr)
+	PreparedTrack* track = getCurrentTrack();
+	if (track != nullptr)
+	{
+		track->loopSource->clearLoop();
+	}
+}
+
+void DJAudioPlayer::setLoopIn()
+{
+	PreparedTrack* track = getCurrentTrack();
+	if (track != nullptr)
+	{
+		track->loopIn = snapToGrid(*track, track->loopSource->getPosition(), 1.0, Snap::nearest);
+	}
+}
+
+void DJAudioPlayer::setLoopOut()
+{
+	PreparedTrack* track = getCurrentTrack();
+	if (track == nullptr || track->loopIn < 0)
+	{
+		return;
+	}
+	if (autoMixSource.isArmed())
+	{
+		cancelTransition();
+	}
+
+	// The loop plays on to the next beat before it wraps, so the end is never behind the playhead
+	juce::int64 loopOut = snapToGrid(*track, track->loopSource->getPosition(), 1.0, Snap::up);
+	juce::int64 maxLength = (juce::int64) std::llround(maxLoopBeats * getBeatSamples(*track));
+	loopOut = juce::jmin(loopOut, track->loopIn + maxLength);
+	if (loopOut <= track->loopIn)
+	{
+		return;
+	}
+
+	loopBeats = juce::jlimit(minLoopBeats, maxLoopBeats, (loopOut - track->loopIn) / getBeatSamples(*track));
+	engageLoop(*track, track->loopIn, loopOut);
+}
+
+void DJAudioPlayer::setLoopLength(double beats)
+{
+	loopBeats = juce::jlimit(minLoopBeats, maxLoopBeats, beats);
+
+	PreparedTrack* track = getCurrentTrack();
+	if (track != nullptr && track->loopSource->isLoopActive())
+	{
+		juce::int64 start = track->loopSource->getLoopStart();
+		engageLoop(*track, start, start + (juce::int64) std::llround(loopBeats * getBeatSamples(*track)));
+	}
+}
+
+void DJAudioPlayer::halveLoop()
+{
+	setLoopLength(loopBeats / 2.0);
+}
+
+void DJAudioPlayer::doubleLoop()
+{
+	setLoopLength(loopBeats * 2.0);
+}
+
+double DJAudioPlayer::getLoopLength() const
+{
+	return loopBeats;
+}
+
+DJAudioPlayer::PreparedTrack* DJAudioPlayer::getCurrentTrack() const
+{
+	return slotTracks[autoMixSource.getCurrentSlot()].get();
+}
+
+double DJAudioPlayer::getBeatSamples(const PreparedTrack& track) const
+{
+	const BeatGrid& grid = track.details.beatGrid;
+	return track.sampleRate * (grid.isValid() ? grid.getBeatLengthSeconds() : 0.5);
+}
+
+juce::int64 DJAudioPlayer::snapToGrid(const PreparedTrack& track, juce::int64 sample, double beats, Snap snap) const
+{
+	const BeatGrid& grid = track.details.beatGrid;
+	if (! grid.isValid() || track.sampleRate <= 0)
+	{
+		return sample;
+	}
+
+	double steps = grid.getBeatNumber(sample / track.sampleRate) / beats;
+	switch (snap)
+	{
+		case Snap::nearest: steps = std::round(steps); break;
+		case Snap::down:    steps = std::floor(steps); break;
+		case Snap::up:      steps = std::ceil(steps); break;
+	}
+	return (juce::int64) std::llround(grid.getBeatTime(steps * beats) * track.sampleRate);
+}
+
+void DJAudioPlayer::engageLoop(PreparedTrack& track, juce::int64 start, juce::int64 end)
+{
+	juce::int64 length = track.loopSource->getTotalLength();
+	start = juce::jlimit((juce::int64) 0, length, start);
+	end = juce::jlimit(start, length, end);
+	if (end <= start)
+	{
+		return;
+	}
+
+	track.loopSource->setLoop(start, end);
+	// A halved loop is served from the copy already in memory
+	if (! track.loopSource->hasRegionFor(start, end))
+	{
+		loopPool.addJob(new RegionFillJob(*this, track, start, end, -1), true);
+	}
+}
+
+HotCues DJAudioPlayer::getHotCues() const
+{
+	PreparedTrack* track = getCurrentTrack();
+	return track != nullptr ? track->details.hotCues : HotCues();
+}
+
+void DJAudioPlayer::setHotCue(int index)
+{
+	PreparedTrack* track = getCurrentTrack();
+	if (track == nullptr || index < 0 || index >= HotCues::numCues || track->sampleRate <= 0)
+	{
+		return;
+	}
+
+	juce::int64 cue = snapToGrid(*track, track->loopSource->getPosition(), 1.0, Snap::nearest);
+	track->details.hotCues.set(index, juce::jmax((juce::int64) 0, cue) / track->sampleRate);
+	holdHotCue(*track, index);
+}
+
+void DJAudioPlayer::clearHotCue(int index)
+{
+	PreparedTrack* track = getCurrentTrack();
+	if (track != nullptr)
 	{
-		readerSource->setLooping(false);
+		track->details.hotCues.clear(index);
+		holdHotCue(*track, index);
 	}
 }
 
-double DJAudioPlayer::getPositionRelative()
+void DJAudioPlayer::jumpToHotCue(int index)
 {
-	return transportSource.getCurrentPosition() / transportSource.getLengthInSeconds();
+	PreparedTrack* track = getCurrentTrack();
+	if (track == nullptr || ! track->details.hotCues.isSet(index))
+	{
+		return;
+	}
+
+	juce::int64 cue = (juce::int64) std::llround(track->details.hotCues.getSeconds(index) * track->sampleRate);
+	LoopSource& loopSource = *track->loopSource;
+	if (loopSource.isLoopActive() && (cue < loopSource.getLoopStart() || cue >= loopSource.getLoopEnd()))
+	{
+		loopSource.clearLoop();
+	}
+	jumpTo(*track, cue);
+}
+
+void DJAudioPlayer::holdHotCue(PreparedTrack& track, int index)
+{
+	const HotCues& cues = track.details.hotCues;
+	if (! cues.isSet(index) || track.sampleRate <= 0)
+	{
+		track.loopSource->setCueWindow(index, 0, 0);
+		return;
+	}
+
+	juce::int64 length = track.loopSource->getTotalLength();
+	juce::int64 start = (juce::int64) std::llround((cues.getSeconds(index) - cueLeadSeconds) * track.sampleRate);
+	juce::int64 end = (juce::int64) std::llround((cues.getSeconds(index) + cueTailSeconds) * track.sampleRate);
+	start = juce::jlimit((juce::int64) 0, length, start);
+	end = juce::jlimit(start, length, end);
+
+	// A cue set again in the same place keeps the audio it has
+	if (track.loopSource->setCueWindow(index, start, end) && end > start)
+	{
+		loopPool.addJob(new RegionFillJob(*this, track, start, end, index), true);
+	}
+}
+
+void DJAudioPlayer::jumpTo(PreparedTrack& track, juce::int64 sample)
+{
+	// A stopped deck has nothing to fade out of
+	if (currentTransport().isPlaying())
+	{
+		track.loopSource->jumpTo(sample);
+	}
+	else
+	{
+		currentTransport().setPosition(sample / track.sampleRate);
+	}
+	positionJumped = true;
+}
+
+void DJAudioPlayer::setReadAhead(bool enabled, int bufferSizeSamples)
+{
+	readAheadEnabled = enabled;
+	readAheadSamples = juce::jmax(1024, bufferSizeSamples);
+}
+
+void DJAudioPlayer::setPcmCache(PcmCache* cache)
+{
+	pcmCache = cache;
+}
+
+int DJAudioPlayer::getUnderrunCount() const
+{
+	return underrunCount;
+}
+
+double DJAudioPlayer::getPositionRelative() const
+{
+	PlayheadStamp stamp = getPlayheadStamp();
+	if (stamp.lengthSeconds <= 0)
+	{
+		return 0.0;
+	}
+
+	// Move on by the time since the block started, at the speed it was playing
+	double elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - stamp.ticks);
+	elapsed = juce::jlimit(0.0, maxExtrapolationSeconds, elapsed);
+	return juce::jlimit(0.0, 1.0, (stamp.positionSeconds + elapsed * stamp.rate) / stamp.lengthSeconds);
+}
+
+DJAudioPlayer::PlayheadStamp DJAudioPlayer::getPlayheadStamp() const
+{
+	PlayheadStamp stamp;
+	for (;;)
+	{
+		juce::uint32 before = stampSequence.load(std::memory_order_acquire);
+		if ((before & 1) == 0)
+		{
+			stamp.positionSeconds = stampPosition.load(std::memory_order_relaxed);
+			stamp.lengthSeconds = stampLength.load(std::memory_order_relaxed);
+			stamp.rate = stampRate.load(std::memory_order_relaxed);
+			stamp.ticks = stampTicks.load(std::memory_order_relaxed);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (stampSequence.load(std::memory_order_relaxed) == before)
+			{
+				return stamp;
+			}
+		}
+	}
+}
+
+void DJAudioPlayer::publishPlayhead(const PlayheadStamp& stamp)
+{
+	// Only the audio thread writes, so the sequence cannot change under it
+	juce::uint32 sequence = stampSequence.load(std::memory_order_relaxed);
+	stampSequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	stampPosition.store(stamp.positionSeconds, std::memory_order_relaxed);
+	stampLength.store(stamp.lengthSeconds, std::memory_order_relaxed);
+	stampRate.store(stamp.rate, std::memory_order_relaxed);
+	stampTicks.store(stamp.ticks, std::memory_order_relaxed);
+
+	stampSequence.store(sequence + 2, std::memory_order_release);
 }
\ No newline at end of file
@@ -1,12 +1,29 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include <atomic>
+#include <functional>
+#include "ReadAheadSource.h"
+#include "AutoMixSource.h"
+#include "PolyphaseResampler.h"
+#include "TimeStretcher.h"
+#include "PcmCache.h"
+#include "SeekIndexStore.h"
+#include "BeatGrid.h"
+#include "HotCues.h"
+#include "LoudnessMeter.h"
+#include "LoopSource.h"
 
 
-class DJAudioPlayer : public juce::AudioSource
+class DJAudioPlayer : public juce::AudioSource,
+                      private juce::Timer
 {
 public:
-    DJAudioPlayer(juce::AudioFormatManager& _formatManager);
+    // Tracks are decoded ahead of playback on readAheadThread when one is given,
+    // and library MP3s are read through their index in seekIndexStore
+    DJAudioPlayer(juce::AudioFormatManager& _formatManager,
+                  juce::TimeSliceThread* _readAheadThread = nullptr,
+                  SeekIndexStore* _seekIndexStore = nullptr);
     ~DJAudioPlayer();
 
     //==============================================================================
@@ -14,12 +31,62 @@ public:
     void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
     void releaseResources() override;
 
-    void loadURL(juce::URL audioURL);
+    // What the library knows about a track, kept with it through preloads and auto-mix
+    struct TrackDetails
+    {
+        // An MP3 is read through its seek index, so seeks land on the exact sample.
+        // When only hasSeekIndex is set the index is loaded as the track is prepared.
+        std::shared_ptr<const Mp3SeekIndex> seekIndex;
+        bool hasSeekIndex = false;
+        // Loops snap to the grid and are measured in its beats
+        BeatGrid beatGrid;
+        // Held in memory from the moment the track is prepared
+        HotCues hotCues;
+        // Used by auto gain to bring the track to a common loudness
+        TrackLoudness loudness;
+    };
+
+    // Swaps in the track prepared by preloadURL when the URL matches, otherwise opens it here
+    void loadURL(juce::URL audioURL, TrackDetails details = {});
+
+    // Open, decode and buffer a track in the background so a later loadURL of it is instant
+    void preloadURL(juce::URL audioURL, TrackDetails details = {});
+
+    // Milliseconds from the last loadURL to the first block played from the new track,
+    // not counting time the deck sat stopped in between
+    double getLastLoadLatencyMs() const;
+
+    // Parameter setters only store the new value, the audio thread picks it up
+    // at the start of its next block and ramps to it, so they are safe to call at any rate
     void setGain(double gain);
+
+    // With auto gain on, each track is brought to autoGainTargetLufs as far as its
+    // true peak allows, ahead of the gain set above. Each track has its own gain, so
+    // both tracks of an auto-mix crossfade sound at their own level. Changes glide
+    // over autoGainRampSeconds, a newly loaded track starts at its level.
+    void setAutoGain(bool enabled);
+    bool isAutoGainEnabled() const;
+    // Gain auto gain gives a track, 1 when it has not been measured
+    static float getAutoGain(const TrackLoudness& loudness);
+
+    static constexpr double autoGainTargetLufs = -14.0;
+    static constexpr double autoGainCeilingDb = -1.0;
+    static constexpr double maxAutoGainBoostDb = 12.0;
+    static constexpr double autoGainRampSeconds = 0.5;
+
     void setSpeed(double ratio);
+    // While playing, a jump crossfades briefly into the new position and plays it
+    // from memory when it lands in a loop or near a hot cue
     void setPosition(double posInSec);
     void setPositionRelative(double pos);
 
+    // Filter quality used to change speed, standard by default
+    void setResamplerQuality(PolyphaseResampler::Quality quality);
+
+    // With key lock on, speed changes the tempo but keeps the pitch
+    void setKeyLock(bool shouldLockKey);
+    bool isKeyLockEnabled() const;
+
     // Set reverb balance (dry/wet) for the audio
     void setReverbBalance(float balanceValue);
 
@@ -32,22 +99,227 @@ public:
     void start();
     void stop();
 
+    // Loops play from a decoded copy of the loop held in memory and wrap on the exact
+    // sample. Lengths are in beats of the track's grid and loops snap to it. Tracks
+    // without a grid loop from the playhead and count beats at 120 BPM.
     bool isLooping() const;
+    // True once the running loop is decoded, so wraps no longer seek the track
+    bool isLoopInMemory() const;
 
-    // Functions to set the playback to loop or not to loop
+    // Loop the current loop length, starting from the grid line at or before the playhead
     void setLoop();
+    // Leave the loop, playback carries on through its end
     void unsetLoop();
 
-    double getPositionRelative();
+    // Mark the start of a loop at the nearest beat, then loop back to it from the next beat after loop out
+    void setLoopIn();
+    void setLoopOut();
+
+    // Changing the length of a running loop keeps its start
+    void setLoopLength(double beats);
+    void halveLoop();
+    void doubleLoop();
+    double getLoopLength() const;
+
+    // Hot cues of the track playing. A window of audio around each cue is kept
+    // decoded in memory, so a jump to one plays on the next block. Setting a cue
+    // snaps it to the nearest beat of the grid.
+    HotCues getHotCues() const;
+    void setHotCue(int index);
+    void clearHotCue(int index);
+    // Leaves a loop the cue is outside of
+    void jumpToHotCue(int index);
+
+    // Audio kept in memory before and after each hot cue
+    static constexpr double cueLeadSeconds = 0.25;
+    static constexpr double cueTailSeconds = 3.0;
+
+    static constexpr double minLoopBeats = 1.0 / 32.0;
+    static constexpr double maxLoopBeats = 32.0;
+    static constexpr double defaultLoopBeats = 4.0;
+
+    // Where the audio thread was in the track at the start of its last block, and when
+    struct PlayheadStamp
+    {
+        double positionSeconds = 0.0;
+        double lengthSeconds = 0.0;
+        // Track seconds per second, zero when stopped
+        double rate = 0.0;
+        juce::int64 ticks = 0;
+    };
+
+    // Latest stamp published by the audio thread, never touches the transport (any thread)
+    PlayheadStamp getPlayheadStamp() const;
+
+    // The latest stamp moved on to now, 0 - 1, and 0 with no track loaded
+    double getPositionRelative() const;
+
+    // Furthest a stamp is moved on, so the playhead stops when the audio does
+    static constexpr double maxExtrapolationSeconds = 0.25;
+
+    // Decode ahead of the playhead on the background thread, applies from the next loaded track
+    void setReadAhead(bool enabled, int bufferSizeSamples);
+
+    // Number of blocks that needed audio the background thread had not decoded yet
+    int getUnderrunCount() const;
+
+    // Play tracks from decoded copies in the cache, so seeks cost nothing. A track
+    // not yet in the cache streams from its file and is decoded in the background
+    // for next time, preloaded tracks are decoded before they are loaded.
+    // nullptr streams every track from its file again. Applies from the next loaded track.
+    void setPcmCache(PcmCache* cache);
+
+    // Crossfade into the preloaded track so it takes over as the current one ends
+    void setAutoMix(bool enabled, double crossfadeSeconds);
+    bool isAutoMixEnabled() const;
+
+    // Called on the message thread once an automatic crossfade has finished
+    std::function<void()> onAutoMixTransition;
+
+    static constexpr int defaultReadAheadSamples = 65536;
+    static constexpr double defaultCrossfadeSeconds = 8.0;
 private:
+    // A track opened and buffered ready to hand to the transport
+    struct PreparedTrack
+    {
+        juce::URL url;
+        double sampleRate = 0.0;
+        std::unique_ptr<juce::AudioFormatReaderSource> readerSource;
+        std::unique_ptr<ReadAheadSource> readAheadSource;
+        // Playing from the PCM cache rather than the file
+        bool isDecoded = false;
+        TrackDetails details;
+        // Shared with the jobs filling its loops, which may outlive the track
+        std::shared_ptr<LoopSource> loopSource;
+        // Sample marked by setLoopIn, -1 when there is none
+        juce::int64 loopIn = -1;
+    };
+
+    class PreloadJob;
+    class DecodeJob;
+    class RegionFillJob;
+
+    using SeekIndexPtr = std::shared_ptr<const Mp3SeekIndex>;
+
+    // Safe to call from the loader thread
+    std::unique_ptr<PreparedTrack> prepareTrack(const juce::URL& audioURL, const TrackDetails& details,
+                                                bool useReadAhead, int bufferSizeSamples);
+    void prerollTrack(PreparedTrack& track);
+    // The track's seek index, read from the store when the details only say it has one
+    SeekIndexPtr loadSeekIndex(const juce::URL& audioURL, const TrackDetails& details);
+    // Decode the track into the PCM cache unless it is already there, loader thread only
+    void decodeToCache(const juce::URL& audioURL, const SeekIndexPtr& seekIndex, const std::function<bool()>& shouldStop);
+    // A reader over the track's file, through its seek index when it has one that still matches
+    std::unique_ptr<juce::AudioFormatReader> createFileReader(const juce::URL& audioURL, const SeekIndexPtr& seekIndex);
+    // A reader over the track's copy in the PCM cache, nullptr if there is none
+    std::unique_ptr<juce::AudioFormatReader> createDecodedReader(const juce::URL& audioURL);
+    void installTrack(int slot, std::unique_ptr<PreparedTrack> track);
+    void clearSlot(int slot);
+
+    // The track the deck is playing, nullptr if there is none
+    PreparedTrack* getCurrentTrack() const;
+    // Samples of the track per beat, at 120 BPM without a grid
+    double getBeatSamples(const PreparedTrack& track) const;
+    // Multiple of a number of beats on the track's grid near a sample, the sample itself without a grid
+    enum class Snap { nearest, down, up };
+    juce::int64 snapToGrid(const PreparedTrack& track, juce::int64 sample, double beats, Snap snap) const;
+    // Start looping between two samples and get the loop decoded into memory
+    void engageLoop(PreparedTrack& track, juce::int64 start, juce::int64 end);
+    // Get the audio around a hot cue decoded into memory, or dropped when the cue is not set
+    void holdHotCue(PreparedTrack& track, int index);
+    // Crossfade to a sample while playing, a plain seek while stopped
+    void jumpTo(PreparedTrack& track, juce::int64 sample);
+
+    // Checks on the auto-mix, arming the next transition and tidying up after a finished one
+    void timerCallback() override;
+    void armNextTrack();
+    void completeTransition();
+    // Stop any transition so a track can be loaded by hand
+    void cancelTransition();
+
+    // Audio thread, read the parameters once and move the smoothed values on by a block
+    void applyParameters(int numSamples);
+    void applyGain(const juce::AudioSourceChannelInfo& bufferToFill);
+
+    juce::AudioTransportSource& currentTransport();
+    const juce::AudioTransportSource& currentTransport() const;
+
     juce::AudioFormatManager& formatManager;
-    std::unique_ptr<juce::AudioFormatReaderSource> readerSource;
-    juce::AudioTransportSource transportSource;
-    juce::ResamplingAudioSource resampleSource{ &transportSource, false, 2 };
+    std::atomic<PcmCache*> pcmCache{ nullptr };
+    SeekIndexStore* seekIndexStore;
+
+    juce::TimeSliceThread* readAheadThread;
+    bool readAheadEnabled = true;
+    int readAheadSamples = defaultReadAheadSamples;
+    std::atomic<int> underrunCount{ 0 };
+
+    // Background preparation of the next queued track
+    juce::ThreadPool loaderPool{ 1 };
+    // Loops and hot cues are decoded on their own thread so they never wait behind a whole track
+    juce::ThreadPool loopPool{ 1 };
+    // Length of the next loop, message thread only
+    double loopBeats = defaultLoopBeats;
+    juce::CriticalSection preparedLock;
+    std::unique_ptr<PreparedTrack> preparedTrack;
+
+    // Device settings, so preloaded tracks can be buffered for them in advance
+    std::atomic<int> deviceBlockSize{ 0 };
+    std::atomic<double> deviceSampleRate{ 0.0 };
+
+    // Load latency measurement
+    std::atomic<juce::int64> loadTicks{ 0 };
+    std::atomic<juce::int64> waitingSinceTicks{ 0 };
+    std::atomic<bool> awaitingFirstBlock{ false };
+    std::atomic<double> lastLoadLatencyMs{ 0.0 };
+
+    // Playhead stamp, written once per block by the audio thread. The sequence
+    // is odd while the fields are being written, readers retry until it is even and unchanged.
+    void publishPlayhead(const PlayheadStamp& stamp);
+    std::atomic<juce::uint32> stampSequence{ 0 };
+    std::atomic<double> stampPosition{ 0.0 };
+    std::atomic<double> stampLength{ 0.0 };
+    std::atomic<double> stampRate{ 0.0 };
+    std::atomic<juce::int64> stampTicks{ 0 };
+    // Speed of the block being played, audio thread only
+    double currentSpeed = 1.0;
+
+    bool autoMixEnabled = false;
+    double crossfadeSeconds = defaultCrossfadeSeconds;
+
+    // Two transports so the next track can fade in while the current one ends,
+    // each with the track it is playing
+    juce::AudioTransportSource transportSources[2];
+    std::unique_ptr<PreparedTrack> slotTracks[2];
+    AutoMixSource autoMixSource{ transportSources[0], transportSources[1] };
+
+    TimeStretcher timeStretcher{ &autoMixSource, 2 };
+    PolyphaseResampler resampleSource{ &timeStretcher, 2 };
 
     // Variables for manipulating the reverb of the resampleSource
     juce::ReverbAudioSource reverbSource{ &resampleSource, false };
-    // Stores the reverb Parameters
+
+    // Latest values from the setters, written by the message thread
+    std::atomic<float> gainTarget{ 1.0f };
+    std::atomic<double> speedTarget{ 1.0 };
+    std::atomic<bool> keyLockEnabled{ false };
+    // Set when the track position jumps, the stretcher's buffered audio is then stale
+    std::atomic<bool> positionJumped{ false };
+    std::atomic<float> reverbBalanceTarget{ 0.5f };
+    std::atomic<float> reverbDampingTarget{ 0.5f };
+    std::atomic<float> reverbRoomSizeTarget{ 0.5f };
+
+    // Auto gain of the track in each transport slot. A set jump flag makes the audio
+    // thread start at the target instead of gliding to it.
+    std::atomic<bool> autoGainEnabled{ false };
+    std::atomic<float> autoGainTargets[2]{ { 1.0f }, { 1.0f } };
+    std::atomic<bool> autoGainJumps[2]{ { false }, { false } };
+
+    // Audio thread only. The reverb smooths its own parameters per sample.
+    juce::SmoothedValue<float> gainSmoother{ 1.0f };
+    // Handed to the transports, which ramp to each new value over a block
+    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative> autoGainSmoothers[2];
+    juce::SmoothedValue<double, juce::ValueSmoothingTypes::Multiplicative> speedSmoother{ 1.0 };
+    // Reverb Parameters last handed to the reverb
     juce::Reverb::Parameters reverbParameters;
 
 };
@@ -6,12 +6,11 @@
 //==============================================================================
 DeckGUI::DeckGUI(DJAudioPlayer* _player,
 				PlaylistComponent* _playlistComponent,
-				juce::AudioFormatManager& formatManagerToUse,
-				juce::AudioThumbnailCache& cacheToUse,
+				WaveformLoader& waveformLoaderToUse,
 				int channelToUse
 				) : player(_player),
 				playlistComponent(_playlistComponent),
-				waveformDisplay(formatManagerToUse, cacheToUse),
+				waveformDisplay(waveformLoaderToUse),
 				channel(channelToUse)
 {
 	// Add buttons for each GUI 
@@ -19,12 +18,33 @@ DeckGUI::DeckGUI(DJAudioPlayer* _player,
 	addAndMakeVisible(stopButton);
 	addAndMakeVisible(nextButton);
 	addAndMakeVisible(loop);
+	addAndMakeVisible(autoMix);
+	addAndMakeVisible(keyLock);
+	addAndMakeVisible(loopInButton);
+	addAndMakeVisible(loopOutButton);
+	addAndMakeVisible(loopHalveButton);
+	addAndMakeVisible(loopDoubleButton);
 
 	// Adding listeners to buttons
 	playButton.addListener(this);
 	stopButton.addListener(this);
 	nextButton.addListener(this);
 	loop.addListener(this);
+	autoMix.addListener(this);
+	keyLock.addListener(this);
+	loopInButton.addListener(this);
+	loopOutButton.addListener(this);
+	loopHalveButton.addListener(this);
+	loopDoubleButton.addListener(this);
+	updateLoopButton();
+
+	for (int i = 0; i < HotCues::numCues; ++i)
+	{
+		addAndMakeVisible(hotCueButtons[i]);
+		hotCueButtons[i].setButtonText(juce::String(i + 1));
+		hotCueButtons[i].setColour(juce::TextButton::buttonOnColourId, juce::Colours::rosybrown);
+		hotCueButtons[i].addListener(this);
+	}
 
 	// Add sliders for each GUI and customizing each of them
 	addAndMakeVisible(posSlider);
@@ -104,6 +124,11 @@ DeckGUI::DeckGUI(DJAudioPlayer* _player,
 	getLookAndFeel().setColour(juce::Slider::trackColourId, juce::Colours::lightslategrey); // Body
 	getLookAndFeel().setColour(juce::Slider::rotarySliderFillColourId, juce::Colours::lightslategrey); // Body
 
+	// Show how often the read-ahead buffer could not keep up
+	addAndMakeVisible(underrunLabel);
+	underrunLabel.setText("Underruns: 0\nLoad: -\nPaint: -", juce::dontSendNotification);
+	underrunLabel.setJustificationType(juce::Justification::centred);
+
 	// Add waveform to each GUI
 	addAndMakeVisible(waveformDisplay);
 
@@ -112,20 +137,91 @@ DeckGUI::DeckGUI(DJAudioPlayer* _player,
 	upNext.setModel(this);
 	addAndMakeVisible(upNext);
 
+	// Preload tracks as soon as they are queued for this deck
+	playlistComponent->addChangeListener(this);
+	player->onAutoMixTransition = [this] { autoMixAdvanced(); };
+
 	// Start thread calling 10 times per second (once every 0.1 sec)
+#if JUCE_MAJOR_VERSION >= 7
+	// The playhead follows the display's refresh through vBlank, the timer only updates the labels
 	startTimer(100);
+#else
+	// No vblank callback before JUCE 7, move the playhead at a typical display rate instead
+	startTimerHz(60);
+#endif
 }
 
 DeckGUI::~DeckGUI()
 {
+	playlistComponent->removeChangeListener(this);
+	player->onAutoMixTransition = nullptr;
 	stopTimer();
 }
 
 void DeckGUI::timerCallback()
+{
+#if JUCE_MAJOR_VERSION < 7
+	updatePlayhead();
+#endif
+	underrunLabel.setText("Underruns: " + juce::String(player->getUnderrunCount())
+		+ "\nLoad: " + juce::String(player->getLastLoadLatencyMs(), 1) + " ms"
+		+ "\nPaint: " + juce::String(waveformDisplay.getAveragePaintMs(), 2) + " ms", juce::dontSendNotification);
+	// Loops also start from loop out and end when a new track loads, cues change with the track
+	updateLoopButton();
+	updateHotCueButtons();
+}
+
+void DeckGUI::updateLoopButton()
+{
+	double beats = player->getLoopLength();
+	juce::String length = beats >= 1.0 ? juce::String(beats, beats == std::floor(beats) ? 0 : 2)
+										: "1/" + juce::String(juce::roundToInt(1.0 / beats));
+	loop.setButtonText("LOOP " + length);
+	loop.setToggleState(player->isLooping(), juce::dontSendNotification);
+}
+
+void DeckGUI::hotCueClicked(int index)
+{
+	if (juce::ModifierKeys::currentModifiers.isShiftDown())
+	{
+		player->clearHotCue(index);
+	}
+	else if (! player->getHotCues().isSet(index))
+	{
+		player->setHotCue(index);
+	}
+	else
+	{
+		player->jumpToHotCue(index);
+		updateLoopButton();
+		return;
+	}
+
+	// Keep the cues with the track in the library
+	playlistComponent->setHotCues(loadedTrack, player->getHotCues());
+	updateHotCueButtons();
+}
+
+void DeckGUI::updateHotCueButtons()
+{
+	HotCues cues = player->getHotCues();
+	for (int i = 0; i < HotCues::numCues; ++i)
+	{
+		hotCueButtons[i].setToggleState(cues.isSet(i), juce::dontSendNotification);
+	}
+}
+
+void DeckGUI::updatePlayhead()
 {
 	waveformDisplay.setPositionRelative(player->getPositionRelative());
 }
 
+void DeckGUI::changeListenerCallback(juce::ChangeBroadcaster* source)
+{
+	upNext.updateContent();
+	preloadNext();
+}
+
 void DeckGUI::paint(juce::Graphics& g)
 {
 
@@ -139,14 +235,28 @@ void DeckGUI::resized()
 	playButton.setBounds(colW + 10, rowH * 5.5 + 5, colW - 20, rowH - 40);
 	stopButton.setBounds(colW * 2 + 10, rowH * 5.5 + 5, colW - 20, rowH - 40);
 	nextButton.setBounds(colW * 3 + 10, rowH * 5.5 + 5, colW - 20, rowH - 40);
+	underrunLabel.setBounds(0, rowH * 5.5 + 5, colW, rowH - 40);
 
-	posSlider.setBounds(0, rowH * 2 - 10, getWidth(), rowH);
+	posSlider.setBounds(0, rowH * 2 - 5, getWidth(), rowH * 0.35);
+
+	// Hot cue pads in a row under the position slider
+	double cueW = (colW * 2.5 - 10) / HotCues::numCues;
+	for (int i = 0; i < HotCues::numCues; ++i)
+	{
+		hotCueButtons[i].setBounds(5 + cueW * i, rowH * 2.35, cueW - 4, rowH * 0.3);
+	}
 
 	volSlider.setBounds(0, rowH * 3, colW, rowH - 30);
 	speedSlider.setBounds(colW, rowH * 3 - 15, colW * 1.25, rowH * 1.25);
 	
 	upNext.setBounds(colW * 2.5, rowH * 2.5, colW * 1.5 - 10, rowH * 1.5);
-	loop.setBounds(colW * 2.5, rowH * 4, colW * 1.5 - 10, rowH - 20);
+	loop.setBounds(colW * 2.5, rowH * 4, colW * 0.75 - 5, rowH * 0.5 - 5);
+	autoMix.setBounds(colW * 3.25, rowH * 4, colW * 0.75 - 5, rowH * 0.5 - 5);
+	keyLock.setBounds(colW * 2.5, rowH * 4.5, colW * 0.75 - 5, rowH * 0.5 - 20);
+	loopInButton.setBounds(colW * 3.25, rowH * 4.5, colW * 0.375 - 5, rowH * 0.5 - 20);
+	loopOutButton.setBounds(colW * 3.625, rowH * 4.5, colW * 0.375 - 10, rowH * 0.5 - 20);
+	loopHalveButton.setBounds(colW * 3.5, rowH * 5, colW * 0.25 - 5, rowH * 0.5 - 20);
+	loopDoubleButton.setBounds(colW * 3.75, rowH * 5, colW * 0.25 - 10, rowH * 0.5 - 20);
 
 	reverbBalanceSlider.setBounds(0, rowH * 4, colW, rowH);
 	dryLabel.setBounds(0, rowH * 5, colW, rowH * 0.25);
@@ -176,9 +286,10 @@ void DeckGUI::buttonClicked(juce::Button* button)
 		if (channel == 0 && playlistComponent->playListL.size() > 0) //handle only if there are songs added 
 		{
 			// Get URL to first song of Left playlist
-			juce::URL fileURL = juce::URL{ juce::File{playlistComponent->playListL[0]} };
+			juce::URL fileURL = getQueuedURL(playlistComponent->playListL[0]);
 			// Load the first URL 
-			player->loadURL(fileURL);
+			player->loadURL(fileURL, getQueuedDetails(playlistComponent->playListL[0]));
+			loadedTrack = playlistComponent->playListL[0];
 			// Display the waveforms
 			waveformDisplay.loadURL(fileURL);
 			// Pop the first URL of the Left playlist so it doesn't replay
@@ -189,9 +300,10 @@ void DeckGUI::buttonClicked(juce::Button* button)
 		if (channel == 1 && playlistComponent->playListR.size() > 0)
 		{
 			// Get URL to first song of playlist
-			juce::URL fileURL = juce::URL{ juce::File{playlistComponent->playListR[0]} };
+			juce::URL fileURL = getQueuedURL(playlistComponent->playListR[0]);
 			// Load the first URL 
-			player->loadURL(fileURL);
+			player->loadURL(fileURL, getQueuedDetails(playlistComponent->playListR[0]));
+			loadedTrack = playlistComponent->playListR[0];
 			// Display the waveforms
 			waveformDisplay.loadURL(fileURL);
 			// Pop the first URL of the Right playlist so it doesn't replay
@@ -207,6 +319,9 @@ void DeckGUI::buttonClicked(juce::Button* button)
 		{
 			player->start(); // Starts player each time button labeled next is clicks
 		}
+
+		// Get the new head of the queue ready for the next press
+		preloadNext();
 	}
 	if (button == &loop)
 	{
@@ -219,6 +334,44 @@ void DeckGUI::buttonClicked(juce::Button* button)
 			player->unsetLoop();
 		}
 	}
+	// Loop in and out snap to the beat grid, halving and doubling keep the loop start
+	if (button == &loopInButton)
+	{
+		player->setLoopIn();
+	}
+	if (button == &loopOutButton)
+	{
+		player->setLoopOut();
+	}
+	if (button == &loopHalveButton)
+	{
+		player->halveLoop();
+	}
+	if (button == &loopDoubleButton)
+	{
+		player->doubleLoop();
+	}
+	if (button == &loop || button == &loopOutButton || button == &loopHalveButton || button == &loopDoubleButton)
+	{
+		updateLoopButton();
+	}
+	for (int i = 0; i < HotCues::numCues; ++i)
+	{
+		if (button == &hotCueButtons[i])
+		{
+			hotCueClicked(i);
+		}
+	}
+	if (button == &autoMix)
+	{
+		// Crossfade into the next queued track as the current one ends
+		player->setAutoMix(autoMix.getToggleState(), DJAudioPlayer::defaultCrossfadeSeconds);
+	}
+	if (button == &keyLock)
+	{
+		// Speed changes tempo only, the pitch stays where it is
+		player->setKeyLock(keyLock.getToggleState());
+	}
 
 	// Refresh up next table whenever a button is clicked
 	upNext.updateContent();
@@ -282,27 +435,101 @@ void DeckGUI::paintCell(juce::Graphics& g,
 	int height,
 	bool rowIsSelected)
 {
-	std::string filepath = "";
+	TrackId id = TrackTable::invalidTrack;
 
-	// Get file path depending on channel
+	// Get queued track depending on channel
 	if (channel == 0) // Left
 	{
-		filepath = playlistComponent->playListL[rowNumber];
+		id = playlistComponent->playListL[rowNumber];
 	}
 	if (channel == 1) // Right
 	{
-		filepath = playlistComponent->playListR[rowNumber];
+		id = playlistComponent->playListR[rowNumber];
+	}
+
+	const TrackTable& tracks = playlistComponent->getTrackTable();
+	if (! tracks.isValid(id))
+	{
+		return;
 	}
 
-	// Extract file name from path 
-	std::size_t startFilePos = filepath.find_last_of("\\");
-	std::size_t startExtPos = filepath.find_last_of(".");
-	std::string extn = filepath.substr(startExtPos + 1, filepath.length() - startExtPos);
-	std::string file = filepath.substr(startFilePos + 1, filepath.length() - startFilePos - extn.size() - 2);
 	// Draw name to each cell
-	g.drawText(file,
+	g.drawText(tracks.getTitle(id),
 		1, rowNumber,
 		width - 4, height,
 		juce::Justification::centredLeft,
 		true);
 }
+
+void DeckGUI::preloadNext()
+{
+	TrackId next = TrackTable::invalidTrack;
+	if (channel == 0 && playlistComponent->playListL.size() > 0)
+	{
+		next = playlistComponent->playListL[0];
+	}
+	if (channel == 1 && playlistComponent->playListR.size() > 0)
+	{
+		next = playlistComponent->playListR[0];
+	}
+
+	if (next == preloadedTrack)
+	{
+		return;
+	}
+	preloadedTrack = next;
+
+	// An empty URL drops whatever was preloaded before
+	juce::URL fileURL = getQueuedURL(next);
+	player->preloadURL(fileURL, getQueuedDetails(next));
+	waveformDisplay.preloadURL(fileURL);
+}
+
+void DeckGUI::autoMixAdvanced()
+{
+	juce::URL fileURL;
+
+	// The track now playing is the head of the queue, drop it like NEXT does
+	if (channel == 0 && playlistComponent->playListL.size() > 0)
+	{
+		fileURL = getQueuedURL(playlistComponent->playListL[0]);
+		loadedTrack = playlistComponent->playListL[0];
+		playlistComponent->playListL.erase(playlistComponent->playListL.begin());
+	}
+	if (channel == 1 && playlistComponent->playListR.size() > 0)
+	{
+		fileURL = getQueuedURL(playlistComponent->playListR[0]);
+		loadedTrack = playlistComponent->playListR[0];
+		playlistComponent->playListR.erase(playlistComponent->playListR.begin());
+	}
+
+	waveformDisplay.loadURL(fileURL);
+	upNext.updateContent();
+	preloadNext();
+}
+
+// URL of a queued track, empty if it has been removed from the library
+juce::URL DeckGUI::getQueuedURL(TrackId id) const
+{
+	const TrackTable& tracks = playlistComponent->getTrackTable();
+	if (! tracks.isValid(id))
+	{
+		return {};
+	}
+	return juce::URL{ juce::File{ tracks.getFilepath(id) } };
+}
+
+// Library details of a queued track, empty if it has been removed
+DJAudioPlayer::TrackDetails DeckGUI::getQueuedDetails(TrackId id) const
+{
+	DJAudioPlayer::TrackDetails details;
+	const TrackTable& tracks = playlistComponent->getTrackTable();
+	if (tracks.isValid(id))
+	{
+		details.hasSeekIndex = tracks.hasSeekIndex(id);
+		details.beatGrid = tracks.getAnalysis(id).beatGrid;
+		details.hotCues = tracks.getHotCues(id);
+		details.loudness = tracks.getAnalysis(id).loudness;
+	}
+	return details;
+}
@@ -9,13 +9,13 @@ class DeckGUI : public juce::Component,
     public juce::Button::Listener,
     public juce::Slider::Listener,
     public juce::TableListBoxModel,
-    public juce::Timer
+    public juce::Timer,
+    public juce::ChangeListener
 {
     public:
         DeckGUI(DJAudioPlayer* player,
                 PlaylistComponent* playerComponent,
-                juce::AudioFormatManager& formatManagerToUse,
-                juce::AudioThumbnailCache& cacheToUse, 
+                WaveformLoader& waveformLoaderToUse,
                 int channelToUse);
         ~DeckGUI() override;
 
@@ -43,12 +43,23 @@ class DeckGUI : public juce::Component,
 
         void timerCallback() override;
 
+        // Called when a track is queued in the playlist
+        void changeListenerCallback(juce::ChangeBroadcaster* source) override;
+
     private:
         juce::FileChooser fChooser{ "Select a file..." };
         juce::TextButton playButton{ "PLAY" };
         juce::TextButton stopButton{ "STOP" };
         juce::TextButton nextButton{ "LOAD" };
         juce::ToggleButton loop{ "LOOP" };
+        juce::ToggleButton autoMix{ "AUTO MIX" };
+        juce::ToggleButton keyLock{ "KEY LOCK" };
+        juce::TextButton loopInButton{ "IN" };
+        juce::TextButton loopOutButton{ "OUT" };
+        juce::TextButton loopHalveButton{ "/2" };
+        juce::TextButton loopDoubleButton{ "x2" };
+        // An empty pad sets a cue at the playhead, a set one jumps to it, shift-click clears it
+        juce::TextButton hotCueButtons[HotCues::numCues];
 
         juce::Slider volSlider;
         juce::Slider speedSlider;
@@ -57,6 +68,8 @@ class DeckGUI : public juce::Component,
         // Add labels to sliders 
         juce::Label volLabel;
         juce::Label speedLabel;
+        // Read-ahead underruns and load latency reported by the player, and waveform paint time
+        juce::Label underrunLabel;
 
         // Control visual theme
         juce::LookAndFeel_V4 lookandfeel;
@@ -69,6 +82,12 @@ class DeckGUI : public juce::Component,
         // Create waveform visual
         WaveformDisplay waveformDisplay;
 
+        // Move the playhead once per displayed frame
+        void updatePlayhead();
+#if JUCE_MAJOR_VERSION >= 7
+        juce::VBlankAttachment vBlank{ this, [this] { updatePlayhead(); } };
+#endif
+
         // Create table containing list of upcoming songs in the playlist
         juce::TableListBox upNext;
 
@@ -89,5 +108,24 @@ class DeckGUI : public juce::Component,
         juce::Slider reverbRoomSizeSlider;
         juce::Label reverbRoomSizeLabel;
 
+        juce::URL getQueuedURL(TrackId id) const;
+        // Seek index, beat grid and hot cues the library holds for a queued track
+        DJAudioPlayer::TrackDetails getQueuedDetails(TrackId id) const;
+
+        // Show whether the deck is looping and the loop length on the loop toggle
+        void updateLoopButton();
+
+        void hotCueClicked(int index);
+        // Light the pads of the cues set on the track playing
+        void updateHotCueButtons();
+
+        // Open and thumbnail the head of this deck's queue in the background
+        void preloadNext();
+        // The player has crossfaded into the head of the queue by itself
+        void autoMixAdvanced();
+        TrackId preloadedTrack = TrackTable::invalidTrack;
+        // Library track the player is playing, its hot cues are stored against it
+        TrackId loadedTrack = TrackTable::invalidTrack;
+
         JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DeckGUI)
 };
@@ -0,0 +1,161 @@
+#include "DeckMixer.h"
+
+DeckMixer::DeckMixer(juce::AudioSource& _leftDeck, juce::AudioSource& _rightDeck)
+	: leftDeck(_leftDeck),
+	  rightDeck(_rightDeck)
+{
+}
+
+DeckMixer::~DeckMixer()
+{
+}
+
+//==============================================================================
+void DeckMixer::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+	leftDeck.prepareToPlay(samplesPerBlockExpected, sampleRate);
+	rightDeck.prepareToPlay(samplesPerBlockExpected, sampleRate);
+
+	// Everything the callback needs is allocated here, larger blocks are mixed in sections
+	maxBlockSize = juce::jmax(1, samplesPerBlockExpected);
+	rightBuffer.setSize(2, maxBlockSize);
+	leftGains.allocate((size_t) maxBlockSize, true);
+	rightGains.allocate((size_t) maxBlockSize, true);
+
+	// 20 ms ramps, short enough to feel instant and long enough not to click
+	float left, right;
+	getCrossfadeGains((CrossfadeCurve) crossfadeCurve.load(), crossfaderPosition, left, right);
+	leftGain.reset(sampleRate, 0.02);
+	rightGain.reset(sampleRate, 0.02);
+	leftGain.setCurrentAndTargetValue(left * masterGain);
+	rightGain.setCurrentAndTargetValue(right * masterGain);
+}
+
+void DeckMixer::releaseResources()
+{
+	leftDeck.releaseResources();
+	rightDeck.releaseResources();
+	rightBuffer.setSize(0, 0);
+	leftGains.free();
+	rightGains.free();
+	maxBlockSize = 0;
+}
+
+void DeckMixer::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+	if (maxBlockSize == 0)
+	{
+		bufferToFill.clearActiveBufferRegion();
+		return;
+	}
+
+	// Read the parameters once per block, the master gain folds into each deck's gain
+	float left, right;
+	getCrossfadeGains((CrossfadeCurve) crossfadeCurve.load(), crossfaderPosition, left, right);
+	float master = masterGain;
+	leftGain.setTargetValue(left * master);
+	rightGain.setTargetValue(right * master);
+
+	for (int done = 0; done < bufferToFill.numSamples; done += maxBlockSize)
+	{
+		juce::AudioSourceChannelInfo section(bufferToFill.buffer,
+											 bufferToFill.startSample + done,
+											 juce::jmin(maxBlockSize, bufferToFill.numSamples - done));
+		mixSection(section);
+	}
+}
+
+void DeckMixer::mixSection(const juce::AudioSourceChannelInfo& section)
+{
+	int numSamples = section.numSamples;
+	int numChannels = section.buffer->getNumChannels();
+
+	// The left deck renders straight into the output, the right deck into its own buffer
+	leftDeck.getNextAudioBlock(section);
+	juce::AudioSourceChannelInfo rightInfo(&rightBuffer, 0, numSamples);
+	rightDeck.getNextAudioBlock(rightInfo);
+
+	if (! leftGain.isSmoothing() && ! rightGain.isSmoothing())
+	{
+		float left = leftGain.getTargetValue();
+		float right = rightGain.getTargetValue();
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			float* out = section.buffer->getWritePointer(channel, section.startSample);
+			juce::FloatVectorOperations::multiply(out, left, numSamples);
+			if (channel < rightBuffer.getNumChannels())
+			{
+				juce::FloatVectorOperations::addWithMultiply(out, rightBuffer.getReadPointer(channel), right, numSamples);
+			}
+		}
+		return;
+	}
+
+	// Ramping, work out the gain of every sample once and apply it to each channel
+	for (int i = 0; i < numSamples; ++i)
+	{
+		leftGains[i] = leftGain.getNextValue();
+		rightGains[i] = rightGain.getNextValue();
+	}
+	for (int channel = 0; channel < numChannels; ++channel)
+	{
+		float* out = section.buffer->getWritePointer(channel, section.startSample);
+		juce::FloatVectorOperations::multiply(out, leftGains, numSamples);
+		if (channel < rightBuffer.getNumChannels())
+		{
+			juce::FloatVectorOperations::addWithMultiply(out, rightBuffer.getReadPointer(channel), rightGains, numSamples);
+		}
+	}
+}
+
+//==============================================================================
+void DeckMixer::setCrossfader(float position)
+{
+	if (position < 0 || position > 1.0f)
+	{
+		DBG("DeckMixer::setCrossfader - position is out of range, should be between 0 - 1");
+		return;
+	}
+	crossfaderPosition = position;
+}
+
+void DeckMixer::setCrossfadeCurve(CrossfadeCurve curve)
+{
+	crossfadeCurve = (int) curve;
+}
+
+void DeckMixer::setMasterGain(float gain)
+{
+	if (gain < 0 || gain > 2.0f)
+	{
+		DBG("DeckMixer::setMasterGain - gain is out of range, should be between 0 - 2");
+		return;
+	}
+	masterGain = gain;
+}
+
+void DeckMixer::getCrossfadeGains(CrossfadeCurve curve, float position, float& leftGain, float& rightGain)
+{
+	leftGain = 1.0f;
+	rightGain = 1.0f;
+	switch (curve)
+	{
+		case CrossfadeCurve::linear:
+			// Both decks at half gain in the middle
+			leftGain = 1.0f - position;
+			rightGain = position;
+			break;
+
+		case CrossfadeCurve::constantPower:
+			// Same loudness all the way across for unrelated tracks
+			leftGain = std::cos(position * juce::MathConstants<float>::halfPi);
+			rightGain = std::sin(position * juce::MathConstants<float>::halfPi);
+			break;
+
+		case CrossfadeCurve::sharpCut:
+			// Both decks at full gain except right at the ends, for cutting and scratching
+			leftGain = juce::jmin(1.0f, (1.0f - position) * 16.0f);
+			rightGain = juce::jmin(1.0f, position * 16.0f);
+			break;
+	}
+}
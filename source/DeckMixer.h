@@ -0,0 +1,56 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+
+// Sums the two decks into the output through a crossfader and a master gain.
+// Parameters are written from the message thread into atomics and picked up
+// once per block; gain changes are ramped so they never click. Summing uses
+// vector operations on buffers allocated in prepareToPlay, and nothing is
+// locked or allocated on the audio thread.
+class DeckMixer : public juce::AudioSource
+{
+public:
+    // Shape of the crossfader, how each deck's gain falls as the fader moves away from it
+    enum class CrossfadeCurve
+    {
+        linear = 1,
+        constantPower,
+        sharpCut
+    };
+
+    DeckMixer(juce::AudioSource& _leftDeck, juce::AudioSource& _rightDeck);
+    ~DeckMixer() override;
+
+    //==============================================================================
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+    // 0 is the left deck only, 1 the right deck only
+    void setCrossfader(float position);
+    void setCrossfadeCurve(CrossfadeCurve curve);
+    // Linear gain applied to the sum of both decks (0 - 2)
+    void setMasterGain(float gain);
+
+    // Gains each deck gets at a crossfader position
+    static void getCrossfadeGains(CrossfadeCurve curve, float position, float& leftGain, float& rightGain);
+
+private:
+    void mixSection(const juce::AudioSourceChannelInfo& section);
+
+    juce::AudioSource& leftDeck;
+    juce::AudioSource& rightDeck;
+
+    std::atomic<float> crossfaderPosition{ 0.5f };
+    std::atomic<int> crossfadeCurve{ (int) CrossfadeCurve::constantPower };
+    std::atomic<float> masterGain{ 1.0f };
+
+    // Audio thread only
+    juce::AudioBuffer<float> rightBuffer;
+    juce::HeapBlock<float> leftGains, rightGains;
+    int maxBlockSize = 0;
+    juce::SmoothedValue<float> leftGain{ 1.0f }, rightGain{ 1.0f };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DeckMixer)
+};
@@ -0,0 +1,67 @@
+#include "HotCues.h"
+
+HotCues::HotCues()
+{
+	for (double& cue : seconds)
+	{
+		cue = -1.0;
+	}
+}
+
+bool HotCues::isSet(int index) const
+{
+	return getSeconds(index) >= 0.0;
+}
+
+double HotCues::getSeconds(int index) const
+{
+	return index >= 0 && index < numCues ? seconds[index] : -1.0;
+}
+
+void HotCues::set(int index, double cueSeconds)
+{
+	if (index >= 0 && index < numCues)
+	{
+		seconds[index] = juce::jmax(0.0, cueSeconds);
+	}
+}
+
+void HotCues::clear(int index)
+{
+	if (index >= 0 && index < numCues)
+	{
+		seconds[index] = -1.0;
+	}
+}
+
+bool HotCues::isEmpty() const
+{
+	for (int i = 0; i < numCues; ++i)
+	{
+		if (isSet(i))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void HotCues::writeTo(juce::OutputStream& out) const
+{
+	for (double cue : seconds)
+	{
+		out.writeDouble(cue);
+	}
+}
+
+void HotCues::readFrom(juce::InputStream& in)
+{
+	for (double& cue : seconds)
+	{
+		cue = in.readDouble();
+		if (cue < 0.0)
+		{
+			cue = -1.0;
+		}
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// The hot cues set on a track, stored with it in the library. Times are in
+// seconds of the decoded track, like the beat grid.
+struct HotCues
+{
+    static constexpr int numCues = 8;
+
+    HotCues();
+
+    bool isSet(int index) const;
+    // Seconds into the track, negative when the cue is not set
+    double getSeconds(int index) const;
+    void set(int index, double seconds);
+    void clear(int index);
+
+    // True when no cue is set
+    bool isEmpty() const;
+
+    void writeTo(juce::OutputStream& out) const;
+    void readFrom(juce::InputStream& in);
+
+private:
+    double seconds[numCues];
+};
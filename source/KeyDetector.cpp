@@ -0,0 +1,186 @@
+#include "KeyDetector.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// Notes from C2 to B6 carry the harmony, below is mostly kick drum and above mostly overtones
+	const int lowestNote = 36;
+	const int highestNote = 95;
+	// A Hann window only tells apart peaks two bins or more apart, lower notes are
+	// left out where their semitones are closer than that
+	const double minBinsPerSemitone = 2.0;
+
+	// Krumhansl-Kessler key profiles, from the tonic up
+	const double majorProfile[12] = { 6.35, 2.23, 3.48, 2.33, 4.38, 4.09, 2.52, 5.19, 2.39, 3.66, 2.29, 2.88 };
+	const double minorProfile[12] = { 6.33, 2.68, 3.52, 5.38, 2.60, 3.53, 2.54, 4.75, 3.98, 2.69, 3.34, 3.17 };
+
+	double correlate(const double* chroma, const double* profile, int tonic)
+	{
+		double chromaMean = 0.0;
+		double profileMean = 0.0;
+		for (int i = 0; i < 12; ++i)
+		{
+			chromaMean += chroma[i];
+			profileMean += profile[i];
+		}
+		chromaMean /= 12.0;
+		profileMean /= 12.0;
+
+		double product = 0.0;
+		double chromaSquares = 0.0;
+		double profileSquares = 0.0;
+		for (int i = 0; i < 12; ++i)
+		{
+			double c = chroma[(tonic + i) % 12] - chromaMean;
+			double p = profile[i] - profileMean;
+			product += c * p;
+			chromaSquares += c * c;
+			profileSquares += p * p;
+		}
+		return chromaSquares > 0.0 ? product / std::sqrt(chromaSquares * profileSquares) : 0.0;
+	}
+}
+
+KeyDetector::KeyDetector(double _sampleRate)
+	: frame((size_t) fftSize),
+	  fftData((size_t) fftSize * 2)
+{
+	auto noteToBin = [_sampleRate](double note)
+	{
+		return 440.0 * std::pow(2.0, (note - 69.0) / 12.0) * fftSize / _sampleRate;
+	};
+
+	firstNote = lowestNote;
+	while (firstNote < highestNote && noteToBin(firstNote + 0.5) - noteToBin(firstNote - 0.5) < minBinsPerSemitone)
+	{
+		++firstNote;
+	}
+
+	// Each bin belongs to the note nearest to it, the bins of a note run up to the first bin of the next.
+	// The neighbours either side of the range are read for peak picking, so the range stays clear of both ends.
+	for (int note = firstNote; note <= highestNote + 1; ++note)
+	{
+		int bin = juce::jlimit(1, fftSize / 2 - 1, (int) std::ceil(noteToBin(note - 0.5)));
+		noteBins.push_back(bin);
+	}
+
+	// Pitch classes can cover a different number of octaves, each is averaged over its own
+	for (int note = firstNote; note <= highestNote; ++note)
+	{
+		notesPerPitchClass[note % 12] += 1.0;
+	}
+}
+
+void KeyDetector::process(const float* samples, int numSamples)
+{
+	while (numSamples > 0)
+	{
+		int count = juce::jmin(numSamples, fftSize - frameFill);
+		std::copy(samples, samples + count, frame.begin() + frameFill);
+		frameFill += count;
+		samples += count;
+		numSamples -= count;
+
+		if (frameFill == fftSize)
+		{
+			processFrame();
+			// Frames overlap by half
+			std::copy(frame.begin() + hopSize, frame.end(), frame.begin());
+			frameFill = fftSize - hopSize;
+		}
+	}
+}
+
+void KeyDetector::processFrame()
+{
+	std::copy(frame.begin(), frame.end(), fftData.begin());
+	window.multiplyWithWindowingTable(fftData.data(), (size_t) fftSize);
+	fft.performFrequencyOnlyForwardTransform(fftData.data());
+
+	// Each note takes its strongest spectral peak, so a note counts the same however many
+	// bins it covers and the skirts of a neighbour's peak do not count towards it.
+	// Square root compression keeps a few loud notes from drowning out the rest of the harmony.
+	double frameChroma[12] = {};
+	for (size_t i = 0; i + 1 < noteBins.size(); ++i)
+	{
+		float peak = 0.0f;
+		for (int bin = noteBins[i]; bin < noteBins[i + 1]; ++bin)
+		{
+			float magnitude = fftData[(size_t) bin];
+			if (magnitude >= fftData[(size_t) bin - 1] && magnitude > fftData[(size_t) bin + 1])
+			{
+				peak = juce::jmax(peak, magnitude);
+			}
+		}
+		frameChroma[(firstNote + (int) i) % 12] += std::sqrt(peak);
+	}
+	for (int i = 0; i < 12; ++i)
+	{
+		frameChroma[i] /= juce::jmax(1.0, notesPerPitchClass[i]);
+	}
+
+	// Every frame counts the same however loud it is, silence counts for nothing
+	double total = 0.0;
+	for (double value : frameChroma)
+	{
+		total += value;
+	}
+	if (total > 1.0e-3)
+	{
+		for (int i = 0; i < 12; ++i)
+		{
+			chroma[i] += frameChroma[i] / total;
+		}
+	}
+}
+
+int KeyDetector::getKey() const
+{
+	int bestKey = noKey;
+	double bestScore = 0.0;
+	for (int tonic = 0; tonic < 12; ++tonic)
+	{
+		double major = correlate(chroma, majorProfile, tonic);
+		double minor = correlate(chroma, minorProfile, tonic);
+		if (major > bestScore)
+		{
+			bestScore = major;
+			bestKey = tonic;
+		}
+		if (minor > bestScore)
+		{
+			bestScore = minor;
+			bestKey = tonic + 12;
+		}
+	}
+	return bestKey;
+}
+
+juce::String KeyDetector::getKeyName(int key)
+{
+	if (key < 0 || key >= numKeys)
+	{
+		return {};
+	}
+
+	// Spelled the way each key is usually written
+	static const char* const majorNames[12] = { "C", "Db", "D", "Eb", "E", "F", "F#", "G", "Ab", "A", "Bb", "B" };
+	static const char* const minorNames[12] = { "Cm", "C#m", "Dm", "Ebm", "Em", "Fm", "F#m", "Gm", "G#m", "Am", "Bbm", "Bm" };
+	return key < 12 ? majorNames[key] : minorNames[key - 12];
+}
+
+int KeyDetector::getWheelPosition(int key)
+{
+	if (key < 0 || key >= numKeys)
+	{
+		return -1;
+	}
+
+	// The wheel steps round the circle of fifths, C major is 8B and its relative minor, A minor, 8A
+	bool minor = key >= 12;
+	int relativeMajor = minor ? (key - 12 + 3) % 12 : key;
+	int fifthsFromC = (relativeMajor * 7) % 12;
+	int number = (fifthsFromC + 7) % 12;
+	return number * 2 + (minor ? 0 : 1);
+}
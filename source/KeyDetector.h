@@ -0,0 +1,57 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+// Finds the musical key of a track from its chromagram. The track is fed
+// through in blocks and only the twelve pitch class totals are kept, so memory
+// does not grow with the audio. The totals are matched against the
+// Krumhansl-Kessler profiles of all 24 major and minor keys.
+//
+// Keys are numbered 0 - 11 for the major keys from C and 12 - 23 for the minor
+// keys from C, -1 stands for no key found.
+class KeyDetector
+{
+public:
+    KeyDetector(double _sampleRate);
+
+    // Feed the next block of the track, mixed down to mono
+    void process(const float* samples, int numSamples);
+
+    // Key of everything fed so far, -1 if there was nothing tonal to go on
+    int getKey() const;
+
+    // Short name such as "F#m" or "Bb", empty for -1
+    static juce::String getKeyName(int key);
+    // Position on the Camelot wheel, 1A = 0 to 12B = 23, so keys that mix well
+    // sort next to each other. -1 for no key.
+    static int getWheelPosition(int key);
+
+    static constexpr int noKey = -1;
+    static constexpr int numKeys = 24;
+
+    static constexpr int fftOrder = 14;
+    static constexpr int fftSize = 1 << fftOrder;
+    static constexpr int hopSize = fftSize / 2;
+
+private:
+    void processFrame();
+
+    juce::dsp::FFT fft{ fftOrder };
+    juce::dsp::WindowingFunction<float> window{ (size_t) fftSize, juce::dsp::WindowingFunction<float>::hann, false };
+
+    // First FFT bin of each note from firstNote up, plus the end of the last
+    int firstNote = 0;
+    std::vector<int> noteBins;
+    double notesPerPitchClass[12] = {};
+
+    // Samples waiting for the next frame
+    std::vector<float> frame;
+    int frameFill = 0;
+    std::vector<float> fftData;
+
+    // Sum of the normalised chroma of every frame
+    double chroma[12] = {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(KeyDetector)
+};
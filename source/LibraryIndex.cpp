@@ -0,0 +1,153 @@
+#include "LibraryIndex.h"
+
+namespace
+{
+	// Identifies the file and its layout, bump the version whenever the entry layout changes
+	const juce::int32 indexMagic = 0x494c444f; // "ODLI"
+	const juce::int32 indexVersion = 7;
+	// Older versions are upgraded as they load: version 1 had no MP3 seek indexes,
+	// version 2 no analysis, version 3 no hot cues, version 4 no keys, version 5
+	// no loudness and versions 2 to 6 held seek indexes inline rather than in the
+	// SeekIndexStore. Their tracks are probed or analysed again as needed.
+	const juce::int32 oldestReadableVersion = 1;
+	// No entry is smaller than its two empty strings and three 8 byte fields
+	const juce::int64 minimumEntrySize = 2 + 3 * 8;
+}
+
+LibraryIndex::LibraryIndex(const juce::File& _indexFile) : indexFile(_indexFile)
+{
+}
+
+juce::File LibraryIndex::getDefaultFile()
+{
+	return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+		.getChildFile("Otodecks")
+		.getChildFile("library.idx");
+}
+
+std::vector<ScannedTrack> LibraryIndex::load() const
+{
+	std::vector<ScannedTrack> tracks;
+
+	// Read the whole file in one go and parse it from memory
+	juce::MemoryBlock data;
+	if (! indexFile.loadFileAsData(data))
+	{
+		return tracks;
+	}
+
+	juce::MemoryInputStream in(data, false);
+	int magic = in.readInt();
+	int version = in.readInt();
+	if (magic != indexMagic || version < oldestReadableVersion || version > indexVersion)
+	{
+		DBG("LibraryIndex::load - " << indexFile.getFullPathName() << " is not a library index of this version");
+		return tracks;
+	}
+
+	int numTracks = in.readInt();
+	if (numTracks < 0)
+	{
+		return tracks;
+	}
+	// The count comes from disk, so never reserve more than the rest of the file could hold
+	tracks.reserve((size_t) juce::jmin((juce::int64) numTracks, in.getNumBytesRemaining() / minimumEntrySize));
+
+	for (int i = 0; i < numTracks && ! in.isExhausted(); ++i)
+	{
+		ScannedTrack track;
+		track.filepath = in.readString();
+		track.title = in.readString();
+		track.durationSeconds = in.readDouble();
+		track.fileSize = in.readInt64();
+		track.modificationTime = in.readInt64();
+
+		if (version >= 7)
+		{
+			track.hasSeekIndex = in.readBool();
+		}
+		else if (version >= 2)
+		{
+			// The inline index is dropped, the SeekIndexStore builds it again the first time it is needed
+			juce::int64 seekIndexSize = in.readInt64();
+			track.hasSeekIndex = seekIndexSize > 0;
+			in.skipNextBytes(juce::jmax((juce::int64) 0, seekIndexSize));
+		}
+		else if (juce::File(track.filepath).hasFileExtension("mp3"))
+		{
+			// Looks changed to the rescan, which probes it again and builds its index
+			track.modificationTime = 0;
+		}
+
+		if (version >= 3)
+		{
+			track.analysis.isAnalysed = in.readBool();
+			track.analysis.beatGrid.readFrom(in);
+		}
+		if (version >= 5)
+		{
+			track.analysis.key = juce::jlimit(-1, 23, in.readInt());
+		}
+		if (version >= 6)
+		{
+			track.analysis.loudness.readFrom(in);
+		}
+		else
+		{
+			track.analysis.isAnalysed = false;
+		}
+		if (version >= 4)
+		{
+			track.hotCues.readFrom(in);
+		}
+		tracks.push_back(std::move(track));
+	}
+
+	return tracks;
+}
+
+bool LibraryIndex::save(const std::vector<ScannedTrack>& tracks) const
+{
+	if (indexFile.getParentDirectory().createDirectory().failed())
+	{
+		return false;
+	}
+
+	// Write next to the index and swap it in, so a crash never leaves a half written file
+	juce::TemporaryFile temp(indexFile);
+	{
+		juce::FileOutputStream out(temp.getFile());
+		if (out.failedToOpen())
+		{
+			return false;
+		}
+
+		out.writeInt(indexMagic);
+		out.writeInt(indexVersion);
+		out.writeInt((int) tracks.size());
+
+		for (const ScannedTrack& track : tracks)
+		{
+			out.writeString(track.filepath);
+			out.writeString(track.title);
+			out.writeDouble(track.durationSeconds);
+			out.writeInt64(track.fileSize);
+			out.writeInt64(track.modificationTime);
+
+			out.writeBool(track.hasSeekIndex);
+			out.writeBool(track.analysis.isAnalysed);
+			track.analysis.beatGrid.writeTo(out);
+			out.writeInt(track.analysis.key);
+			track.analysis.loudness.writeTo(out);
+			track.hotCues.writeTo(out);
+		}
+
+		out.flush();
+		if (out.getStatus().failed())
+		{
+			return false;
+		}
+	}
+
+	return temp.overwriteTargetFileWithTemporary();
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include "LibraryScanner.h"
+
+// Compact binary file holding the library between launches, so tracks only
+// need to be probed again when their size or modification time changes.
+class LibraryIndex
+{
+public:
+    LibraryIndex(const juce::File& _indexFile);
+
+    // Default location of the index in the user's application data folder
+    static juce::File getDefaultFile();
+
+    // Read every entry of the index, returns an empty list if the file is missing or unreadable
+    std::vector<ScannedTrack> load() const;
+
+    // Replace the index with the given entries, returns false if the file could not be written
+    bool save(const std::vector<ScannedTrack>& tracks) const;
+
+private:
+    juce::File indexFile;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LibraryIndex)
+};
@@ -0,0 +1,192 @@
+#include "LibraryScanner.h"
+#include "TrackKey.h"
+
+//==============================================================================
+// Opens one file, reads its length from the reader header and reports back
+class LibraryScanner::ProbeJob : public juce::ThreadPoolJob
+{
+public:
+	ProbeJob(LibraryScanner& _owner, const juce::String& _filepath)
+		: juce::ThreadPoolJob("Probe " + _filepath),
+		  owner(_owner),
+		  filepath(_filepath)
+	{
+	}
+
+	JobStatus runJob() override
+	{
+		juce::File file{ filepath };
+		std::unique_ptr<juce::AudioFormatReader> reader(owner.formatManager.createReaderFor(file));
+
+		// Unreadable files are left out of the library rather than added without a duration
+		if (reader != nullptr && reader->sampleRate > 0 && ! shouldExit())
+		{
+			ScannedTrack track;
+			track.filepath = filepath;
+			track.title = file.getFileNameWithoutExtension();
+			track.durationSeconds = reader->lengthInSamples / reader->sampleRate;
+			track.fileSize = file.getSize();
+			track.modificationTime = file.getLastModificationTime().toMilliseconds();
+			if (file.hasFileExtension("mp3"))
+			{
+				// Built afresh, the file has changed since any index already stored for it
+				juce::FileInputStream in(file);
+				std::unique_ptr<Mp3SeekIndex> index = in.openedOk() ? Mp3SeekIndex::build(in) : nullptr;
+				track.hasSeekIndex = index != nullptr
+					&& owner.seekIndexStore.store(TrackKey::forFile(file), *index);
+			}
+			owner.addResult(std::move(track));
+		}
+
+		owner.jobFinished();
+		return jobHasFinished;
+	}
+
+private:
+	LibraryScanner& owner;
+	juce::String filepath;
+};
+
+//==============================================================================
+// Compares known tracks with the files on disk, queueing probes for changed ones
+class LibraryScanner::RescanJob : public juce::ThreadPoolJob
+{
+public:
+	RescanJob(LibraryScanner& _owner, std::vector<ScannedTrack> _knownTracks)
+		: juce::ThreadPoolJob("Library rescan"),
+		  owner(_owner),
+		  knownTracks(std::move(_knownTracks))
+	{
+	}
+
+	JobStatus runJob() override
+	{
+		for (const ScannedTrack& track : knownTracks)
+		{
+			if (shouldExit())
+			{
+				break;
+			}
+
+			juce::File file{ track.filepath };
+			if (! file.existsAsFile())
+			{
+				owner.addMissingFile(track.filepath);
+			}
+			else if (file.getSize() != track.fileSize
+				|| file.getLastModificationTime().toMilliseconds() != track.modificationTime)
+			{
+				owner.queueProbe(track.filepath);
+			}
+		}
+
+		owner.jobFinished();
+		return jobHasFinished;
+	}
+
+private:
+	LibraryScanner& owner;
+	std::vector<ScannedTrack> knownTracks;
+};
+
+//==============================================================================
+LibraryScanner::LibraryScanner(juce::AudioFormatManager& _formatManager, SeekIndexStore& _seekIndexStore)
+	: formatManager(_formatManager),
+	  seekIndexStore(_seekIndexStore),
+	  pool(juce::jmax(1, juce::SystemStats::getNumCpus() - 1))
+{
+}
+
+LibraryScanner::~LibraryScanner()
+{
+	cancel();
+}
+
+void LibraryScanner::addFiles(const juce::StringArray& files)
+{
+	// Start counting progress again once the previous drop has completed
+	if (! isScanning())
+	{
+		numQueued = 0;
+		numFinished = 0;
+	}
+
+	for (const juce::String& filepath : files)
+	{
+		queueProbe(filepath);
+	}
+}
+
+void LibraryScanner::rescan(std::vector<ScannedTrack> knownTracks)
+{
+	// Probes start at once, a probe without formats would leave its track stale
+	jassert(formatManager.getNumKnownFormats() > 0);
+
+	if (! isScanning())
+	{
+		numQueued = 0;
+		numFinished = 0;
+	}
+
+	// A single job walks the index so unchanged files cost only a stat each
+	++numQueued;
+	pool.addJob(new RescanJob(*this, std::move(knownTracks)), true);
+}
+
+void LibraryScanner::cancel()
+{
+	// Removes jobs that have not started and waits for running ones to notice shouldExit().
+	// No time out, a job still running afterwards would count itself finished too late.
+	pool.removeAllJobs(true, -1);
+	numQueued = numFinished.load();
+}
+
+bool LibraryScanner::isScanning() const
+{
+	return numFinished < numQueued;
+}
+
+double LibraryScanner::getProgress() const
+{
+	int queued = numQueued;
+	return queued > 0 ? juce::jmin(1.0, (double) numFinished / queued) : 1.0;
+}
+
+void LibraryScanner::queueProbe(const juce::String& filepath)
+{
+	++numQueued;
+	pool.addJob(new ProbeJob(*this, filepath), true);
+}
+
+std::vector<ScannedTrack> LibraryScanner::takeResults()
+{
+	std::vector<ScannedTrack> finished;
+	const juce::ScopedLock sl(resultLock);
+	finished.swap(results);
+	return finished;
+}
+
+juce::StringArray LibraryScanner::takeMissingFiles()
+{
+	juce::StringArray missing;
+	const juce::ScopedLock sl(resultLock);
+	missing.swapWith(missingFiles);
+	return missing;
+}
+
+void LibraryScanner::addResult(ScannedTrack track)
+{
+	const juce::ScopedLock sl(resultLock);
+	results.push_back(std::move(track));
+}
+
+void LibraryScanner::addMissingFile(const juce::String& filepath)
+{
+	const juce::ScopedLock sl(resultLock);
+	missingFiles.add(filepath);
+}
+
+void LibraryScanner::jobFinished()
+{
+	++numFinished;
+}
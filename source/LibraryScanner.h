@@ -0,0 +1,95 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "SeekIndexStore.h"
+#include "BeatGrid.h"
+#include "HotCues.h"
+#include "LoudnessMeter.h"
+
+// Results of the background analysis of a track by the TrackAnalyser
+struct TrackAnalysis
+{
+    // Set once the whole track has been analysed, even if nothing was found
+    bool isAnalysed = false;
+    BeatGrid beatGrid;
+    // Numbered as by the KeyDetector, -1 when no key was found
+    int key = -1;
+    TrackLoudness loudness;
+};
+
+// Metadata gathered for a single file by the library scanner
+struct ScannedTrack
+{
+    juce::String filepath;
+    juce::String title;
+    double durationSeconds = 0.0;
+    // Used to tell whether the file has changed since it was last probed
+    juce::int64 fileSize = 0;
+    juce::int64 modificationTime = 0;
+    // Set for MP3 files whose frame offsets are in the SeekIndexStore, so decks
+    // can seek without decoding from the start
+    bool hasSeekIndex = false;
+    // Empty for a newly probed file, filled in later by the TrackAnalyser
+    TrackAnalysis analysis;
+    // Set by hand on the decks
+    HotCues hotCues;
+};
+
+// Probes dropped files on a pool of worker threads so the message thread
+// never has to open a decoder. Finished probes are collected and handed
+// back in batches through takeResults().
+class LibraryScanner
+{
+public:
+    // MP3 seek indexes are built as files are probed and kept in _seekIndexStore
+    LibraryScanner(juce::AudioFormatManager& _formatManager, SeekIndexStore& _seekIndexStore);
+    ~LibraryScanner();
+
+    // Queue files to be probed in the background
+    void addFiles(const juce::StringArray& files);
+
+    // Check tracks loaded from the library index against the disk and only
+    // re-probe the ones whose size or modification time has changed
+    void rescan(std::vector<ScannedTrack> knownTracks);
+
+    // Drop every queued probe and stop the ones in flight
+    void cancel();
+
+    bool isScanning() const;
+
+    // Fraction of the queued files that have been probed (0 - 1)
+    double getProgress() const;
+
+    // Hand over the probes finished since the last call (message thread)
+    std::vector<ScannedTrack> takeResults();
+
+    // Hand over the files found missing by rescan() since the last call
+    juce::StringArray takeMissingFiles();
+
+private:
+    class ProbeJob;
+    class RescanJob;
+
+    void queueProbe(const juce::String& filepath);
+
+    // Called from worker threads once a file has been probed
+    void addResult(ScannedTrack track);
+    void addMissingFile(const juce::String& filepath);
+    void jobFinished();
+
+    juce::AudioFormatManager& formatManager;
+    SeekIndexStore& seekIndexStore;
+    juce::ThreadPool pool;
+
+    juce::CriticalSection resultLock;
+    std::vector<ScannedTrack> results;
+    juce::StringArray missingFiles;
+
+    std::atomic<int> numQueued{ 0 };
+    std::atomic<int> numFinished{ 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LibraryScanner)
+};
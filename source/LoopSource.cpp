@@ -0,0 +1,296 @@
+#include "LoopSource.h"
+
+LoopSource::LoopSource(juce::PositionableAudioSource* _source) : source(_source)
+{
+}
+
+void LoopSource::setLoop(juce::int64 start, juce::int64 end)
+{
+	const juce::SpinLock::ScopedLockType sl(stateLock);
+	latestState.active = end > start;
+	latestState.start = start;
+	latestState.end = end;
+	publish();
+}
+
+void LoopSource::clearLoop()
+{
+	const juce::SpinLock::ScopedLockType sl(stateLock);
+	latestState.active = false;
+	publish();
+}
+
+void LoopSource::setRegion(std::shared_ptr<const Region> region)
+{
+	const juce::SpinLock::ScopedLockType sl(stateLock);
+	latestState.region = std::move(region);
+	publish();
+}
+
+bool LoopSource::setCueWindow(int index, juce::int64 start, juce::int64 end)
+{
+	if (index < 0)
+	{
+		return false;
+	}
+
+	const juce::SpinLock::ScopedLockType sl(stateLock);
+	std::vector<CueWindow>& cues = latestState.cues;
+	if ((size_t) index >= cues.size())
+	{
+		cues.resize((size_t) index + 1);
+	}
+	// A window that has not moved keeps its audio
+	end = juce::jmax(start, end);
+	CueWindow& cue = cues[(size_t) index];
+	if (cue.start == start && cue.end == end)
+	{
+		return false;
+	}
+
+	cue.start = start;
+	cue.end = end;
+	cue.region.reset();
+	publish();
+	return true;
+}
+
+void LoopSource::setCueRegion(int index, std::shared_ptr<const Region> region)
+{
+	const juce::SpinLock::ScopedLockType sl(stateLock);
+	std::vector<CueWindow>& cues = latestState.cues;
+	if (index < 0 || (size_t) index >= cues.size() || region == nullptr)
+	{
+		return;
+	}
+
+	CueWindow& cue = cues[(size_t) index];
+	if (cue.start == region->start && cue.end == region->start + region->audio.getNumSamples())
+	{
+		cue.region = std::move(region);
+		publish();
+	}
+}
+
+bool LoopSource::isCueWindow(int index, juce::int64 start, juce::int64 end) const
+{
+	const juce::SpinLock::ScopedLockType sl(stateLock);
+	const std::vector<CueWindow>& cues = latestState.cues;
+	return index >= 0 && (size_t) index < cues.size() && end > start
+		&& cues[(size_t) index].start == start && cues[(size_t) index].end == end;
+}
+
+void LoopSource::jumpTo(juce::int64 newPosition)
+{
+	// Flagged before the seek is posted, so the audio thread never sees the seek without it
+	declickNextSeek = true;
+	setNextReadPosition(newPosition);
+}
+
+bool LoopSource::isLoopActive() const
+{
+	const juce::SpinLock::ScopedLockType sl(stateLock);
+	return latestState.active;
+}
+
+juce::int64 LoopSource::getLoopStart() const
+{
+	const juce::SpinLock::ScopedLockType sl(stateLock);
+	return latestState.start;
+}
+
+juce::int64 LoopSource::getLoopEnd() const
+{
+	const juce::SpinLock::ScopedLockType sl(stateLock);
+	return latestState.end;
+}
+
+bool LoopSource::hasRegionFor(juce::int64 start, juce::int64 end) const
+{
+	const juce::SpinLock::ScopedLockType sl(stateLock);
+	const Region* region = latestState.region.get();
+	return region != nullptr && region->start <= start && region->start + region->audio.getNumSamples() >= end;
+}
+
+juce::int64 LoopSource::getPosition() const
+{
+	return position;
+}
+
+// Called with the lock held
+void LoopSource::publish()
+{
+	// Replacing a pending state the audio thread never took frees it here
+	pendingState = latestState;
+	hasPendingState = true;
+}
+
+void LoopSource::takePendingState()
+{
+	const juce::SpinLock::ScopedTryLockType lock(stateLock);
+	if (! lock.isLocked() || ! hasPendingState)
+	{
+		return;
+	}
+
+	// The state given up is left in pendingState for a writer to free
+	std::swap(currentState, pendingState);
+	hasPendingState = false;
+}
+
+//==============================================================================
+void LoopSource::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+	declickSamples = juce::jmax(1, juce::roundToInt(sampleRate * declickSeconds));
+	fadeBuffer.setSize(2, declickSamples);
+	source->prepareToPlay(samplesPerBlockExpected, sampleRate);
+}
+
+void LoopSource::releaseResources()
+{
+	source->releaseResources();
+}
+
+void LoopSource::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+	juce::int64 seek = seekTarget.exchange(-1);
+	bool declick = seek >= 0 && declickNextSeek.exchange(false);
+	juce::int64 pos = seek >= 0 ? seek : position.load();
+
+	bool wasInLoop = currentState.active && pos >= currentState.start && pos < currentState.end;
+	takePendingState();
+
+	const LoopState& state = currentState;
+	bool looping = state.active && state.end > state.start;
+	// A loop shortened behind the playhead keeps its phase, as if it had been that length all along
+	if (looping && wasInLoop && pos >= state.end && pos >= state.start)
+	{
+		pos = state.start + (pos - state.start) % (state.end - state.start);
+	}
+
+	// A jump fades out of where playback was heading as it fades in the new position. The old
+	// audio is only played when it costs no seek, from memory or a source that is already there.
+	int fadeSamples = 0;
+	if (declick && pos != playPosition && (playPosition == sourcePosition || findRegion(state, playPosition) != nullptr))
+	{
+		fadeSamples = juce::jmin(declickSamples, fadeBuffer.getNumSamples(), bufferToFill.numSamples);
+		juce::int64 fadePosition = playPosition;
+		render(state, fadePosition, juce::AudioSourceChannelInfo(&fadeBuffer, 0, fadeSamples));
+	}
+
+	render(state, pos, bufferToFill);
+
+	if (fadeSamples > 0)
+	{
+		int numFadeChannels = juce::jmin(fadeBuffer.getNumChannels(), bufferToFill.buffer->getNumChannels());
+		for (int channel = 0; channel < bufferToFill.buffer->getNumChannels(); ++channel)
+		{
+			bufferToFill.buffer->applyGainRamp(channel, bufferToFill.startSample, fadeSamples, 0.0f, 1.0f);
+			if (channel < numFadeChannels)
+			{
+				bufferToFill.buffer->addFromWithRamp(channel, bufferToFill.startSample,
+													 fadeBuffer.getReadPointer(channel), fadeSamples, 1.0f, 0.0f);
+			}
+		}
+	}
+
+	playPosition = pos;
+	position = pos;
+}
+
+const LoopSource::Region* LoopSource::findRegion(const LoopState& state, juce::int64 pos)
+{
+	const Region* region = state.region.get();
+	if (region != nullptr && pos >= region->start && pos < region->start + region->audio.getNumSamples())
+	{
+		return region;
+	}
+	for (const CueWindow& cue : state.cues)
+	{
+		region = cue.region.get();
+		if (region != nullptr && pos >= region->start && pos < region->start + region->audio.getNumSamples())
+		{
+			return region;
+		}
+	}
+	return nullptr;
+}
+
+void LoopSource::render(const LoopState& state, juce::int64& pos, const juce::AudioSourceChannelInfo& info)
+{
+	bool looping = state.active && state.end > state.start;
+
+	for (int done = 0; done < info.numSamples;)
+	{
+		int chunk = info.numSamples - done;
+		if (looping && pos < state.end)
+		{
+			chunk = (int) juce::jmin((juce::int64) chunk, state.end - pos);
+		}
+
+		// The source is played while it is already in the right place, a region
+		// whenever it would otherwise have to seek
+		const Region* region = pos != sourcePosition ? findRegion(state, pos) : nullptr;
+		if (region != nullptr)
+		{
+			juce::int64 regionEnd = region->start + region->audio.getNumSamples();
+			chunk = (int) juce::jmin((juce::int64) chunk, regionEnd - pos);
+			int offset = (int) (pos - region->start);
+			int numRegionChannels = region->audio.getNumChannels();
+			for (int channel = 0; channel < info.buffer->getNumChannels(); ++channel)
+			{
+				info.buffer->copyFrom(channel, info.startSample + done,
+									  region->audio, juce::jmin(channel, numRegionChannels - 1), offset, chunk);
+			}
+
+			// Send the source on ahead to where the region runs out, it has until then to get there
+			if (sourcePosition != regionEnd)
+			{
+				source->setNextReadPosition(regionEnd);
+				sourcePosition = regionEnd;
+			}
+		}
+		else
+		{
+			if (pos != sourcePosition)
+			{
+				source->setNextReadPosition(pos);
+			}
+			source->getNextAudioBlock(juce::AudioSourceChannelInfo(info.buffer, info.startSample + done, chunk));
+			sourcePosition = pos + chunk;
+		}
+
+		pos += chunk;
+		done += chunk;
+		if (looping && pos == state.end)
+		{
+			pos = state.start;
+		}
+	}
+}
+
+void LoopSource::setNextReadPosition(juce::int64 newPosition)
+{
+	position = newPosition;
+	seekTarget = newPosition;
+}
+
+juce::int64 LoopSource::getNextReadPosition() const
+{
+	return position;
+}
+
+juce::int64 LoopSource::getTotalLength() const
+{
+	return source->getTotalLength();
+}
+
+bool LoopSource::isLooping() const
+{
+	return source->isLooping();
+}
+
+void LoopSource::setLooping(bool shouldLoop)
+{
+	source->setLooping(shouldLoop);
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Sits between a track and its transport and plays loops and hot cues from
+// memory. The loop region is decoded into a buffer off the audio thread, and
+// the audio thread wraps from the loop end to the loop start on the exact sample
+// without touching the track's source. The first pass through the region plays
+// from the source as usual, which is then left at the loop end, so leaving the
+// loop carries on from the source without a seek.
+//
+// A window around each hot cue is held decoded the same way. A jump into one
+// plays from memory on the next block while the source seeks to the end of the
+// window in the background, so playback runs on from memory into the source.
+class LoopSource : public juce::PositionableAudioSource
+{
+public:
+    // Audio of part of the track, decoded ahead of time
+    struct Region
+    {
+        juce::int64 start = 0;
+        juce::AudioBuffer<float> audio;
+    };
+
+    LoopSource(juce::PositionableAudioSource* _source);
+
+    // Loop between two samples of the track (any thread). Until a buffer covering
+    // the loop is handed over, the wrap back to the start seeks the source instead.
+    void setLoop(juce::int64 start, juce::int64 end);
+    // Stop looping, playback carries on through the loop end
+    void clearLoop();
+    void setRegion(std::shared_ptr<const Region> region);
+
+    // Samples held in memory for a hot cue, an empty window drops them (any thread).
+    // False if the cue already had that window.
+    bool setCueWindow(int index, juce::int64 start, juce::int64 end);
+    // Only kept if the cue still has the window the region was decoded for
+    void setCueRegion(int index, std::shared_ptr<const Region> region);
+    bool isCueWindow(int index, juce::int64 start, juce::int64 end) const;
+
+    // Seek that crossfades from where playback was heading to the new position,
+    // for jumps while playing. Picked up by the audio thread at its next block.
+    void jumpTo(juce::int64 newPosition);
+
+    // Latest loop asked for (any thread)
+    bool isLoopActive() const;
+    juce::int64 getLoopStart() const;
+    juce::int64 getLoopEnd() const;
+    // Whether the latest region handed over holds the given samples
+    bool hasRegionFor(juce::int64 start, juce::int64 end) const;
+
+    // Next sample of the track to be played, safe to call from any thread
+    juce::int64 getPosition() const;
+
+    //==============================================================================
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+    // Seeks are picked up by the audio thread at its next block
+    void setNextReadPosition(juce::int64 newPosition) override;
+    juce::int64 getNextReadPosition() const override;
+    juce::int64 getTotalLength() const override;
+    bool isLooping() const override;
+    void setLooping(bool shouldLoop) override;
+
+    // Length of the crossfade made by jumpTo()
+    static constexpr double declickSeconds = 0.005;
+
+private:
+    struct CueWindow
+    {
+        juce::int64 start = 0;
+        juce::int64 end = 0;
+        std::shared_ptr<const Region> region;
+    };
+
+    struct LoopState
+    {
+        bool active = false;
+        juce::int64 start = 0;
+        juce::int64 end = 0;
+        std::shared_ptr<const Region> region;
+        std::vector<CueWindow> cues;
+    };
+
+    // Audio thread, swap in the latest state if the lock is free
+    void takePendingState();
+    void publish();
+
+    // Audio thread, the loop region or a cue region holding a sample
+    static const Region* findRegion(const LoopState& state, juce::int64 pos);
+    // Audio thread, play from pos and move it on, wrapping at the loop end
+    void render(const LoopState& state, juce::int64& pos, const juce::AudioSourceChannelInfo& info);
+
+    juce::PositionableAudioSource* source;
+
+    // Writers change latestState and copy it to pendingState under the lock. The audio
+    // thread swaps pendingState with its own, so regions it stops using are freed by
+    // the next writer rather than on the audio thread.
+    mutable juce::SpinLock stateLock;
+    LoopState latestState;
+    LoopState pendingState;
+    bool hasPendingState = false;
+
+    // Audio thread only
+    LoopState currentState;
+    juce::int64 sourcePosition = 0;
+    // Where the last block ended, where a jump fades out from
+    juce::int64 playPosition = 0;
+    juce::AudioBuffer<float> fadeBuffer;
+    int declickSamples = 0;
+
+    std::atomic<juce::int64> position{ 0 };
+    // Seek waiting for the audio thread, -1 when there is none
+    std::atomic<juce::int64> seekTarget{ -1 };
+    // The waiting seek came from jumpTo()
+    std::atomic<bool> declickNextSeek{ false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LoopSource)
+};
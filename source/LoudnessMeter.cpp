@@ -0,0 +1,240 @@
+#include "LoudnessMeter.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// Blocks quieter than this never count, R128's absolute gate
+	const double absoluteGateLufs = -70.0;
+	// Blocks this far below the loudness of the rest are left out, R128's relative gate
+	const double relativeGateLu = -10.0;
+
+	// Histogram of block loudness, fine enough that the relative gate lands within 0.02 LU
+	const double histogramTopLufs = 10.0;
+	const double histogramBinLu = 0.02;
+	const int numHistogramBins = (int) ((histogramTopLufs - absoluteGateLufs) / histogramBinLu);
+
+	// True peak by four times oversampling, with a 48 tap interpolation filter
+	const int oversampling = 4;
+	const int tapsPerPhase = 12;
+	const int historyLength = tapsPerPhase - 1;
+	// Samples interpolated in one pass
+	const int chunkSize = 4096;
+
+	double energyToLufs(double energy)
+	{
+		return -0.691 + 10.0 * std::log10(energy);
+	}
+}
+
+//==============================================================================
+void TrackLoudness::writeTo(juce::OutputStream& out) const
+{
+	out.writeBool(isMeasured);
+	out.writeDouble(integratedLufs);
+	out.writeDouble(truePeakDb);
+}
+
+void TrackLoudness::readFrom(juce::InputStream& in)
+{
+	isMeasured = in.readBool();
+	integratedLufs = in.readDouble();
+	truePeakDb = in.readDouble();
+}
+
+//==============================================================================
+LoudnessMeter::LoudnessMeter(double _sampleRate, int _numChannels)
+	: numChannels(juce::jlimit(1, maxChannels, _numChannels)),
+	  // A mono track plays on both speakers, so it is as loud as two channels of the same audio
+	  channelWeight(_numChannels == 1 ? 2.0 : 1.0),
+	  subBlockLength(juce::jmax(1, juce::roundToInt(_sampleRate * 0.1))),
+	  histogramCounts((size_t) numHistogramBins),
+	  histogramEnergies((size_t) numHistogramBins),
+	  interpolated((size_t) chunkSize)
+{
+	// K-weighting from BS.1770, worked out for the track's sample rate rather than only 48 kHz
+	const double pi = juce::MathConstants<double>::pi;
+	{
+		double k = std::tan(pi * 1681.974450955533 / _sampleRate);
+		double q = 0.7071752369554196;
+		double vh = std::pow(10.0, 3.999843853973347 / 20.0);
+		double vb = std::pow(vh, 0.4996667741545416);
+		double a0 = 1.0 + k / q + k * k;
+		Biquad filter;
+		filter.b0 = (vh + vb * k / q + k * k) / a0;
+		filter.b1 = 2.0 * (k * k - vh) / a0;
+		filter.b2 = (vh - vb * k / q + k * k) / a0;
+		filter.a1 = 2.0 * (k * k - 1.0) / a0;
+		filter.a2 = (1.0 - k / q + k * k) / a0;
+		std::fill(std::begin(shelf), std::end(shelf), filter);
+	}
+	{
+		double k = std::tan(pi * 38.13547087602444 / _sampleRate);
+		double q = 0.5003270373238773;
+		double a0 = 1.0 + k / q + k * k;
+		Biquad filter;
+		filter.b0 = 1.0;
+		filter.b1 = -2.0;
+		filter.b2 = 1.0;
+		filter.a1 = 2.0 * (k * k - 1.0) / a0;
+		filter.a2 = (1.0 - k / q + k * k) / a0;
+		std::fill(std::begin(highPass), std::end(highPass), filter);
+	}
+
+	// Blackman windowed sinc cut off at the track's Nyquist, split into its four phases
+	int numTaps = oversampling * tapsPerPhase;
+	for (int phase = 0; phase < oversampling; ++phase)
+	{
+		phaseTaps[phase].resize((size_t) tapsPerPhase);
+		double sum = 0.0;
+		for (int tap = 0; tap < tapsPerPhase; ++tap)
+		{
+			int k = tap * oversampling + phase;
+			double x = (k - (numTaps - 1) / 2.0) / oversampling;
+			double sinc = x == 0.0 ? 1.0 : std::sin(pi * x) / (pi * x);
+			double w = 0.42 - 0.5 * std::cos(2.0 * pi * k / (numTaps - 1)) + 0.08 * std::cos(4.0 * pi * k / (numTaps - 1));
+			phaseTaps[phase][(size_t) tap] = (float) (sinc * w);
+			sum += sinc * w;
+		}
+		// Every phase passes DC unchanged
+		for (float& tap : phaseTaps[phase])
+		{
+			tap = (float) (tap / sum);
+		}
+	}
+
+	for (int channel = 0; channel < numChannels; ++channel)
+	{
+		history[channel].assign((size_t) (historyLength + chunkSize), 0.0f);
+	}
+}
+
+void LoudnessMeter::process(const float* const* channels, int numSamples)
+{
+	const float* chunk[maxChannels] = {};
+	for (int done = 0; done < numSamples; done += chunkSize)
+	{
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			chunk[channel] = channels[channel] + done;
+		}
+		processChunk(chunk, juce::jmin(chunkSize, numSamples - done));
+	}
+}
+
+void LoudnessMeter::processChunk(const float* const* channels, int numSamples)
+{
+	for (int channel = 0; channel < numChannels; ++channel)
+	{
+		const float* samples = channels[channel];
+
+		// True peak, the samples themselves and the three points between each pair
+		float* padded = history[channel].data();
+		std::copy(samples, samples + numSamples, padded + historyLength);
+		juce::Range<float> range = juce::FloatVectorOperations::findMinAndMax(samples, numSamples);
+		peak = juce::jmax(peak, -range.getStart(), range.getEnd());
+		for (int phase = 0; phase < oversampling; ++phase)
+		{
+			const std::vector<float>& taps = phaseTaps[phase];
+			juce::FloatVectorOperations::clear(interpolated.data(), numSamples);
+			for (int tap = 0; tap < tapsPerPhase; ++tap)
+			{
+				juce::FloatVectorOperations::addWithMultiply(interpolated.data(), padded + historyLength - tap, taps[(size_t) tap], numSamples);
+			}
+			range = juce::FloatVectorOperations::findMinAndMax(interpolated.data(), numSamples);
+			peak = juce::jmax(peak, -range.getStart(), range.getEnd());
+		}
+		// Keep the end of the chunk for the start of the next
+		std::copy(padded + numSamples, padded + numSamples + historyLength, padded);
+	}
+
+	// Loudness, the K-weighted power of each 100 ms sub-block
+	for (int done = 0; done < numSamples;)
+	{
+		int count = juce::jmin(numSamples - done, subBlockLength - subBlockFill);
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			const float* samples = channels[channel] + done;
+			Biquad& first = shelf[channel];
+			Biquad& second = highPass[channel];
+			double sum = 0.0;
+			for (int i = 0; i < count; ++i)
+			{
+				float y = second.process(first.process(samples[i]));
+				sum += y * y;
+			}
+			subBlockEnergy += sum * channelWeight;
+		}
+
+		subBlockFill += count;
+		done += count;
+		if (subBlockFill == subBlockLength)
+		{
+			finishSubBlock();
+		}
+	}
+}
+
+void LoudnessMeter::finishSubBlock()
+{
+	std::copy(std::begin(recentSubBlocks) + 1, std::end(recentSubBlocks), std::begin(recentSubBlocks));
+	recentSubBlocks[3] = subBlockEnergy / subBlockLength;
+	subBlockEnergy = 0.0;
+	subBlockFill = 0;
+
+	// Each block is the last four sub-blocks, so blocks overlap by three quarters
+	if (++numSubBlocks >= 4)
+	{
+		addBlock((recentSubBlocks[0] + recentSubBlocks[1] + recentSubBlocks[2] + recentSubBlocks[3]) / 4.0);
+	}
+}
+
+void LoudnessMeter::addBlock(double energy)
+{
+	if (energy <= 0.0)
+	{
+		return;
+	}
+	double lufs = energyToLufs(energy);
+	if (lufs < absoluteGateLufs)
+	{
+		return;
+	}
+
+	int bin = juce::jlimit(0, numHistogramBins - 1, (int) ((lufs - absoluteGateLufs) / histogramBinLu));
+	++histogramCounts[(size_t) bin];
+	histogramEnergies[(size_t) bin] += energy;
+}
+
+TrackLoudness LoudnessMeter::getLoudness() const
+{
+	TrackLoudness loudness;
+	loudness.truePeakDb = juce::Decibels::gainToDecibels(peak);
+
+	juce::int64 count = 0;
+	double energy = 0.0;
+	for (int bin = 0; bin < numHistogramBins; ++bin)
+	{
+		count += histogramCounts[(size_t) bin];
+		energy += histogramEnergies[(size_t) bin];
+	}
+	if (count == 0)
+	{
+		return loudness;
+	}
+
+	// Leave out the blocks well below the loudness of the rest, such as breakdowns and fades
+	double threshold = energyToLufs(energy / count) + relativeGateLu;
+	int firstBin = juce::jlimit(0, numHistogramBins - 1, (int) std::floor((threshold - absoluteGateLufs) / histogramBinLu));
+	count = 0;
+	energy = 0.0;
+	for (int bin = firstBin; bin < numHistogramBins; ++bin)
+	{
+		count += histogramCounts[(size_t) bin];
+		energy += histogramEnergies[(size_t) bin];
+	}
+
+	loudness.isMeasured = count > 0;
+	loudness.integratedLufs = count > 0 ? energyToLufs(energy / count) : absoluteGateLufs;
+	return loudness;
+}
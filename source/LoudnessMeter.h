@@ -0,0 +1,87 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+// Loudness of a whole track, as measured by the LoudnessMeter
+struct TrackLoudness
+{
+    // False until the track has been analysed, and for tracks that are silent throughout
+    bool isMeasured = false;
+    // Gated integrated loudness, EBU R128
+    double integratedLufs = 0.0;
+    // Highest peak between samples, in dB relative to full scale
+    double truePeakDb = 0.0;
+
+    void writeTo(juce::OutputStream& out) const;
+    void readFrom(juce::InputStream& in);
+};
+
+// Measures the integrated loudness and true peak of a track as in ITU-R
+// BS.1770-4 and EBU R128. The track is fed through in blocks. Gated blocks are
+// counted in a fixed histogram rather than kept, so memory does not grow with
+// the audio.
+//
+// The K-weighting filters are recursive and run sample by sample. The true peak
+// interpolation, which is most of the work, runs over whole blocks through
+// FloatVectorOperations.
+class LoudnessMeter
+{
+public:
+    // Mono and stereo, a mono track counts as playing on both speakers
+    LoudnessMeter(double _sampleRate, int _numChannels);
+
+    // Feed the next block of the track, one pointer per channel
+    void process(const float* const* channels, int numSamples);
+
+    TrackLoudness getLoudness() const;
+
+    static constexpr int maxChannels = 2;
+
+private:
+    struct Biquad
+    {
+        double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+        double z1 = 0.0, z2 = 0.0;
+
+        float process(float x)
+        {
+            double y = b0 * x + z1;
+            z1 = b1 * x - a1 * y + z2;
+            z2 = b2 * x - a2 * y;
+            return (float) y;
+        }
+    };
+
+    void processChunk(const float* const* channels, int numSamples);
+    void finishSubBlock();
+    void addBlock(double energy);
+
+    int numChannels;
+    // Power of each channel counts this much towards the loudness
+    double channelWeight;
+
+    // High shelf then high pass, per channel
+    Biquad shelf[maxChannels];
+    Biquad highPass[maxChannels];
+
+    // Blocks are 400 ms long and start every 100 ms, built from 100 ms sub-blocks
+    int subBlockLength;
+    int subBlockFill = 0;
+    double subBlockEnergy = 0.0;
+    double recentSubBlocks[4] = {};
+    int numSubBlocks = 0;
+
+    // Blocks above the absolute gate, counted by loudness with their total energy
+    std::vector<int> histogramCounts;
+    std::vector<double> histogramEnergies;
+
+    // Samples before the current chunk the interpolator still needs, then the chunk itself
+    std::vector<float> history[maxChannels];
+    std::vector<float> interpolated;
+    // Taps of the four interpolation phases
+    std::vector<float> phaseTaps[4];
+    float peak = 0.0f;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LoudnessMeter)
+};
@@ -8,6 +8,7 @@
 
 #include <JuceHeader.h>
 #include "MainComponent.h"
+#include "OfflineRenderer.h"
 
 //==============================================================================
 class DJ_ApplicationApplication  : public juce::JUCEApplication
@@ -25,6 +26,15 @@ public:
     {
         // This method is where you should put your application's initialisation code..
 
+        // Headless mode, render a scripted mix to a file and exit without opening a window
+        juce::StringArray args = juce::StringArray::fromTokens (commandLine, true);
+        if (args.contains ("--render"))
+        {
+            setApplicationReturnValue (renderOffline (args));
+            quit();
+            return;
+        }
+
         mainWindow.reset (new MainWindow (getApplicationName()));
     }
 
@@ -97,6 +107,37 @@ public:
     };
 
 private:
+    // Runs "--render <script> <output.wav>", returns the process exit code
+    int renderOffline (const juce::StringArray& args)
+    {
+        int index = args.indexOf ("--render");
+        if (index + 2 >= args.size())
+        {
+            std::cerr << "Usage: " << getApplicationName() << " --render <script> <output.wav>" << std::endl;
+            return 1;
+        }
+
+        juce::File cwd = juce::File::getCurrentWorkingDirectory();
+        juce::File script = cwd.getChildFile (args[index + 1].unquoted());
+        juce::File output = cwd.getChildFile (args[index + 2].unquoted());
+
+        juce::AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+
+        OfflineRenderer renderer (formatManager);
+        juce::Result result = renderer.loadScript (script);
+        if (result.wasOk())
+        {
+            result = renderer.render (output);
+        }
+        if (result.failed())
+        {
+            std::cerr << result.getErrorMessage() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
     std::unique_ptr<MainWindow> mainWindow;
 };
 
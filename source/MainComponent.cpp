@@ -7,6 +7,9 @@ MainComponent::MainComponent()
 	// you add any child components.
 	setSize (800, 600);
 
+	// Start decoding thread before any audio is requested
+	readAheadThread.startThread();
+
 	// Some platforms require permissions to open input channels so request that here
 	if (juce::RuntimePermissions::isRequired (juce::RuntimePermissions::recordAudio)
 		&& ! juce::RuntimePermissions::isGranted (juce::RuntimePermissions::recordAudio))
@@ -25,9 +28,6 @@ MainComponent::MainComponent()
 	addAndMakeVisible(deckGUIRight);
 	addAndMakeVisible(playlistComponent);
 
-	// Add file formats enabled by JUCE
-	formatManager.registerBasicFormats();
-
 	// Add Labels and customize visuals for labels
 	addAndMakeVisible(waveformLabel);
 	waveformLabel.setText("Waveforms", juce::dontSendNotification);
@@ -48,12 +48,58 @@ MainComponent::MainComponent()
 	playlistLabel.setText("Drag Files here to add to Library", juce::dontSendNotification);
 	playlistLabel.setColour(juce::Label::textColourId, juce::Colours::whitesmoke);
 	playlistLabel.setJustificationType(juce::Justification::centred);
+
+	// Crossfader, its curve and the master volume
+	addAndMakeVisible(mixerLabel);
+	mixerLabel.setText("Mixer", juce::dontSendNotification);
+	mixerLabel.setColour(juce::Label::textColourId, juce::Colours::whitesmoke);
+	mixerLabel.setJustificationType(juce::Justification::centred);
+
+	addAndMakeVisible(crossfaderSlider);
+	crossfaderSlider.addListener(this);
+	crossfaderSlider.setRange(0.0, 1.0);
+	crossfaderSlider.setValue(0.5); // start with both decks audible
+	crossfaderSlider.setTextBoxStyle(juce::Slider::NoTextBox, false, 0, 0);
+	crossfaderSlider.setDoubleClickReturnValue(true, 0.5);
+
+	addAndMakeVisible(crossfadeCurveBox);
+	crossfadeCurveBox.addItem("Linear", (int) DeckMixer::CrossfadeCurve::linear);
+	crossfadeCurveBox.addItem("Constant power", (int) DeckMixer::CrossfadeCurve::constantPower);
+	crossfadeCurveBox.addItem("Sharp cut", (int) DeckMixer::CrossfadeCurve::sharpCut);
+	crossfadeCurveBox.setSelectedId((int) DeckMixer::CrossfadeCurve::constantPower, juce::dontSendNotification);
+	crossfadeCurveBox.addListener(this);
+
+	addAndMakeVisible(masterGainSlider);
+	masterGainSlider.addListener(this);
+	masterGainSlider.setRange(0.0, 2.0);
+	masterGainSlider.setValue(1.0);
+	masterGainSlider.setTextValueSuffix(" master");
+	masterGainSlider.setTextBoxStyle(juce::Slider::TextBoxBelow, false, 80, 15);
+
+	addAndMakeVisible(autoGainToggle);
+	autoGainToggle.addListener(this);
+
+	addAndMakeVisible(decodeToggle);
+	decodeToggle.addListener(this);
 }
 
 MainComponent::~MainComponent()
 {
 	// This shuts down the audio device and clears the audio source.
 	shutdownAudio();
+	readAheadThread.stopThread(2000);
+}
+
+juce::int64 MainComponent::getCacheBudget(const juce::String& option, juce::int64 defaultBytes)
+{
+	const auto args = juce::JUCEApplicationBase::getCommandLineParameterArray();
+	const int index = args.indexOf(option);
+
+	if (index < 0 || index + 1 >= args.size()
+		|| args[index + 1].isEmpty() || !args[index + 1].containsOnly("0123456789"))
+		return defaultBytes;
+
+	return args[index + 1].getLargeIntValue() * 1024 * 1024;
 }
 
 //==============================================================================
@@ -61,25 +107,19 @@ void MainComponent::prepareToPlay(int samplesPerBlockExpected, double sampleRate
 {
 	playlistComponent.prepareToPlay(samplesPerBlockExpected, sampleRate);
 
-	playerLeft.prepareToPlay(samplesPerBlockExpected, sampleRate);
-	playerRight.prepareToPlay(samplesPerBlockExpected, sampleRate);
-
-	mixerSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
-
-	mixerSource.addInputSource(&playerLeft, false);
-	mixerSource.addInputSource(&playerRight, false);
+	// Prepares both players as well
+	deckMixer.prepareToPlay(samplesPerBlockExpected, sampleRate);
 }
 
 void MainComponent::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
 {
-	mixerSource.getNextAudioBlock(bufferToFill);
+	deckMixer.getNextAudioBlock(bufferToFill);
 }
 
 void MainComponent::releaseResources()
 {
 	playlistComponent.releaseResources();
-	playerLeft.releaseResources();
-	playerRight.releaseResources();
+	deckMixer.releaseResources();
 }
 
 //==============================================================================
@@ -96,7 +136,15 @@ void MainComponent::resized()
 	// Position labels to left side of screen
 	waveformLabel.setBounds(0, 0, colW, rowH * 2);
 	posLabel.setBounds(0, rowH * 2, colW, rowH * 1.5);
-	widgetLabel.setBounds(0, rowH * 3.5, colW, rowH * 3.5);
+	widgetLabel.setBounds(0, rowH * 3.5, colW, rowH * 0.7);
+	autoGainToggle.setBounds(5, rowH * 4.2, colW - 10, rowH * 0.4);
+	decodeToggle.setBounds(5, rowH * 4.6, colW - 10, rowH * 0.4);
+
+	// Mixer controls share the left column with the labels
+	mixerLabel.setBounds(0, rowH * 5, colW, rowH * 0.4);
+	crossfaderSlider.setBounds(0, rowH * 5.4, colW, rowH * 0.4);
+	crossfadeCurveBox.setBounds(5, rowH * 5.8, colW - 10, rowH * 0.4);
+	masterGainSlider.setBounds(0, rowH * 6.2, colW, rowH * 0.8);
 	playlistLabel.setBounds(0, rowH * 7, colW, rowH * 3);
 
 	// Add GUIs
@@ -108,4 +156,41 @@ void MainComponent::resized()
 
 }
 
+void MainComponent::sliderValueChanged(juce::Slider* slider)
+{
+	if (slider == &crossfaderSlider)
+	{
+		deckMixer.setCrossfader((float) slider->getValue());
+	}
+	if (slider == &masterGainSlider)
+	{
+		deckMixer.setMasterGain((float) slider->getValue());
+	}
+}
+
+void MainComponent::comboBoxChanged(juce::ComboBox* comboBox)
+{
+	if (comboBox == &crossfadeCurveBox)
+	{
+		deckMixer.setCrossfadeCurve((DeckMixer::CrossfadeCurve) comboBox->getSelectedId());
+	}
+}
+
+void MainComponent::buttonClicked(juce::Button* button)
+{
+	if (button == &decodeToggle)
+	{
+		// Takes effect from the next track each deck loads
+		PcmCache* cache = decodeToggle.getToggleState() ? &pcmCache : nullptr;
+		playerLeft.setPcmCache(cache);
+		playerRight.setPcmCache(cache);
+	}
+	if (button == &autoGainToggle)
+	{
+		// Loaded tracks glide to their new level
+		playerLeft.setAutoGain(autoGainToggle.getToggleState());
+		playerRight.setAutoGain(autoGainToggle.getToggleState());
+	}
+}
+
 //==============================================================================
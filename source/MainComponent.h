@@ -4,9 +4,21 @@
 #include "DJAudioPlayer.h"
 #include "DeckGUI.h"
 #include "PlaylistComponent.h"
+#include "DeckMixer.h"
 
 //==============================================================================
-class MainComponent : public juce::AudioAppComponent
+// Registers the formats JUCE supports as it is built, so the members after it
+// can open files from their constructors and background jobs straight away
+struct BasicFormatManager : public juce::AudioFormatManager
+{
+	BasicFormatManager() { registerBasicFormats(); }
+};
+
+//==============================================================================
+class MainComponent : public juce::AudioAppComponent,
+					  public juce::Slider::Listener,
+					  public juce::ComboBox::Listener,
+					  public juce::Button::Listener
 {
 	public:
 		//==============================================================================
@@ -22,26 +34,53 @@ class MainComponent : public juce::AudioAppComponent
 		void paint(juce::Graphics& g) override;
 		void resized() override;
 
+		void sliderValueChanged(juce::Slider* slider) override;
+		void comboBoxChanged(juce::ComboBox* comboBox) override;
+		void buttonClicked(juce::Button* button) override;
+
 	private:
-		juce::AudioFormatManager formatManager;
-		juce::AudioThumbnailCache thumbCache{100}; //store up to 100 waveforms
+		// Cache budget given as "<option> <megabytes>" on the command line, or the default
+		static juce::int64 getCacheBudget(const juce::String& option, juce::int64 defaultBytes);
+
+		// Declared first, the playlist starts probing the library while it is constructed
+		BasicFormatManager formatManager;
+		WaveformDiskCache waveformCache{ WaveformDiskCache::getDefaultDirectory(),
+			getCacheBudget("--waveform-cache-mb", WaveformDiskCache::defaultMaxBytes) }; // waveforms kept between launches
+		PcmCache pcmCache{ PcmCache::getDefaultDirectory(),
+			getCacheBudget("--pcm-cache-mb", PcmCache::defaultMaxBytes) }; // decoded tracks for instant seeking
+		SeekIndexStore seekIndexStore{ SeekIndexStore::getDefaultDirectory() }; // MP3 seek indexes of the library tracks
+		WaveformLoader waveformLoader{ formatManager, &waveformCache, &pcmCache, &seekIndexStore }; // waveforms shared by both decks
+		// Shared by both decks to decode tracks ahead of the playhead
+		juce::TimeSliceThread readAheadThread{ "Deck read-ahead" };
 
 		int channelL = 0;
 		int channelR = 1;
 
-		PlaylistComponent playlistComponent{ formatManager };
-		DJAudioPlayer playerLeft{ formatManager };
-		DeckGUI deckGUILeft{ &playerLeft,&playlistComponent, formatManager, thumbCache, channelL };
+		PlaylistComponent playlistComponent{ formatManager, seekIndexStore };
+		DJAudioPlayer playerLeft{ formatManager, &readAheadThread, &seekIndexStore };
+		DeckGUI deckGUILeft{ &playerLeft,&playlistComponent, waveformLoader, channelL };
 
-		DJAudioPlayer playerRight{ formatManager };
-		DeckGUI deckGUIRight{ &playerRight, &playlistComponent, formatManager, thumbCache, channelR };
+		DJAudioPlayer playerRight{ formatManager, &readAheadThread, &seekIndexStore };
+		DeckGUI deckGUIRight{ &playerRight, &playlistComponent, waveformLoader, channelR };
 
 		juce::Label waveformLabel;
 		juce::Label posLabel;
 		juce::Label widgetLabel;
 		juce::Label playlistLabel;
 
-		juce::MixerAudioSource mixerSource;
+		// Sums both decks through the crossfader
+		DeckMixer deckMixer{ playerLeft, playerRight };
+
+		// Mixer controls
+		juce::Label mixerLabel;
+		juce::Slider crossfaderSlider;
+		juce::ComboBox crossfadeCurveBox;
+		juce::Slider masterGainSlider;
+
+		// Bring every track to a common loudness
+		juce::ToggleButton autoGainToggle{ "Auto gain" };
+		// Play both decks from decoded copies in the PCM cache
+		juce::ToggleButton decodeToggle{ "Decode to cache" };
 
 		JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MainComponent)
 };
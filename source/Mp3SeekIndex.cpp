@@ -0,0 +1,281 @@
+#include "Mp3SeekIndex.h"
+#include <cstring>
+
+namespace
+{
+	// Frame header fields that matter for finding the next frame
+	struct FrameHeader
+	{
+		bool isMpeg1 = false;
+		int sampleRate = 0;
+		int numChannels = 0;
+		int length = 0;
+		int samplesPerFrame = 0;
+	};
+
+	juce::uint32 readBigEndian(const juce::uint8* data)
+	{
+		return ((juce::uint32) data[0] << 24) | ((juce::uint32) data[1] << 16) | ((juce::uint32) data[2] << 8) | data[3];
+	}
+
+	// Layer III headers only, anything else is treated as not a frame
+	bool parseHeader(juce::uint32 header, FrameHeader& frame)
+	{
+		static const int mpeg1Bitrates[] = { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 };
+		static const int mpeg2Bitrates[] = { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 };
+		static const int mpeg1SampleRates[] = { 44100, 48000, 32000 };
+
+		int version = (int) (header >> 19) & 3;
+		int layer = (int) (header >> 17) & 3;
+		int bitrateIndex = (int) (header >> 12) & 15;
+		int sampleRateIndex = (int) (header >> 10) & 3;
+		if ((header >> 21) != 0x7ff || version == 1 || layer != 1
+			|| bitrateIndex == 0 || bitrateIndex == 15 || sampleRateIndex == 3)
+		{
+			return false;
+		}
+
+		// Version 3 is MPEG 1, 2 is MPEG 2 and 0 is MPEG 2.5
+		frame.isMpeg1 = version == 3;
+		frame.sampleRate = mpeg1SampleRates[sampleRateIndex] / (version == 3 ? 1 : (version == 2 ? 2 : 4));
+		frame.numChannels = ((header >> 6) & 3) == 3 ? 1 : 2;
+		frame.samplesPerFrame = frame.isMpeg1 ? 1152 : 576;
+
+		int bitrate = (frame.isMpeg1 ? mpeg1Bitrates : mpeg2Bitrates)[bitrateIndex] * 1000;
+		int padding = (int) (header >> 9) & 1;
+		frame.length = (frame.isMpeg1 ? 144 : 72) * bitrate / frame.sampleRate + padding;
+		return true;
+	}
+
+	// Looks for a Xing or Info tag in the first frame and the LAME delay and padding after it
+	bool readInfoTag(const juce::uint8* frameData, int frameLength, const FrameHeader& frame, int& delay, int& padding)
+	{
+		int sideInfoSize = frame.isMpeg1 ? (frame.numChannels == 1 ? 17 : 32) : (frame.numChannels == 1 ? 9 : 17);
+		int tag = 4 + sideInfoSize;
+		if (tag + 8 > frameLength
+			|| (std::memcmp(frameData + tag, "Xing", 4) != 0 && std::memcmp(frameData + tag, "Info", 4) != 0))
+		{
+			return false;
+		}
+
+		// Skip the optional frame count, byte count, table of contents and quality fields
+		juce::uint32 flags = readBigEndian(frameData + tag + 4);
+		int lame = tag + 8 + ((flags & 1) ? 4 : 0) + ((flags & 2) ? 4 : 0) + ((flags & 4) ? 100 : 0) + ((flags & 8) ? 4 : 0);
+		if (lame + 24 <= frameLength
+			&& (std::memcmp(frameData + lame, "LAME", 4) == 0 || std::memcmp(frameData + lame, "Lavf", 4) == 0 || std::memcmp(frameData + lame, "Lavc", 4) == 0))
+		{
+			const juce::uint8* delays = frameData + lame + 21;
+			delay = (delays[0] << 4) | (delays[1] >> 4);
+			padding = ((delays[1] & 15) << 8) | delays[2];
+		}
+		return true;
+	}
+
+	// Tags that can follow the audio, a header that fails to parse at one of these ends the track
+	bool isTrailingTag(const juce::uint8* data, juce::int64 remaining)
+	{
+		return (remaining >= 3 && (std::memcmp(data, "TAG", 3) == 0 || std::memcmp(data, "ID3", 3) == 0))
+			|| (remaining >= 6 && std::memcmp(data, "LYRICS", 6) == 0)
+			|| (remaining >= 8 && std::memcmp(data, "APETAGEX", 8) == 0);
+	}
+
+	// Identifies an index, bump the version whenever the layout changes
+	const juce::int32 seekIndexMagic = 0x4b455344; // "DSEK"
+	const juce::int32 seekIndexVersion = 1;
+}
+
+std::unique_ptr<Mp3SeekIndex> Mp3SeekIndex::build(juce::InputStream& in)
+{
+	juce::MemoryBlock block;
+	in.readIntoMemoryBlock(block);
+	const juce::uint8* data = static_cast<const juce::uint8*>(block.getData());
+	juce::int64 size = (juce::int64) block.getSize();
+
+	std::unique_ptr<Mp3SeekIndex> index(new Mp3SeekIndex());
+	index->fileSize = size;
+
+	// Skip an ID3v2 tag, its size is stored 7 bits per byte
+	juce::int64 position = 0;
+	if (size >= 10 && std::memcmp(data, "ID3", 3) == 0)
+	{
+		position = 10 + (((data[6] & 0x7f) << 21) | ((data[7] & 0x7f) << 14) | ((data[8] & 0x7f) << 7) | (data[9] & 0x7f));
+		if (data[5] & 0x10)
+		{
+			position += 10;
+		}
+	}
+
+	int delay = 0;
+	int padding = 0;
+	bool hasLameTag = false;
+	bool firstFrame = true;
+	// Set while each frame follows straight on from a frame already believed
+	bool inSync = false;
+	FrameHeader first;
+
+	auto matchesFirst = [&first, &firstFrame](const FrameHeader& frame)
+	{
+		return firstFrame || (frame.sampleRate == first.sampleRate && frame.isMpeg1 == first.isMpeg1);
+	};
+
+	while (position + 4 <= size)
+	{
+		FrameHeader frame;
+		if (! parseHeader(readBigEndian(data + position), frame) || ! matchesFirst(frame))
+		{
+			// Trailing tags end the audio. Anything else, before the first frame or a damaged
+			// stretch in the middle, is skipped a byte at a time until the frames pick up again.
+			if (! firstFrame && isTrailingTag(data + position, size - position))
+			{
+				break;
+			}
+			inSync = false;
+			++position;
+			continue;
+		}
+
+		// A false sync is only believed if another frame, the end of the file or a trailing tag follows it
+		if (! inSync)
+		{
+			FrameHeader next;
+			juce::int64 nextPosition = position + frame.length;
+			if (nextPosition + 4 <= size
+				&& ! (parseHeader(readBigEndian(data + nextPosition), next) && matchesFirst(next))
+				&& ! (! firstFrame && isTrailingTag(data + nextPosition, size - nextPosition)))
+			{
+				++position;
+				continue;
+			}
+			inSync = true;
+		}
+
+		if (firstFrame)
+		{
+			first = frame;
+			firstFrame = false;
+			int frameLength = (int) juce::jmin((juce::int64) frame.length, size - position);
+			if (readInfoTag(data + position, frameLength, frame, delay, padding))
+			{
+				// The tag frame decodes to silence and is not part of the track
+				hasLameTag = delay > 0 || padding > 0;
+				position += frame.length;
+				continue;
+			}
+		}
+
+		if (position + frame.length > size)
+		{
+			break;
+		}
+		index->frameOffsets.push_back((juce::uint32) position);
+		position += frame.length;
+	}
+
+	if (index->frameOffsets.empty())
+	{
+		return nullptr;
+	}
+
+	index->samplesPerFrame = first.samplesPerFrame;
+	index->sampleRate = first.sampleRate;
+	index->numChannels = first.numChannels;
+
+	juce::int64 decoded = (juce::int64) index->frameOffsets.size() * index->samplesPerFrame;
+	if (hasLameTag)
+	{
+		index->priming = delay + decoderDelay;
+		index->lengthInSamples = juce::jmin(decoded - delay - padding, decoded - index->priming);
+	}
+	else
+	{
+		index->lengthInSamples = decoded;
+	}
+	index->lengthInSamples = juce::jmax((juce::int64) 0, index->lengthInSamples);
+	return index;
+}
+
+void Mp3SeekIndex::writeTo(juce::OutputStream& out) const
+{
+	out.writeInt(seekIndexMagic);
+	out.writeInt(seekIndexVersion);
+	out.writeInt(samplesPerFrame);
+	out.writeDouble(sampleRate);
+	out.writeInt(numChannels);
+	out.writeInt(priming);
+	out.writeInt64(lengthInSamples);
+	out.writeInt64(fileSize);
+	out.writeInt((int) frameOffsets.size());
+	for (juce::uint32 offset : frameOffsets)
+	{
+		out.writeInt((int) offset);
+	}
+}
+
+std::unique_ptr<Mp3SeekIndex> Mp3SeekIndex::readFrom(juce::InputStream& in)
+{
+	if (in.readInt() != seekIndexMagic || in.readInt() != seekIndexVersion)
+	{
+		return nullptr;
+	}
+
+	std::unique_ptr<Mp3SeekIndex> index(new Mp3SeekIndex());
+	index->samplesPerFrame = in.readInt();
+	index->sampleRate = in.readDouble();
+	index->numChannels = in.readInt();
+	index->priming = in.readInt();
+	index->lengthInSamples = in.readInt64();
+	index->fileSize = in.readInt64();
+
+	int numFrames = in.readInt();
+	if (numFrames <= 0 || index->samplesPerFrame <= 0 || index->sampleRate <= 0
+		|| in.getNumBytesRemaining() < (juce::int64) numFrames * 4)
+	{
+		return nullptr;
+	}
+	index->frameOffsets.resize((size_t) numFrames);
+	for (juce::uint32& offset : index->frameOffsets)
+	{
+		offset = (juce::uint32) in.readInt();
+	}
+	return index;
+}
+
+int Mp3SeekIndex::getNumFrames() const
+{
+	return (int) frameOffsets.size();
+}
+
+juce::int64 Mp3SeekIndex::getFrameOffset(int frame) const
+{
+	return frameOffsets[(size_t) frame];
+}
+
+int Mp3SeekIndex::getSamplesPerFrame() const
+{
+	return samplesPerFrame;
+}
+
+double Mp3SeekIndex::getSampleRate() const
+{
+	return sampleRate;
+}
+
+int Mp3SeekIndex::getNumChannels() const
+{
+	return numChannels;
+}
+
+int Mp3SeekIndex::getPriming() const
+{
+	return priming;
+}
+
+juce::int64 Mp3SeekIndex::getLengthInSamples() const
+{
+	return lengthInSamples;
+}
+
+juce::int64 Mp3SeekIndex::getFileSize() const
+{
+	return fileSize;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory>
+#include <vector>
+
+// Byte offset of every audio frame in an MP3 file, with the encoder delay and
+// padding from its LAME tag. Built once by scanning the frame headers, then
+// any sample can be found by dividing by the frame size rather than decoding
+// from the start of the file.
+class Mp3SeekIndex
+{
+public:
+    // Scan the whole stream, returns nullptr if it is not MPEG layer III audio
+    static std::unique_ptr<Mp3SeekIndex> build(juce::InputStream& in);
+
+    void writeTo(juce::OutputStream& out) const;
+    // Returns nullptr if the data was not written by writeTo
+    static std::unique_ptr<Mp3SeekIndex> readFrom(juce::InputStream& in);
+
+    int getNumFrames() const;
+    juce::int64 getFrameOffset(int frame) const;
+    int getSamplesPerFrame() const;
+    double getSampleRate() const;
+    int getNumChannels() const;
+
+    // Decoded samples that come before the first sample of the track, from the
+    // encoder delay plus the decoder's own delay. Zero without a LAME tag.
+    int getPriming() const;
+
+    // Length of the track with the priming and padding removed
+    juce::int64 getLengthInSamples() const;
+
+    // Size of the file the index was built from, to check it still matches
+    juce::int64 getFileSize() const;
+
+    // Delay of the standard layer III synthesis filter bank
+    static constexpr int decoderDelay = 529;
+
+private:
+    Mp3SeekIndex() = default;
+
+    std::vector<juce::uint32> frameOffsets;
+    int samplesPerFrame = 0;
+    double sampleRate = 0.0;
+    int numChannels = 0;
+    int priming = 0;
+    juce::int64 lengthInSamples = 0;
+    juce::int64 fileSize = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Mp3SeekIndex)
+};
@@ -0,0 +1,127 @@
+#include "Mp3SeekingReader.h"
+
+std::unique_ptr<Mp3SeekingReader> Mp3SeekingReader::create(const juce::File& file,
+														   std::shared_ptr<const Mp3SeekIndex> index,
+														   juce::AudioFormat& mp3Format)
+{
+	if (index == nullptr || file.getSize() != index->getFileSize())
+	{
+		return nullptr;
+	}
+
+	std::unique_ptr<Mp3SeekingReader> reader(new Mp3SeekingReader(file, std::move(index), mp3Format));
+	if (! reader->seekDecoder(reader->index->getPriming()))
+	{
+		return nullptr;
+	}
+	return reader;
+}
+
+std::unique_ptr<juce::AudioFormatReader> Mp3SeekingReader::createReaderFor(const juce::File& file,
+																		   std::shared_ptr<const Mp3SeekIndex> index,
+																		   juce::AudioFormatManager& formatManager)
+{
+	juce::AudioFormat* mp3Format = formatManager.findFormatForFileExtension("mp3");
+	if (index != nullptr && mp3Format != nullptr)
+	{
+		std::unique_ptr<juce::AudioFormatReader> reader = create(file, std::move(index), *mp3Format);
+		if (reader != nullptr)
+		{
+			return reader;
+		}
+	}
+	return std::unique_ptr<juce::AudioFormatReader>(formatManager.createReaderFor(file));
+}
+
+Mp3SeekingReader::Mp3SeekingReader(const juce::File& _file, std::shared_ptr<const Mp3SeekIndex> _index, juce::AudioFormat& _mp3Format)
+	: juce::AudioFormatReader(nullptr, "MP3 with seek index"),
+	  file(_file),
+	  index(std::move(_index)),
+	  mp3Format(_mp3Format)
+{
+	sampleRate = index->getSampleRate();
+	bitsPerSample = 32;
+	lengthInSamples = index->getLengthInSamples();
+	numChannels = (unsigned int) index->getNumChannels();
+	usesFloatingPointData = true;
+
+	// Enough for the warm-up in a few reads
+	scratch.setSize((int) numChannels, index->getSamplesPerFrame() * 4);
+}
+
+bool Mp3SeekingReader::readSamples(DestChannels destChannels, int numDestChannels, int startOffsetInDestBuffer,
+								   juce::int64 startSampleInFile, int numSamples)
+{
+	clearSamplesBeyondAvailableLength(destChannels, numDestChannels, startOffsetInDestBuffer,
+									  startSampleInFile, numSamples, lengthInSamples);
+
+	juce::int64 target = startSampleInFile + index->getPriming();
+	if (numSamples > 0 && target != decoderPosition && ! seekDecoder(target))
+	{
+		return false;
+	}
+
+	for (int done = 0; done < numSamples;)
+	{
+		int chunk = juce::jmin(numSamples - done, scratch.getNumSamples());
+		if (! decode(chunk))
+		{
+			return false;
+		}
+
+		for (int channel = 0; channel < numDestChannels; ++channel)
+		{
+			if (destChannels[channel] != nullptr)
+			{
+				float* dest = reinterpret_cast<float*>(destChannels[channel]) + startOffsetInDestBuffer + done;
+				juce::FloatVectorOperations::copy(dest, scratch.getReadPointer(juce::jmin(channel, (int) numChannels - 1)), chunk);
+			}
+		}
+		done += chunk;
+	}
+	return true;
+}
+
+bool Mp3SeekingReader::seekDecoder(juce::int64 decodedSample)
+{
+	// The frame holding the sample, from the index rather than by scanning the file
+	int samplesPerFrame = index->getSamplesPerFrame();
+	int frame = (int) juce::jlimit((juce::int64) 0, (juce::int64) index->getNumFrames() - 1, decodedSample / samplesPerFrame);
+	int startFrame = juce::jmax(0, frame - warmupFrames);
+
+	std::unique_ptr<juce::FileInputStream> stream(new juce::FileInputStream(file));
+	if (stream->failedToOpen())
+	{
+		return false;
+	}
+	juce::int64 offset = index->getFrameOffset(startFrame);
+	decoder.reset(mp3Format.createReaderFor(new juce::SubregionStream(stream.release(), offset, -1, true), true));
+	if (decoder == nullptr)
+	{
+		decoderPosition = -1;
+		return false;
+	}
+
+	// Decode up to the target and throw it away
+	decoderStart = (juce::int64) startFrame * samplesPerFrame;
+	decoderPosition = decoderStart;
+	while (decoderPosition < decodedSample)
+	{
+		if (! decode((int) juce::jmin((juce::int64) scratch.getNumSamples(), decodedSample - decoderPosition)))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Mp3SeekingReader::decode(int numSamples)
+{
+	if (decoder == nullptr || ! decoder->read(&scratch, 0, numSamples, decoderPosition - decoderStart, true, true))
+	{
+		decoderPosition = -1;
+		return false;
+	}
+	decoderPosition += numSamples;
+	return true;
+}
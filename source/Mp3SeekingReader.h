@@ -0,0 +1,58 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory>
+#include "Mp3SeekIndex.h"
+
+// Reads an MP3 through its seek index. A jump starts a fresh decoder a few
+// frames before the frame holding the target, found from the index in
+// constant time, and decodes forward to the exact sample. The priming from
+// the LAME tag is skipped so sample 0 is the first sample of the track.
+// Reading straight on carries on with the same decoder.
+class Mp3SeekingReader : public juce::AudioFormatReader
+{
+public:
+#if JUCE_MAJOR_VERSION >= 7
+    using DestChannels = int* const*;
+#else
+    using DestChannels = int**;
+#endif
+
+    // Returns nullptr if the file has changed since the index was built or cannot be opened
+    static std::unique_ptr<Mp3SeekingReader> create(const juce::File& file,
+                                                    std::shared_ptr<const Mp3SeekIndex> index,
+                                                    juce::AudioFormat& mp3Format);
+
+    // Reads through the index when there is one that still matches the file, otherwise
+    // opens the file with whichever of the manager's formats can read it
+    static std::unique_ptr<juce::AudioFormatReader> createReaderFor(const juce::File& file,
+                                                                   std::shared_ptr<const Mp3SeekIndex> index,
+                                                                   juce::AudioFormatManager& formatManager);
+
+    bool readSamples(DestChannels destChannels, int numDestChannels, int startOffsetInDestBuffer,
+                     juce::int64 startSampleInFile, int numSamples) override;
+
+    // Frames decoded and thrown away before the target, so the bit reservoir
+    // and the synthesis filter have settled
+    static constexpr int warmupFrames = 3;
+
+private:
+    Mp3SeekingReader(const juce::File& _file, std::shared_ptr<const Mp3SeekIndex> _index, juce::AudioFormat& _mp3Format);
+
+    // Start a decoder for the given sample of the decoded stream, priming included
+    bool seekDecoder(juce::int64 decodedSample);
+    bool decode(int numSamples);
+
+    juce::File file;
+    std::shared_ptr<const Mp3SeekIndex> index;
+    juce::AudioFormat& mp3Format;
+
+    std::unique_ptr<juce::AudioFormatReader> decoder;
+    // Decoded stream sample where the decoder started and the next it will produce
+    juce::int64 decoderStart = 0;
+    juce::int64 decoderPosition = -1;
+
+    juce::AudioBuffer<float> scratch;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Mp3SeekingReader)
+};
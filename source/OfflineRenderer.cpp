@@ -0,0 +1,395 @@
+#include "OfflineRenderer.h"
+#include <algorithm>
+
+OfflineRenderer::OfflineRenderer(juce::AudioFormatManager& _formatManager)
+	: formatManager(_formatManager)
+{
+	leftDeck.setReadAhead(false, DJAudioPlayer::defaultReadAheadSamples);
+	rightDeck.setReadAhead(false, DJAudioPlayer::defaultReadAheadSamples);
+	// Time is not short offline, so speed changes use the best filter unless the script says otherwise
+	leftDeck.setResamplerQuality(PolyphaseResampler::Quality::mastering);
+	rightDeck.setResamplerQuality(PolyphaseResampler::Quality::mastering);
+}
+
+OfflineRenderer::~OfflineRenderer()
+{
+}
+
+juce::Result OfflineRenderer::loadScript(const juce::File& scriptFile)
+{
+	if (! scriptFile.existsAsFile())
+	{
+		return juce::Result::fail("Script not found: " + scriptFile.getFullPathName());
+	}
+
+	juce::StringArray lines;
+	scriptFile.readLines(lines);
+	for (int i = 0; i < lines.size(); ++i)
+	{
+		juce::String line = lines[i].upToFirstOccurrenceOf("#", false, false).trim();
+		if (line.isEmpty())
+		{
+			continue;
+		}
+
+		juce::StringArray tokens;
+		tokens.addTokens(line, " \t", "\"");
+		tokens.removeEmptyStrings();
+		for (juce::String& token : tokens)
+		{
+			token = token.unquoted();
+		}
+
+		// Timed commands start with "at <seconds>"
+		double time = 0.0;
+		if (tokens[0] == "at")
+		{
+			if (tokens.size() < 3 || ! tokens[1].containsOnly("0123456789."))
+			{
+				return juce::Result::fail("Line " + juce::String(i + 1) + ": expected \"at <seconds> <command>\"");
+			}
+			time = tokens[1].getDoubleValue();
+			tokens.removeRange(0, 2);
+		}
+
+		juce::Result result = parseCommand(tokens, time);
+		if (result.failed())
+		{
+			return juce::Result::fail("Line " + juce::String(i + 1) + ": " + result.getErrorMessage());
+		}
+	}
+
+	// Events at the same time keep the order they were written in
+	std::stable_sort(events.begin(), events.end(),
+		[](const ScriptEvent& a, const ScriptEvent& b) { return a.time < b.time; });
+	return juce::Result::ok();
+}
+
+juce::Result OfflineRenderer::parseCommand(const juce::StringArray& tokens, double time)
+{
+	const juce::String& command = tokens[0];
+	int numArgs = tokens.size() - 1;
+
+	// Settings for the whole render
+	if (command == "samplerate" && numArgs == 1)
+	{
+		sampleRate = juce::jlimit(8000.0, 384000.0, tokens[1].getDoubleValue());
+		return juce::Result::ok();
+	}
+	if (command == "blocksize" && numArgs == 1)
+	{
+		blockSize = juce::jlimit(16, 16384, tokens[1].getIntValue());
+		return juce::Result::ok();
+	}
+	if (command == "length" && numArgs == 1)
+	{
+		lengthSeconds = juce::jmax(0.0, tokens[1].getDoubleValue());
+		return juce::Result::ok();
+	}
+
+	if (command == "quality" && numArgs == 1)
+	{
+		PolyphaseResampler::Quality quality;
+		if (tokens[1] == "draft")
+		{
+			quality = PolyphaseResampler::Quality::draft;
+		}
+		else if (tokens[1] == "standard")
+		{
+			quality = PolyphaseResampler::Quality::standard;
+		}
+		else if (tokens[1] == "mastering")
+		{
+			quality = PolyphaseResampler::Quality::mastering;
+		}
+		else
+		{
+			return juce::Result::fail("unknown resampler quality \"" + tokens[1] + "\"");
+		}
+		leftDeck.setResamplerQuality(quality);
+		rightDeck.setResamplerQuality(quality);
+		return juce::Result::ok();
+	}
+
+	// Mixer controls
+	if (command == "crossfader" && numArgs == 1)
+	{
+		float position = tokens[1].getFloatValue();
+		addEvent(time, [this, position] { mixer.setCrossfader(position); });
+		return juce::Result::ok();
+	}
+	if (command == "master" && numArgs == 1)
+	{
+		float gain = tokens[1].getFloatValue();
+		addEvent(time, [this, gain] { mixer.setMasterGain(gain); });
+		return juce::Result::ok();
+	}
+	if (command == "curve" && numArgs == 1)
+	{
+		DeckMixer::CrossfadeCurve curve;
+		if (tokens[1] == "linear")
+		{
+			curve = DeckMixer::CrossfadeCurve::linear;
+		}
+		else if (tokens[1] == "power")
+		{
+			curve = DeckMixer::CrossfadeCurve::constantPower;
+		}
+		else if (tokens[1] == "cut")
+		{
+			curve = DeckMixer::CrossfadeCurve::sharpCut;
+		}
+		else
+		{
+			return juce::Result::fail("unknown crossfade curve \"" + tokens[1] + "\"");
+		}
+		addEvent(time, [this, curve] { mixer.setCrossfadeCurve(curve); });
+		return juce::Result::ok();
+	}
+
+	// Deck controls, the deck name always follows the command
+	DJAudioPlayer* deck = findDeck(tokens[1]);
+	if (deck == nullptr)
+	{
+		return juce::Result::fail("unknown command or deck in \"" + tokens.joinIntoString(" ") + "\"");
+	}
+
+	if (command == "load" && numArgs == 2)
+	{
+		juce::File file = juce::File::getCurrentWorkingDirectory().getChildFile(tokens[2]);
+		std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+		if (reader == nullptr)
+		{
+			return juce::Result::fail("cannot read " + file.getFullPathName());
+		}
+		longestTrackSeconds = juce::jmax(longestTrackSeconds, time + reader->lengthInSamples / reader->sampleRate);
+
+		// Index MP3s the way the library does, so renders seek like the app
+		DJAudioPlayer::TrackDetails details;
+		if (file.hasFileExtension("mp3"))
+		{
+			juce::FileInputStream in(file);
+			if (in.openedOk())
+			{
+				details.seekIndex = Mp3SeekIndex::build(in);
+			}
+		}
+
+		juce::URL url{ file };
+		addEvent(time, [deck, url, details] { deck->loadURL(url, details); });
+		return juce::Result::ok();
+	}
+	if (command == "play" && numArgs == 1)
+	{
+		addEvent(time, [deck] { deck->start(); });
+		return juce::Result::ok();
+	}
+	if (command == "gain" && numArgs == 2)
+	{
+		double gain = tokens[2].getDoubleValue();
+		addEvent(time, [deck, gain] { deck->setGain(gain); });
+		return juce::Result::ok();
+	}
+	if (command == "speed" && numArgs == 2)
+	{
+		double ratio = tokens[2].getDoubleValue();
+		addEvent(time, [deck, ratio] { deck->setSpeed(ratio); });
+		return juce::Result::ok();
+	}
+	if (command == "seek" && numArgs == 2)
+	{
+		double seconds = tokens[2].getDoubleValue();
+		addEvent(time, [deck, seconds] { deck->setPosition(seconds); });
+		return juce::Result::ok();
+	}
+	if (command == "loop" && numArgs == 2)
+	{
+		const juce::String& action = tokens[2];
+		if (action == "on")
+		{
+			addEvent(time, [deck] { deck->setLoop(); });
+		}
+		else if (action == "off")
+		{
+			addEvent(time, [deck] { deck->unsetLoop(); });
+		}
+		else if (action == "in")
+		{
+			addEvent(time, [deck] { deck->setLoopIn(); });
+		}
+		else if (action == "out")
+		{
+			addEvent(time, [deck] { deck->setLoopOut(); });
+		}
+		else if (action == "half")
+		{
+			addEvent(time, [deck] { deck->halveLoop(); });
+		}
+		else if (action == "double")
+		{
+			addEvent(time, [deck] { deck->doubleLoop(); });
+		}
+		else if (action.getDoubleValue() > 0.0)
+		{
+			// A length in beats, fractions such as 1/4 allowed
+			double beats = action.containsChar('/')
+				? action.upToFirstOccurrenceOf("/", false, false).getDoubleValue() / action.fromFirstOccurrenceOf("/", false, false).getDoubleValue()
+				: action.getDoubleValue();
+			addEvent(time, [deck, beats]
+			{
+				deck->setLoopLength(beats);
+				if (! deck->isLooping())
+				{
+					deck->setLoop();
+				}
+			});
+		}
+		else
+		{
+			return juce::Result::fail("loop takes on, off, in, out, half, double or a length in beats");
+		}
+		return juce::Result::ok();
+	}
+	if (command == "cue" && (numArgs == 2 || numArgs == 3))
+	{
+		int index = tokens[2].getIntValue() - 1;
+		if (index < 0 || index >= HotCues::numCues)
+		{
+			return juce::Result::fail("hot cues are numbered 1 to " + juce::String(HotCues::numCues));
+		}
+
+		const juce::String action = numArgs == 3 ? tokens[3] : juce::String();
+		if (action.isEmpty())
+		{
+			addEvent(time, [deck, index] { deck->jumpToHotCue(index); });
+		}
+		else if (action == "set")
+		{
+			addEvent(time, [deck, index] { deck->setHotCue(index); });
+		}
+		else if (action == "clear")
+		{
+			addEvent(time, [deck, index] { deck->clearHotCue(index); });
+		}
+		else
+		{
+			return juce::Result::fail("cue takes set, clear or nothing to jump");
+		}
+		return juce::Result::ok();
+	}
+	if (command == "reverb" && numArgs == 3)
+	{
+		float value = tokens[3].getFloatValue();
+		if (tokens[2] == "room")
+		{
+			addEvent(time, [deck, value] { deck->setReverbRoomSize(value); });
+		}
+		else if (tokens[2] == "damping")
+		{
+			addEvent(time, [deck, value] { deck->setReverbDamping(value); });
+		}
+		else if (tokens[2] == "balance")
+		{
+			addEvent(time, [deck, value] { deck->setReverbBalance(value); });
+		}
+		else
+		{
+			return juce::Result::fail("unknown reverb setting \"" + tokens[2] + "\"");
+		}
+		return juce::Result::ok();
+	}
+
+	return juce::Result::fail("cannot understand \"" + tokens.joinIntoString(" ") + "\"");
+}
+
+DJAudioPlayer* OfflineRenderer::findDeck(const juce::String& name)
+{
+	if (name == "left")
+	{
+		return &leftDeck;
+	}
+	if (name == "right")
+	{
+		return &rightDeck;
+	}
+	return nullptr;
+}
+
+void OfflineRenderer::addEvent(double time, std::function<void()> apply)
+{
+	ScriptEvent event;
+	event.time = time;
+	event.apply = std::move(apply);
+	events.push_back(std::move(event));
+}
+
+//==============================================================================
+juce::Result OfflineRenderer::render(const juce::File& outputFile)
+{
+	double seconds = lengthSeconds > 0 ? lengthSeconds : longestTrackSeconds;
+	juce::int64 totalSamples = (juce::int64) (seconds * sampleRate);
+	if (totalSamples <= 0)
+	{
+		return juce::Result::fail("Nothing to render, load a track or set a length");
+	}
+
+	outputFile.deleteFile();
+	std::unique_ptr<juce::FileOutputStream> stream(outputFile.createOutputStream());
+	if (stream == nullptr)
+	{
+		return juce::Result::fail("Cannot write to " + outputFile.getFullPathName());
+	}
+	juce::WavAudioFormat wavFormat;
+	std::unique_ptr<juce::AudioFormatWriter> writer(wavFormat.createWriterFor(stream.get(), sampleRate, 2, 24, {}, 0));
+	if (writer == nullptr)
+	{
+		return juce::Result::fail("Cannot create a WAV writer for " + outputFile.getFullPathName());
+	}
+	// The writer owns the stream from here
+	stream.release();
+
+	for (ScriptEvent& event : events)
+	{
+		event.samplePosition = (juce::int64) (event.time * sampleRate);
+	}
+
+	mixer.prepareToPlay(blockSize, sampleRate);
+	juce::AudioBuffer<float> buffer(2, blockSize);
+
+	juce::int64 mixTicks = 0;
+	juce::int64 startTicks = juce::Time::getHighResolutionTicks();
+	size_t nextEvent = 0;
+	for (juce::int64 position = 0; position < totalSamples;)
+	{
+		while (nextEvent < events.size() && events[nextEvent].samplePosition <= position)
+		{
+			events[nextEvent++].apply();
+		}
+
+		// Blocks are cut short at the next event so every change lands on its sample
+		juce::int64 blockEnd = juce::jmin(totalSamples, position + blockSize);
+		if (nextEvent < events.size())
+		{
+			blockEnd = juce::jmin(blockEnd, events[nextEvent].samplePosition);
+		}
+		int numSamples = (int) (blockEnd - position);
+
+		juce::int64 mixStart = juce::Time::getHighResolutionTicks();
+		juce::AudioSourceChannelInfo info(&buffer, 0, numSamples);
+		info.clearActiveBufferRegion();
+		mixer.getNextAudioBlock(info);
+		mixTicks += juce::Time::getHighResolutionTicks() - mixStart;
+
+		writer->writeFromAudioSampleBuffer(buffer, 0, numSamples);
+		position = blockEnd;
+	}
+	writer.reset();
+	double wallSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+	double mixSeconds = juce::Time::highResolutionTicksToSeconds(mixTicks);
+	mixer.releaseResources();
+
+	std::cout << "Rendered " << seconds << " s to " << outputFile.getFullPathName() << std::endl;
+	std::cout << "Total " << wallSeconds << " s (" << seconds / juce::jmax(1.0e-9, wallSeconds) << "x realtime), "
+			  << "mixing only " << mixSeconds << " s (" << seconds / juce::jmax(1.0e-9, mixSeconds) << "x realtime)" << std::endl;
+	return juce::Result::ok();
+}
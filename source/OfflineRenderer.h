@@ -0,0 +1,70 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <functional>
+#include <vector>
+#include "DJAudioPlayer.h"
+#include "DeckMixer.h"
+
+// Renders a scripted mix of both decks straight to a WAV file, pulling blocks
+// as fast as the CPU allows instead of waiting for an audio device. Tracks are
+// decoded on the rendering thread, so every run of a script gives the same file.
+//
+// The script is plain text, one command per line, '#' starts a comment:
+//     samplerate 44100
+//     blocksize 512
+//     quality mastering           (speed filter: draft, standard or mastering)
+//     length 180                  (seconds, defaults to the longest track)
+//     load left "/music/a.mp3"
+//     at 0 play left
+//     at 30 gain right 0.8
+//     at 30 speed right 1.05
+//     at 45 reverb left room 0.6  (room, damping or balance)
+//     at 60 loop left on          (on, off, in, out, half, double or beats such as 1/4)
+//     at 70 cue left 1 set        (hot cue 1 - 8: set, clear, or jump to it without either)
+//     at 90 seek left 42.5
+//     at 95 load right "/music/c.wav"
+//     at 100 crossfader 0.8
+//     at 100 curve linear         (linear, power or cut)
+//     at 100 master 1.2
+// Commands without "at" happen at the start. Changes land on the exact sample.
+class OfflineRenderer
+{
+public:
+    OfflineRenderer(juce::AudioFormatManager& _formatManager);
+    ~OfflineRenderer();
+
+    // Read the settings, tracks and timed control changes from a script
+    juce::Result loadScript(const juce::File& scriptFile);
+
+    // Render the mix to a WAV file and print how much faster than realtime it ran
+    juce::Result render(const juce::File& outputFile);
+
+private:
+    struct ScriptEvent
+    {
+        double time = 0.0;
+        juce::int64 samplePosition = 0;
+        std::function<void()> apply;
+    };
+
+    juce::Result parseCommand(const juce::StringArray& tokens, double time);
+    DJAudioPlayer* findDeck(const juce::String& name);
+    void addEvent(double time, std::function<void()> apply);
+
+    juce::AudioFormatManager& formatManager;
+
+    // No read-ahead thread, the decks decode in line with the render
+    DJAudioPlayer leftDeck{ formatManager };
+    DJAudioPlayer rightDeck{ formatManager };
+    DeckMixer mixer{ leftDeck, rightDeck };
+
+    double sampleRate = 44100.0;
+    int blockSize = 512;
+    double lengthSeconds = 0.0;
+    double longestTrackSeconds = 0.0;
+
+    std::vector<ScriptEvent> events;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(OfflineRenderer)
+};
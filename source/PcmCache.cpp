@@ -0,0 +1,268 @@
+#include "PcmCache.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	const char* const entryExtension = ".pcm";
+
+	// Identifies a decoded track file, bump the version whenever the layout changes
+	const juce::int32 pcmMagic = 0x4d43504f; // "OPCM"
+	const juce::int32 pcmVersion = 1;
+	// Magic, version, channels, spare, sample rate, length. Each channel's samples
+	// follow one after the other, so a read is a copy per channel.
+	const int headerSize = 4 * 4 + 8 + 8;
+}
+
+//==============================================================================
+// Reads straight out of the mapped file, keeping the mapping open while it exists
+class PcmCache::MappedReader : public juce::AudioFormatReader
+{
+public:
+#if JUCE_MAJOR_VERSION >= 7
+	using DestChannels = int* const*;
+#else
+	using DestChannels = int**;
+#endif
+
+	MappedReader(std::shared_ptr<juce::MemoryMappedFile> _mapping, int _numChannels, double _sampleRate, juce::int64 _lengthInSamples)
+		: juce::AudioFormatReader(nullptr, "Decoded PCM"),
+		  mapping(std::move(_mapping))
+	{
+		sampleRate = _sampleRate;
+		bitsPerSample = 32;
+		lengthInSamples = _lengthInSamples;
+		numChannels = (unsigned int) _numChannels;
+		usesFloatingPointData = true;
+		samples = reinterpret_cast<const float*>(static_cast<const char*>(mapping->getData()) + headerSize);
+	}
+
+	bool readSamples(DestChannels destChannels, int numDestChannels, int startOffsetInDestBuffer,
+					 juce::int64 startSampleInFile, int numSamples) override
+	{
+		clearSamplesBeyondAvailableLength(destChannels, numDestChannels, startOffsetInDestBuffer,
+										  startSampleInFile, numSamples, lengthInSamples);
+		if (numSamples <= 0)
+		{
+			return true;
+		}
+
+		for (int channel = 0; channel < numDestChannels; ++channel)
+		{
+			if (destChannels[channel] == nullptr)
+			{
+				continue;
+			}
+
+			float* dest = reinterpret_cast<float*>(destChannels[channel]) + startOffsetInDestBuffer;
+			if (channel < (int) numChannels)
+			{
+				std::memcpy(dest, samples + channel * lengthInSamples + startSampleInFile, sizeof(float) * (size_t) numSamples);
+			}
+			else
+			{
+				juce::FloatVectorOperations::clear(dest, numSamples);
+			}
+		}
+		return true;
+	}
+
+private:
+	std::shared_ptr<juce::MemoryMappedFile> mapping;
+	const float* samples = nullptr;
+};
+
+//==============================================================================
+PcmCache::PcmCache(const juce::File& _directory, juce::int64 _maxBytes)
+	: directory(_directory),
+	  maxBytes(_maxBytes)
+{
+}
+
+juce::File PcmCache::getDefaultDirectory()
+{
+	return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+		.getChildFile("Otodecks")
+		.getChildFile("DecodedCache");
+}
+
+std::unique_ptr<juce::AudioFormatReader> PcmCache::createReader(const juce::String& key)
+{
+	std::shared_ptr<juce::MemoryMappedFile> mapping = openMapping(key);
+	if (mapping == nullptr)
+	{
+		return nullptr;
+	}
+
+	juce::MemoryInputStream in(mapping->getData(), (size_t) headerSize, false);
+	in.skipNextBytes(8);
+	int numChannels = in.readInt();
+	in.readInt();
+	double sampleRate = in.readDouble();
+	juce::int64 lengthInSamples = in.readInt64();
+	return std::unique_ptr<juce::AudioFormatReader>(new MappedReader(std::move(mapping), numChannels, sampleRate, lengthInSamples));
+}
+
+bool PcmCache::decode(const juce::String& key, juce::AudioFormatReader& source, const std::function<bool()>& shouldStop)
+{
+	int numChannels = (int) juce::jlimit((unsigned int) 1, (unsigned int) 2, source.numChannels);
+	juce::int64 length = source.lengthInSamples;
+	if (source.sampleRate <= 0 || length <= 0 || directory.createDirectory().failed())
+	{
+		return false;
+	}
+
+	// Write next to the entry and swap it in, so a crash never leaves a half written file
+	juce::File file = getEntryFile(key);
+	juce::TemporaryFile temp(file);
+	{
+		juce::FileOutputStream out(temp.getFile());
+		if (out.failedToOpen())
+		{
+			return false;
+		}
+
+		out.writeInt(pcmMagic);
+		out.writeInt(pcmVersion);
+		out.writeInt(numChannels);
+		out.writeInt(0);
+		out.writeDouble(source.sampleRate);
+		out.writeInt64(length);
+
+		const int blockSize = 65536;
+		juce::AudioBuffer<float> buffer(numChannels, blockSize);
+		for (juce::int64 position = 0; position < length; position += blockSize)
+		{
+			if (shouldStop != nullptr && shouldStop())
+			{
+				return false;
+			}
+
+			int numSamples = (int) juce::jmin((juce::int64) blockSize, length - position);
+			if (! source.read(&buffer, 0, numSamples, position, true, true))
+			{
+				return false;
+			}
+
+			// Each block goes to its place in every channel's run of samples
+			for (int channel = 0; channel < numChannels; ++channel)
+			{
+				if (! out.setPosition(headerSize + (channel * length + position) * (juce::int64) sizeof(float))
+					|| ! out.write(buffer.getReadPointer(channel), sizeof(float) * (size_t) numSamples))
+				{
+					return false;
+				}
+			}
+		}
+
+		out.flush();
+		if (out.getStatus().failed())
+		{
+			return false;
+		}
+	}
+
+	const juce::ScopedLock sl(lock);
+	if (! temp.overwriteTargetFileWithTemporary())
+	{
+		return false;
+	}
+	evict();
+	return true;
+}
+
+void PcmCache::setMaxBytes(juce::int64 newMaxBytes)
+{
+	maxBytes = juce::jmax((juce::int64) 0, newMaxBytes);
+	const juce::ScopedLock sl(lock);
+	evict();
+}
+
+std::shared_ptr<juce::MemoryMappedFile> PcmCache::openMapping(const juce::String& key)
+{
+	const juce::ScopedLock sl(lock);
+
+	// Another deck may already have it open
+	auto open = openMappings.find(key);
+	if (open != openMappings.end())
+	{
+		if (std::shared_ptr<juce::MemoryMappedFile> mapping = open->second.lock())
+		{
+			return mapping;
+		}
+		openMappings.erase(open);
+	}
+
+	juce::File file = getEntryFile(key);
+	std::shared_ptr<juce::MemoryMappedFile> mapping(new juce::MemoryMappedFile(file, juce::MemoryMappedFile::readOnly));
+	if (mapping->getData() == nullptr || mapping->getSize() < (size_t) headerSize)
+	{
+		return nullptr;
+	}
+
+	juce::MemoryInputStream in(mapping->getData(), (size_t) headerSize, false);
+	if (in.readInt() != pcmMagic || in.readInt() != pcmVersion)
+	{
+		DBG("PcmCache::openMapping - " << file.getFullPathName() << " is not a decoded track of this version");
+		return nullptr;
+	}
+	int numChannels = in.readInt();
+	in.readInt();
+	double sampleRate = in.readDouble();
+	juce::int64 length = in.readInt64();
+	if (numChannels < 1 || numChannels > 2 || sampleRate <= 0 || length <= 0
+		|| mapping->getSize() != headerSize + (size_t) (numChannels * length) * sizeof(float))
+	{
+		return nullptr;
+	}
+
+	// The modification time doubles as the last use for eviction
+	file.setLastModificationTime(juce::Time::getCurrentTime());
+	openMappings[key] = mapping;
+	return mapping;
+}
+
+juce::File PcmCache::getEntryFile(const juce::String& key) const
+{
+	return directory.getChildFile(key + entryExtension);
+}
+
+void PcmCache::evict()
+{
+	juce::Array<juce::File> entries = directory.findChildFiles(juce::File::findFiles, false, juce::String("*") + entryExtension);
+
+	juce::int64 total = 0;
+	for (const juce::File& entry : entries)
+	{
+		total += entry.getSize();
+	}
+	if (total <= maxBytes)
+	{
+		return;
+	}
+
+	// Oldest use first, skipping tracks a deck is playing from
+	std::sort(entries.begin(), entries.end(), [](const juce::File& a, const juce::File& b)
+	{
+		return a.getLastModificationTime() < b.getLastModificationTime();
+	});
+	for (const juce::File& entry : entries)
+	{
+		if (total <= maxBytes)
+		{
+			break;
+		}
+
+		auto open = openMappings.find(entry.getFileNameWithoutExtension());
+		if (open != openMappings.end() && ! open->second.expired())
+		{
+			continue;
+		}
+
+		juce::int64 size = entry.getSize();
+		if (entry.deleteFile())
+		{
+			total -= size;
+		}
+	}
+}
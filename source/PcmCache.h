@@ -0,0 +1,48 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+
+// Tracks decoded once into files of float samples and played back through a
+// memory mapping, so a seek only moves a read position and decks playing the
+// same track share one mapping. Entries are named after the track's TrackKey.
+// When the cache grows past its byte budget the least recently used entries
+// are deleted, except ones a reader still has open.
+class PcmCache
+{
+public:
+    PcmCache(const juce::File& _directory, juce::int64 _maxBytes = defaultMaxBytes);
+
+    // Default location of the cache in the user's application data folder
+    static juce::File getDefaultDirectory();
+
+    // A reader over the decoded track, or nullptr if it has not been decoded (any thread)
+    std::unique_ptr<juce::AudioFormatReader> createReader(const juce::String& key);
+
+    // Decode the whole of source into the cache. Returns false if it could not be
+    // read or written, or shouldStop returned true part way through (any thread).
+    bool decode(const juce::String& key, juce::AudioFormatReader& source, const std::function<bool()>& shouldStop);
+
+    void setMaxBytes(juce::int64 newMaxBytes);
+
+    static constexpr juce::int64 defaultMaxBytes = (juce::int64) 2048 * 1024 * 1024;
+
+private:
+    class MappedReader;
+
+    std::shared_ptr<juce::MemoryMappedFile> openMapping(const juce::String& key);
+    juce::File getEntryFile(const juce::String& key) const;
+    void evict();
+
+    juce::File directory;
+    std::atomic<juce::int64> maxBytes;
+
+    // Mappings still held by a reader, shared by every reader of the same track
+    juce::CriticalSection lock;
+    std::map<juce::String, std::weak_ptr<juce::MemoryMappedFile>> openMappings;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PcmCache)
+};
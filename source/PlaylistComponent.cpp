@@ -1,15 +1,21 @@
 #include <JuceHeader.h>
 #include "PlaylistComponent.h"
+#include "KeyDetector.h"
+#include <algorithm>
+#include <numeric>
 
 //==============================================================================
-PlaylistComponent::PlaylistComponent(juce::AudioFormatManager& _formatManager)
-                                     : formatManager(_formatManager)
+PlaylistComponent::PlaylistComponent(juce::AudioFormatManager& _formatManager, SeekIndexStore& _seekIndexStore)
+                                     : formatManager(_formatManager),
+                                       seekIndexStore(_seekIndexStore)
 {
     // Set up playlist library table 
     tableComponent.getHeader().addColumn("Track Title", 1, 250);
     tableComponent.getHeader().addColumn("Duration", 2, 100);
-    tableComponent.getHeader().addColumn("Add to Left GUI", 3, 150);
-    tableComponent.getHeader().addColumn("Add to Right GUI", 4, 150);
+    tableComponent.getHeader().addColumn("BPM", 5, 80);
+    tableComponent.getHeader().addColumn("Key", 6, 60);
+    tableComponent.getHeader().addColumn("Add to Left GUI", 3, 150, 30, -1, juce::TableHeaderComponent::notSortable);
+    tableComponent.getHeader().addColumn("Add to Right GUI", 4, 150, 30, -1, juce::TableHeaderComponent::notSortable);
     tableComponent.setModel(this);
     addAndMakeVisible(tableComponent);
 
@@ -19,10 +25,22 @@ PlaylistComponent::PlaylistComponent(juce::AudioFormatManager& _formatManager)
     // Add label for search bar
     addAndMakeVisible(searchLabel);
     searchLabel.setText("Find Track: ", juce::dontSendNotification);
+
+    // Add progress bar and cancel button, only shown while files are being scanned
+    addChildComponent(scanProgressBar);
+    addChildComponent(cancelScanButton);
+    cancelScanButton.addListener(this);
+
+    // Show the library from the last session straight away and check it against the disk in the background
+    loadLibrary();
 }
 
 PlaylistComponent::~PlaylistComponent()
 {
+    stopTimer();
+    scanner.cancel();
+    analyser.cancel();
+    saveLibrary();
 }
 
 void PlaylistComponent::paint (juce::Graphics& g)
@@ -34,6 +52,9 @@ void PlaylistComponent::resized()
     double rowH = getHeight() / 8;
     double colW = getWidth() / 6;
 
+    // Set position of scan progress
+    scanProgressBar.setBounds(0, rowH * 0.25, colW * 5, rowH);
+    cancelScanButton.setBounds(colW * 5, rowH * 0.25, colW, rowH);
     // Set position of search functionality
     searchLabel.setBounds(0, rowH * 1.5, colW, rowH);
     searchBar.setBounds(colW, rowH * 1.5, colW * 5, rowH);
@@ -43,7 +64,7 @@ void PlaylistComponent::resized()
 
 int PlaylistComponent::getNumRows()
 {
-    return interestedTitle.size(); // length of filtered vector
+    return filteredTracks.size(); // number of tracks matching the search
 };
 void PlaylistComponent::paintRowBackground(juce::Graphics & g,
                                            int rowNumber,
@@ -68,11 +89,17 @@ void PlaylistComponent::paintCell(juce::Graphics& g,
                                   int height,
                                   bool rowIsSelected)
 {
+    if (rowNumber < 0 || rowNumber >= (int) filteredTracks.size())
+    {
+        return;
+    }
+
+    TrackId id = filteredTracks[rowNumber];
     // Draw Track Title Name to first column
     if (columnId == 1)
     {
-        g.drawText(interestedTitle[rowNumber],
-            1, rowNumber,
+        g.drawText(tracks.getTitle(id),
+            1, 0,
             width - 4, height,
             juce::Justification::centredLeft,
             true);
@@ -80,66 +107,92 @@ void PlaylistComponent::paintCell(juce::Graphics& g,
     // Draw duration in seconds to second column
     if (columnId == 2)
     {
-        g.drawText(std::to_string(interestedDuration[rowNumber]) + "s",
-            1, rowNumber,
+        g.drawText(juce::String((int) tracks.getDuration(id)) + "s",
+            1, 0,
             width - 4, height,
             juce::Justification::centredLeft,
             true);
     }
-};
-
-juce::Component* PlaylistComponent::refreshComponentForCell(int rowNumber,
-                                                            int columnId,
-                                                            bool isRowSelected,
-                                                            Component* existingComponentToUpdate)
-{
-    // Create buttons for each line in the 3rd column to add to the Left channel deck
-    if (columnId == 3)
+    // Draw the tempo once the track has been analysed, a dash if no steady tempo was found
+    if (columnId == 5)
     {
-        if (existingComponentToUpdate == nullptr)
+        const TrackAnalysis& analysis = tracks.getAnalysis(id);
+        juce::String bpm;
+        if (analysis.isAnalysed)
         {
-            juce::TextButton* btn = new juce::TextButton{ "Add" };
-            juce::String id{ std::to_string(rowNumber) };
-            btn->setComponentID(id);
-            btn->addListener(this);
-            existingComponentToUpdate = btn;
-            btn->setColour(juce::TextButton::buttonColourId, juce::Colours::darkslategrey);
+            bpm = analysis.beatGrid.isValid() ? juce::String(analysis.beatGrid.bpm, 1) : "-";
         }
+        g.drawText(bpm,
+            1, 0,
+            width - 4, height,
+            juce::Justification::centredLeft,
+            true);
     }
-    // Create buttons for each line in the 3rd column to add to the Right channel deck
-    if (columnId == 4)
+    // Draw the key once the track has been analysed, a dash if it has no clear key
+    if (columnId == 6)
     {
-        if (existingComponentToUpdate == nullptr)
+        const TrackAnalysis& analysis = tracks.getAnalysis(id);
+        juce::String key;
+        if (analysis.isAnalysed)
         {
-            juce::TextButton* btn = new juce::TextButton{ "Add" };
-            // add 1000 to id to allow buttons to be processed differently between channels
-            juce::String id{ std::to_string(rowNumber + 1000) };
-            btn->setComponentID(id);
-            btn->addListener(this);
-            existingComponentToUpdate = btn;
-            btn->setColour(juce::TextButton::buttonColourId, juce::Colours::darkslategrey);
+            key = analysis.key >= 0 ? KeyDetector::getKeyName(analysis.key) : "-";
         }
+        g.drawText(key,
+            1, 0,
+            width - 4, height,
+            juce::Justification::centredLeft,
+            true);
+    }
+    // The add buttons are drawn rather than created as components, so scrolling never allocates them
+    if (columnId == 3 || columnId == 4)
+    {
+        juce::Rectangle<float> button = juce::Rectangle<float>(0.0f, 0.0f, (float) width, (float) height).reduced(4.0f, 2.0f);
+        g.setColour(juce::Colours::darkslategrey);
+        g.fillRoundedRectangle(button, 4.0f);
+        g.setColour(juce::Colours::white);
+        g.drawText("Add", button, juce::Justification::centred, false);
     }
-    return existingComponentToUpdate;
 };
 
+void PlaylistComponent::cellClicked(int rowNumber, int columnId, const juce::MouseEvent&)
+{
+    if (rowNumber < 0 || rowNumber >= (int) filteredTracks.size())
+    {
+        return;
+    }
+
+    // Add to the Left channel deck from the 3rd column and to the Right channel deck from the 4th
+    if (columnId == 3)
+    {
+        addToChannelList(filteredTracks[rowNumber], 0);
+    }
+    if (columnId == 4)
+    {
+        addToChannelList(filteredTracks[rowNumber], 1);
+    }
+}
+
 // AudioSource pure virtual functions
 void PlaylistComponent::prepareToPlay(int samplesPerBlockExpected, double sampleRate) {}
 void PlaylistComponent::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) {}
 void PlaylistComponent::releaseResources() {}
 
+void PlaylistComponent::sortOrderChanged(int newSortColumnId, bool isForwards)
+{
+    sortColumnId = newSortColumnId;
+    sortForwards = isForwards;
+    sortFilteredTracks();
+    tableComponent.updateContent();
+    tableComponent.repaint();
+}
+
 void PlaylistComponent::buttonClicked(juce::Button* button) 
 {
-    int id = std::stoi(button->getComponentID().toStdString());
-    // If id is less than 1000, it should be allocated to the left channel GUI player. 
-    if (id < 1000)
-    {
-        addToChannelList(interestedFiles[id], 0);
-    }
-    // If id is 1000 of more, it should be allocated to the right chanel GUI player
-    else
+    // Abandon the files still waiting to be scanned or analysed, analysis picks up again next launch
+    if (button == &cancelScanButton)
     {
-        addToChannelList(interestedFiles[id - 1000], 1);
+        scanner.cancel();
+        analyser.cancel();
     }
 }
 
@@ -151,91 +204,263 @@ bool PlaylistComponent::isInterestedInFileDrag(const juce::StringArray& files)
 void PlaylistComponent::filesDropped(const juce::StringArray& files, int x, int y)
 {
     // Perform if files have been dropped (mouse released with files) 
-    for (juce::String filename : files)
-    {
-        // For each file URL, get filepath and file name 
-        std::string filepath = juce::String(filename).toStdString();
-        std::size_t startFilePos = filepath.find_last_of("\\");
-        std::size_t startExtPos = filepath.find_last_of(".");
-        std::string extn = filepath.substr(startExtPos + 1, filepath.length() - startExtPos);
-        std::string file = filepath.substr(startFilePos + 1, filepath.length() - startFilePos - extn.size() - 2);
+    // Files are probed on worker threads, rows are added as the results come in
+    scanner.addFiles(files);
+    showScanProgress(true);
+    startTimer(100);
+}
+
+void PlaylistComponent::timerCallback()
+{
+    // Checked before collecting results so the last probes of a drop are not missed
+    bool scanFinished = ! scanner.isScanning();
+    bool analysisFinished = scanFinished && ! analyser.isAnalysing();
 
+    std::vector<ScannedTrack> scanned = scanner.takeResults();
+    juce::StringArray missing = scanner.takeMissingFiles();
+    if (! scanned.empty() || ! missing.isEmpty())
+    {
         // Update vectors for file details
-        inputFiles.push_back(filepath);
-        trackTitles.push_back(file);
+        for (const ScannedTrack& track : scanned)
+        {
+            addOrUpdateTrack(track);
+        }
+        removeTracks(missing);
+        // Newly probed files have not been analysed yet
+        analyser.addTracks(scanned);
+        analysisFinished = false;
+        // Keep the table consistent with whatever is typed in the search bar
+        updateFilteredTracks();
+    }
 
-        // Compute adudio length of the file and update vectors for file details 
-        getAudioLength(juce::URL{ juce::File{filepath} });
+    std::vector<TrackAnalyser::Result> analysed = analyser.takeResults();
+    if (! analysed.empty())
+    {
+        for (const TrackAnalyser::Result& result : analysed)
+        {
+            TrackId id = tracks.find(result.filepath);
+            if (tracks.isValid(id))
+            {
+                tracks.setAnalysis(id, result.analysis);
+                libraryChanged = true;
+            }
+        }
+        if (sortColumnId == 5 || sortColumnId == 6)
+        {
+            sortFilteredTracks();
+        }
+        tableComponent.repaint();
 
+        // An overnight batch should not lose its work to a crash
+        analysesSinceSave += (int) analysed.size();
+        if (analysesSinceSave >= 500)
+        {
+            saveLibrary();
+        }
     }
-    // Initialise interested titles as the full list. 
-    // This will be updated when text is entered in the search bar
-    interestedTitle = trackTitles;
-    interestedFiles = inputFiles;
 
-    // Update the music library table to include added files 
-    tableComponent.updateContent();
+    // Scanning comes first, then the tempo and key analysis of what was found
+    if (! scanFinished)
+    {
+        scanProgress = scanner.getProgress();
+        scanProgressBar.setTextToDisplay("Scanning");
+    }
+    else
+    {
+        scanProgress = analyser.getProgress();
+        scanProgressBar.setTextToDisplay("Analysing");
+    }
+
+    // Stop polling once every file has been probed and analysed and the results collected
+    if (analysisFinished)
+    {
+        showScanProgress(false);
+        stopTimer();
+        saveLibrary();
+    }
 }
 
 
 //==============================================================================
 void PlaylistComponent::textEditorTextChanged(juce::TextEditor& textEditor)
 {
-    // Whenever the search box is modified, clear the vectors that will be used for the table 
-    interestedTitle.clear();
-    interestedDuration.clear();
-    interestedFiles.clear();
+    updateFilteredTracks();
+}
+
+void PlaylistComponent::updateFilteredTracks()
+{
+    // Look up the tracks whose titles contain the text typed in the search box
+    filteredTracks = searchIndex.search(searchBar.getText());
+    sortFilteredTracks();
+    // Update the contents of the table
+    tableComponent.updateContent();
+}
 
-    // Start at position 0 of the original library list and increment until the last element of the list
-    int pos = 0;
-    for (std::string track : trackTitles)
+// Order the filtered tracks by the column picked in the table header
+void PlaylistComponent::sortFilteredTracks()
+{
+    if (sortColumnId == 1)
     {
-        // Check if the texts typed in the search box is a substring of the track title we are currently processing
-        if (track.find(searchBar.getText().toStdString()) != std::string::npos)
+        // Rank every title once so each search only compares integers
+        if (! titleRanksValid)
         {
-            // If there is a match, push the item to the vector used for displaying values in the table
-            interestedTitle.push_back(trackTitles[pos]);
-            interestedDuration.push_back(trackDurations[pos]);
-            interestedFiles.push_back(inputFiles[pos]);
+            std::vector<TrackId> byTitle(tracks.getNumIds());
+            std::iota(byTitle.begin(), byTitle.end(), 0);
+            std::sort(byTitle.begin(), byTitle.end(), [this](TrackId a, TrackId b)
+            {
+                return tracks.getTitle(a).compareNatural(tracks.getTitle(b)) < 0;
+            });
+            titleRanks.assign(byTitle.size(), 0);
+            for (size_t rank = 0; rank < byTitle.size(); ++rank)
+            {
+                titleRanks[byTitle[rank]] = (int) rank;
+            }
+            titleRanksValid = true;
         }
-        ++pos;
+        std::sort(filteredTracks.begin(), filteredTracks.end(), [this](TrackId a, TrackId b)
+        {
+            return sortForwards ? titleRanks[a] < titleRanks[b] : titleRanks[b] < titleRanks[a];
+        });
+    }
+    else if (sortColumnId == 2)
+    {
+        std::stable_sort(filteredTracks.begin(), filteredTracks.end(), [this](TrackId a, TrackId b)
+        {
+            return sortForwards ? tracks.getDuration(a) < tracks.getDuration(b)
+                                : tracks.getDuration(b) < tracks.getDuration(a);
+        });
+    }
+    else if (sortColumnId == 5)
+    {
+        // Tracks without a tempo sort as zero
+        std::stable_sort(filteredTracks.begin(), filteredTracks.end(), [this](TrackId a, TrackId b)
+        {
+            double bpmA = tracks.getAnalysis(a).beatGrid.bpm;
+            double bpmB = tracks.getAnalysis(b).beatGrid.bpm;
+            return sortForwards ? bpmA < bpmB : bpmB < bpmA;
+        });
+    }
+    else if (sortColumnId == 6)
+    {
+        // Round the Camelot wheel, so keys that mix well sit together, tracks without a key first
+        std::stable_sort(filteredTracks.begin(), filteredTracks.end(), [this](TrackId a, TrackId b)
+        {
+            int wheelA = KeyDetector::getWheelPosition(tracks.getAnalysis(a).key);
+            int wheelB = KeyDetector::getWheelPosition(tracks.getAnalysis(b).key);
+            return sortForwards ? wheelA < wheelB : wheelB < wheelA;
+        });
     }
-    // Update the contents of the table after looping
-    tableComponent.updateContent();
 }
 
 //==============================================================================
 // Add music file to list of the respective Left/Right channel's playlist
-void PlaylistComponent::addToChannelList(std::string filepath, int channel)
+void PlaylistComponent::addToChannelList(TrackId id, int channel)
 {
     if (channel == 0) //left
     {
-        playListL.push_back(filepath);
+        playListL.push_back(id);
     }
     if (channel == 1) //right
     {
-        playListR.push_back(filepath);
+        playListR.push_back(id);
+    }
+    // Let the decks preload the head of their queue
+    sendChangeMessage();
+}
+
+const TrackTable& PlaylistComponent::getTrackTable() const
+{
+    return tracks;
+}
+
+void PlaylistComponent::setHotCues(TrackId id, const HotCues& hotCues)
+{
+    if (tracks.isValid(id))
+    {
+        tracks.setHotCues(id, hotCues);
+        libraryChanged = true;
+    }
+}
+
+// Load the library index saved by the previous session
+void PlaylistComponent::loadLibrary()
+{
+    std::vector<ScannedTrack> tracks = libraryIndex.load();
+    for (const ScannedTrack& track : tracks)
+    {
+        addOrUpdateTrack(track);
+    }
+    // Nothing has changed yet, the tracks came straight from the index
+    libraryChanged = false;
+    updateFilteredTracks();
+
+    // Only files whose size or modification time changed get probed again,
+    // and only tracks a previous session did not finish analysing are analysed
+    if (! tracks.empty())
+    {
+        analyser.addTracks(tracks);
+        scanner.rescan(std::move(tracks));
+        showScanProgress(true);
+        startTimer(100);
     }
 }
 
-// Get audio length metadata
-void PlaylistComponent::getAudioLength(juce::URL audioURL)
+// Write the library index if anything changed since it was loaded or last saved
+void PlaylistComponent::saveLibrary()
 {
-    double trackLen = 0.0;
+    if (! libraryChanged)
+    {
+        return;
+    }
 
-    auto* reader = formatManager.createReaderFor(audioURL.createInputStream(false));
+    if (libraryIndex.save(tracks.getTracks()))
+    {
+        libraryChanged = false;
+        analysesSinceSave = 0;
+    }
+    else
+    {
+        DBG("PlaylistComponent::saveLibrary - could not write the library index");
+    }
+}
 
-    if (reader != nullptr) // good file!
+// Add a probed file to the library, replacing its details if it is already there
+void PlaylistComponent::addOrUpdateTrack(const ScannedTrack& track)
+{
+    int numIds = tracks.getNumIds();
+    TrackId id = tracks.addOrUpdate(track);
+
+    // The search index uses track ids as its rows
+    if (id >= numIds)
+    {
+        searchIndex.addTitle(track.title);
+    }
+    else
+    {
+        searchIndex.setTitle(id, track.title);
+    }
+    titleRanksValid = false;
+    libraryChanged = true;
+}
+
+// Remove files that no longer exist from the library
+void PlaylistComponent::removeTracks(const juce::StringArray& filepaths)
+{
+    for (const juce::String& filepath : filepaths)
     {
-        std::unique_ptr<juce::AudioFormatReaderSource> newSource(new juce::AudioFormatReaderSource(reader,
-            true));
-        transportSource.setSource(newSource.get(), 0, nullptr, reader->sampleRate);
-        readerSource.reset(newSource.release());
-        double trackLen = transportSource.getLengthInSeconds(); // get length of audio
-        trackDurations.push_back(trackLen); // add audio length to vector
+        TrackId id = tracks.find(filepath);
+        if (tracks.isValid(id))
+        {
+            tracks.remove(id);
+            searchIndex.removeTitle(id);
+            libraryChanged = true;
+        }
     }
+}
 
-    //Initialise interested durations as the full list. 
-    //This will be updated when text is entered in the search bar
-    interestedDuration = trackDurations;
+// Show or hide the scan progress bar and cancel button
+void PlaylistComponent::showScanProgress(bool visible)
+{
+    scanProgressBar.setVisible(visible);
+    cancelScanButton.setVisible(visible);
 }
\ No newline at end of file
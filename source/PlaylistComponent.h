@@ -3,16 +3,23 @@
 #include <JuceHeader.h>
 #include <vector>
 #include <string>
+#include "LibraryScanner.h"
+#include "TrackAnalyser.h"
+#include "LibraryIndex.h"
+#include "TrackSearchIndex.h"
+#include "TrackTable.h"
 
 //==============================================================================
 class PlaylistComponent : public juce::Component, 
                           public juce::TableListBoxModel, 
                           public juce::Button::Listener, 
                           public juce:: FileDragAndDropTarget,
-                          public juce:: TextEditor::Listener
+                          public juce:: TextEditor::Listener,
+                          public juce::Timer,
+                          public juce::ChangeBroadcaster
 {
     public:
-        PlaylistComponent(juce::AudioFormatManager& formatManager);
+        PlaylistComponent(juce::AudioFormatManager& formatManager, SeekIndexStore& seekIndexStore);
         ~PlaylistComponent() override;
 
         void paint (juce::Graphics&) override;
@@ -32,49 +39,83 @@ class PlaylistComponent : public juce::Component,
                        int height,
                        bool rowIsSelected) override;
 
-        Component* refreshComponentForCell(int rowNumber,
-                                           int columnId,
-                                           bool isRowSelected,
-                                           Component* existingComponentToUpdate) override;
+        void cellClicked(int rowNumber, int columnId, const juce::MouseEvent&) override;
 
         void prepareToPlay(int samplesPerBlockExpected, double sampleRate);
         void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill);
         void releaseResources();
 
+        void sortOrderChanged(int newSortColumnId, bool isForwards) override;
+
         void buttonClicked(juce::Button* button) override;
 
         bool isInterestedInFileDrag(const juce::StringArray& files) override;
         void filesDropped(const juce::StringArray& files, int x, int y) override;
         void textEditorTextChanged(juce::TextEditor&) override;
 
-        std::vector<std::string> playListL;
-        std::vector<std::string> playListR;
+        // Collects probes finished by the library scanner and analyses finished by the analyser
+        void timerCallback() override;
+
+        // Library tracks, the deck queues refer to them by id
+        const TrackTable& getTrackTable() const;
+
+        // Store the hot cues a deck has set on a library track, written with the library on exit
+        void setHotCues(TrackId id, const HotCues& hotCues);
+
+        std::vector<TrackId> playListL;
+        std::vector<TrackId> playListR;
 
     private:
 
         juce::AudioFormatManager& formatManager;
-        std::unique_ptr<juce::AudioFormatReaderSource> readerSource;
-        juce::AudioTransportSource transportSource;
+        // MP3 seek indexes of the library tracks, kept on disk
+        SeekIndexStore& seekIndexStore;
+
+        // Probes dropped files on worker threads
+        LibraryScanner scanner{ formatManager, seekIndexStore };
+        // Finds the tempo and key of every track once it has been probed
+        TrackAnalyser analyser{ formatManager, seekIndexStore };
+        // Analyses collected since the library was last saved, so a long batch is saved as it goes
+        int analysesSinceSave = 0;
+        // Keeps the library on disk between launches
+        LibraryIndex libraryIndex{ LibraryIndex::getDefaultFile() };
+        bool libraryChanged = false;
 
         // Playlist displayed as a table list
         juce::TableListBox tableComponent;
 
-        // Vectors to store music file metadata
-        std::vector<std::string> inputFiles;
-        std::vector<std::string> interestedFiles;
-        std::vector<std::string> trackTitles;
-        std::vector<std::string> interestedTitle;
-        std::vector<int> trackDurations;
-        std::vector<int> interestedDuration;
+        // Every track in the library, stored column by column
+        TrackTable tracks;
+
+        // Index of the track titles by TrackId and the tracks matching the search bar
+        TrackSearchIndex searchIndex;
+        std::vector<TrackId> filteredTracks;
+
+        // Column the table is sorted by (0 = library order) and the title order of every track
+        int sortColumnId = 0;
+        bool sortForwards = true;
+        std::vector<int> titleRanks;
+        bool titleRanksValid = false;
 
         // Search bar and label to allow for searching functionality 
         juce::TextEditor searchBar;
         juce::Label searchLabel;
 
+        // Progress of the current drop and a button to abandon it
+        double scanProgress = 0.0;
+        juce::ProgressBar scanProgressBar{ scanProgress };
+        juce::TextButton cancelScanButton{ "Cancel" };
+
         //==============================================================================
         // User defined variables to process data
-        void addToChannelList(std::string filepath, int channel);
-        void getAudioLength(juce::URL audioURL);
+        void addToChannelList(TrackId id, int channel);
+        void updateFilteredTracks();
+        void sortFilteredTracks();
+        void loadLibrary();
+        void saveLibrary();
+        void addOrUpdateTrack(const ScannedTrack& track);
+        void removeTracks(const juce::StringArray& filepaths);
+        void showScanProgress(bool visible);
 
         JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PlaylistComponent)
 };
@@ -0,0 +1,306 @@
+#include "PolyphaseResampler.h"
+#include <cstring>
+
+namespace
+{
+	// Modified Bessel function of the first kind, order zero, for the Kaiser window
+	double besselI0(double x)
+	{
+		double sum = 1.0, term = 1.0;
+		for (int k = 1; k < 50; ++k)
+		{
+			term *= (x / (2.0 * k)) * (x / (2.0 * k));
+			sum += term;
+			if (term < sum * 1.0e-12)
+			{
+				break;
+			}
+		}
+		return sum;
+	}
+
+	// Dot product with four running sums, which compilers turn into SIMD without reordering
+	// the floating point additions. numTaps is always a multiple of four.
+	float dotProduct(const float* samples, const float* taps, int numTaps)
+	{
+		float sums[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < numTaps; i += 4)
+		{
+			sums[0] += samples[i] * taps[i];
+			sums[1] += samples[i + 1] * taps[i + 1];
+			sums[2] += samples[i + 2] * taps[i + 2];
+			sums[3] += samples[i + 3] * taps[i + 3];
+		}
+		return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+	}
+}
+
+//==============================================================================
+PolyphaseResampler::PolyphaseResampler(juce::AudioSource* _input, int _numChannels)
+	: input(_input),
+	  numChannels(_numChannels)
+{
+	jassert(input != nullptr);
+
+	kernels[0] = makeKernel(4, 256, 256, 5.0, 0.85);
+	kernels[1] = makeKernel(16, 512, 512, 8.0, 0.92);
+	kernels[2] = makeKernel(32, 2048, 512, 10.0, 0.96);
+
+	// Widest filter, at the lowest cutoff, decides how much input is kept behind the read position
+	for (const Kernel& kernel : kernels)
+	{
+		int halfWidth = (int) std::ceil(kernel.halfTaps * maxAntiAliasRatio / kernel.rolloff);
+		maxHalfWidth = juce::jmax(maxHalfWidth, halfWidth);
+	}
+}
+
+PolyphaseResampler::~PolyphaseResampler()
+{
+}
+
+PolyphaseResampler::Kernel PolyphaseResampler::makeKernel(int halfTaps, int phases, int bankPhases, double beta, double rolloff)
+{
+	jassert(bankPhases <= maxBankPhases);
+
+	Kernel kernel;
+	kernel.halfTaps = halfTaps;
+	kernel.phases = phases;
+	kernel.bankPhases = bankPhases;
+	kernel.rolloff = rolloff;
+
+	// One extra zero at the end so lookups can always interpolate to the next entry
+	int size = halfTaps * phases;
+	kernel.table.resize((size_t) size + 2, 0.0f);
+	double window = besselI0(beta);
+	for (int i = 0; i <= size; ++i)
+	{
+		double x = (double) i / phases;
+		double sinc = i == 0 ? 1.0 : std::sin(juce::MathConstants<double>::pi * x) / (juce::MathConstants<double>::pi * x);
+		double u = x / halfTaps;
+		double kaiser = besselI0(beta * std::sqrt(juce::jmax(0.0, 1.0 - u * u))) / window;
+		kernel.table[(size_t) i] = (float) (sinc * kaiser);
+	}
+	return kernel;
+}
+
+const PolyphaseResampler::Kernel& PolyphaseResampler::getKernel(Quality tier) const
+{
+	return kernels[juce::jlimit(0, 2, (int) tier - 1)];
+}
+
+//==============================================================================
+void PolyphaseResampler::setResamplingRatio(double samplesInPerOutputSample)
+{
+	jassert(samplesInPerOutputSample > 0);
+	ratio = juce::jmax(0.001, samplesInPerOutputSample);
+}
+
+double PolyphaseResampler::getResamplingRatio() const
+{
+	return ratio;
+}
+
+void PolyphaseResampler::setQuality(Quality newQuality)
+{
+	quality = (int) newQuality;
+}
+
+PolyphaseResampler::Quality PolyphaseResampler::getQuality() const
+{
+	return (Quality) quality.load();
+}
+
+//==============================================================================
+void PolyphaseResampler::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+	// The input is pulled at the device rate in blocks no larger than the device's
+	blockSize = juce::jmax(1, samplesPerBlockExpected);
+	input->prepareToPlay(blockSize, sampleRate);
+
+	// Room for four blocks of input plus the filter on both sides, faster speeds are done in sections
+	maxInputPerSection = blockSize * 4;
+	history.setSize(numChannels, maxInputPerSection + maxHalfWidth * 2 + 8);
+	history.clear();
+	int maxTaps = maxHalfWidth * 2 + 8;
+	bank.allocate((size_t) ((maxBankPhases + 1) * maxTaps), true);
+	bankSteps.allocate((size_t) (maxBankPhases * maxTaps), true);
+	coefficients.allocate((size_t) maxTaps, true);
+	bankKernel = nullptr;
+	coefficientsFraction = -1.0;
+
+	// Start with silence behind the first input sample
+	historyLength = maxHalfWidth;
+	position = maxHalfWidth;
+}
+
+void PolyphaseResampler::releaseResources()
+{
+	input->releaseResources();
+	history.setSize(0, 0);
+	bank.free();
+	bankSteps.free();
+	coefficients.free();
+	bankKernel = nullptr;
+	historyLength = 0;
+}
+
+void PolyphaseResampler::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+	if (history.getNumSamples() == 0)
+	{
+		bufferToFill.clearActiveBufferRegion();
+		return;
+	}
+
+	double currentRatio = ratio;
+	const Kernel& kernel = getKernel((Quality) quality.load());
+
+	// Split the block so the input each section needs fits in the history buffer
+	int maxOutput = juce::jmax(1, (int) (maxInputPerSection / currentRatio));
+	for (int done = 0; done < bufferToFill.numSamples;)
+	{
+		int numSamples = juce::jmin(maxOutput, bufferToFill.numSamples - done);
+		juce::AudioSourceChannelInfo section(bufferToFill.buffer, bufferToFill.startSample + done, numSamples);
+		resampleSection(section, currentRatio, kernel);
+		done += numSamples;
+	}
+}
+
+void PolyphaseResampler::resampleSection(const juce::AudioSourceChannelInfo& section, double currentRatio, const Kernel& kernel)
+{
+	// Narrow the filter to the output Nyquist when reading faster than 1x. The ratio is
+	// rounded up to a step, so the bank is only rebuilt when a speed change crosses one.
+	double steppedRatio = std::ceil(juce::jlimit(1.0, maxAntiAliasRatio, currentRatio) * 64.0) / 64.0;
+	double cutoff = kernel.rolloff / steppedRatio;
+	int halfWidth = (int) std::ceil(kernel.halfTaps / cutoff);
+	int numTaps = (halfWidth * 2 + 3) & ~3;
+	if (cutoff != bankCutoff || &kernel != bankKernel)
+	{
+		buildBank(kernel, cutoff, halfWidth, numTaps);
+	}
+
+	// Every tap of the last output sample has to be in the buffer, the rounding up included
+	int lastBase = (int) (position + (section.numSamples - 1) * currentRatio);
+	fillHistory(lastBase + numTaps - halfWidth + 2);
+
+	int outputChannels = juce::jmin(numChannels, section.buffer->getNumChannels());
+	for (int channel = outputChannels; channel < section.buffer->getNumChannels(); ++channel)
+	{
+		section.buffer->clear(channel, section.startSample, section.numSamples);
+	}
+
+	for (int i = 0; i < section.numSamples; ++i)
+	{
+		int base = (int) position;
+		double fraction = position - base;
+
+		// Straight copy when the output lands exactly on an input sample at 1x
+		if (fraction == 0.0 && currentRatio == 1.0)
+		{
+			for (int channel = 0; channel < outputChannels; ++channel)
+			{
+				section.buffer->setSample(channel, section.startSample + i, history.getSample(channel, base));
+			}
+		}
+		else
+		{
+			if (fraction != coefficientsFraction)
+			{
+				interpolateCoefficients(fraction);
+			}
+			int start = base - halfWidth + 1;
+			for (int channel = 0; channel < outputChannels; ++channel)
+			{
+				float value = dotProduct(history.getReadPointer(channel, start), coefficients, numTaps);
+				section.buffer->setSample(channel, section.startSample + i, value);
+			}
+		}
+		position += currentRatio;
+	}
+
+	discardHistory();
+}
+
+void PolyphaseResampler::fillHistory(int length)
+{
+	jassert(length <= history.getNumSamples());
+	length = juce::jmin(length, history.getNumSamples());
+
+	// Pull in device sized blocks, which is what the input was prepared for
+	while (historyLength < length)
+	{
+		int numSamples = juce::jmin(blockSize, length - historyLength);
+		juce::AudioSourceChannelInfo info(&history, historyLength, numSamples);
+		input->getNextAudioBlock(info);
+		historyLength += numSamples;
+	}
+}
+
+void PolyphaseResampler::discardHistory()
+{
+	// Keep enough input behind the read position for the widest filter
+	int discard = (int) position - maxHalfWidth;
+	if (discard <= 0)
+	{
+		return;
+	}
+	discard = juce::jmin(discard, historyLength);
+	for (int channel = 0; channel < numChannels; ++channel)
+	{
+		float* samples = history.getWritePointer(channel);
+		std::memmove(samples, samples + discard, sizeof(float) * (size_t) (historyLength - discard));
+	}
+	historyLength -= discard;
+	position -= discard;
+}
+
+void PolyphaseResampler::buildBank(const Kernel& kernel, double cutoff, int halfWidth, int numTaps)
+{
+	int phases = kernel.bankPhases;
+	for (int phase = 0; phase <= phases; ++phase)
+	{
+		computeTaps(kernel, (double) phase / phases, cutoff, halfWidth, numTaps, bank + phase * numTaps);
+	}
+	for (int phase = 0; phase < phases; ++phase)
+	{
+		juce::FloatVectorOperations::subtract(bankSteps + phase * numTaps, bank + (phase + 1) * numTaps,
+											  bank + phase * numTaps, numTaps);
+	}
+
+	bankTaps = numTaps;
+	bankCutoff = cutoff;
+	bankKernel = &kernel;
+	coefficientsFraction = -1.0;
+}
+
+void PolyphaseResampler::computeTaps(const Kernel& kernel, double fraction, double cutoff, int halfWidth, int numTaps, float* taps)
+{
+	const float* table = kernel.table.data();
+	double limit = kernel.halfTaps;
+
+	for (int i = 0; i < numTaps; ++i)
+	{
+		// Distance from the output position to this input sample, scaled to the filter's width
+		double x = std::abs((i - halfWidth + 1) - fraction) * cutoff;
+		if (x >= limit)
+		{
+			taps[i] = 0.0f;
+			continue;
+		}
+		double index = x * kernel.phases;
+		int lower = (int) index;
+		float weight = (float) (index - lower);
+		taps[i] = (float) cutoff * (table[lower] + weight * (table[lower + 1] - table[lower]));
+	}
+}
+
+void PolyphaseResampler::interpolateCoefficients(double fraction)
+{
+	// The two positions of the bank either side of the fraction, blended
+	double index = fraction * bankKernel->bankPhases;
+	int lower = juce::jmin((int) index, bankKernel->bankPhases - 1);
+	float weight = (float) (index - lower);
+	juce::FloatVectorOperations::copy(coefficients, bank + lower * bankTaps, bankTaps);
+	juce::FloatVectorOperations::addWithMultiply(coefficients, bankSteps + lower * bankTaps, weight, bankTaps);
+	coefficientsFraction = fraction;
+}
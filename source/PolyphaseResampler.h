@@ -0,0 +1,103 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <vector>
+
+// Changes the playback speed of its input with a windowed-sinc filter, so
+// speed changes stay clean where linear interpolation aliases. The filter
+// narrows when playing faster than 1x to keep content above the output
+// Nyquist from folding back; its cutoff moves in steps of 1/64 of the ratio.
+// For the current tier and cutoff the filter is laid out as a bank of taps
+// at evenly spaced fractional positions, and each output sample interpolates
+// between the two positions either side of it with vector operations. Three
+// quality tiers trade filter length for CPU; all buffers are allocated up
+// front, so the tier and ratio can change while playing without allocating
+// on the audio thread.
+class PolyphaseResampler : public juce::AudioSource
+{
+public:
+    enum class Quality
+    {
+        // 8 taps, for previews and slow machines
+        draft = 1,
+        // 32 taps, for live playback
+        standard,
+        // 64 taps, for offline rendering
+        mastering
+    };
+
+    PolyphaseResampler(juce::AudioSource* _input, int _numChannels = 2);
+    ~PolyphaseResampler() override;
+
+    // Input samples consumed per output sample, above 1 plays faster and higher
+    void setResamplingRatio(double samplesInPerOutputSample);
+    double getResamplingRatio() const;
+
+    void setQuality(Quality newQuality);
+    Quality getQuality() const;
+
+    //==============================================================================
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+    // Above this ratio the filter stops narrowing, so very fast playback may alias
+    static constexpr double maxAntiAliasRatio = 4.0;
+
+private:
+    // Right half of the prototype low-pass filter, sampled at `phases` points per input sample
+    struct Kernel
+    {
+        int halfTaps = 0;
+        int phases = 0;
+        // Fractional positions in the bank of taps built from this kernel
+        int bankPhases = 0;
+        double rolloff = 1.0;
+        std::vector<float> table;
+    };
+
+    static Kernel makeKernel(int halfTaps, int phases, int bankPhases, double beta, double rolloff);
+    const Kernel& getKernel(Quality tier) const;
+
+    void resampleSection(const juce::AudioSourceChannelInfo& section, double ratio, const Kernel& kernel);
+    void fillHistory(int length);
+    void discardHistory();
+    void buildBank(const Kernel& kernel, double cutoff, int halfWidth, int numTaps);
+    // Taps of the filter for one fractional position, read from the kernel's table
+    static void computeTaps(const Kernel& kernel, double fraction, double cutoff, int halfWidth, int numTaps, float* taps);
+    void interpolateCoefficients(double fraction);
+
+    // Most positions in any kernel's bank
+    static constexpr int maxBankPhases = 512;
+
+    juce::AudioSource* input;
+    int numChannels;
+    Kernel kernels[3];
+    int maxHalfWidth = 0;
+
+    std::atomic<double> ratio{ 1.0 };
+    std::atomic<int> quality{ (int) Quality::standard };
+
+    // Audio thread only. Input is kept in a linear buffer with enough samples
+    // behind the read position for the widest filter.
+    juce::AudioBuffer<float> history;
+    int historyLength = 0;
+    double position = 0.0;
+    int blockSize = 0;
+    int maxInputPerSection = 0;
+
+    // Taps at bankPhases + 1 fractional positions from 0 to 1 for the current tier
+    // and cutoff, and the step from each to the next. Rebuilt when either changes.
+    juce::HeapBlock<float> bank;
+    juce::HeapBlock<float> bankSteps;
+    int bankTaps = 0;
+    double bankCutoff = -1.0;
+    const Kernel* bankKernel = nullptr;
+
+    // Filter taps for the current fractional position, reused while it does not change
+    juce::HeapBlock<float> coefficients;
+    double coefficientsFraction = -1.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PolyphaseResampler)
+};
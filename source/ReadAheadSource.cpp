@@ -0,0 +1,149 @@
+#include "ReadAheadSource.h"
+
+ReadAheadSource::ReadAheadSource(juce::PositionableAudioSource* _source,
+								 juce::TimeSliceThread& backgroundThread,
+								 int bufferSizeSamples,
+								 std::atomic<int>& _underrunCounter)
+	: tracker(_source, bufferSizeSamples),
+	  buffer(&tracker, backgroundThread, false, bufferSizeSamples, 2),
+	  underrunCounter(_underrunCounter)
+{
+}
+
+ReadAheadSource::~ReadAheadSource()
+{
+}
+
+//==============================================================================
+void ReadAheadSource::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+	buffer.prepareToPlay(samplesPerBlockExpected, sampleRate);
+}
+
+void ReadAheadSource::releaseResources()
+{
+	buffer.releaseResources();
+}
+
+void ReadAheadSource::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+	// The buffer plays silence for anything the background thread has not reached yet.
+	// Looped playback wraps inside the decoder, so only straight playback is checked.
+	if (! isLooping())
+	{
+		juce::int64 start = buffer.getNextReadPosition();
+		juce::int64 end = juce::jmin(start + bufferToFill.numSamples, getTotalLength());
+		if (start < end && ! tracker.hasDecoded(start, end))
+		{
+			++underrunCounter;
+		}
+	}
+
+	buffer.getNextAudioBlock(bufferToFill);
+}
+
+void ReadAheadSource::setNextReadPosition(juce::int64 newPosition)
+{
+	// Whatever the buffer held may be thrown away, so count from the new position only
+	tracker.resetTo(newPosition);
+	buffer.setNextReadPosition(newPosition);
+}
+
+juce::int64 ReadAheadSource::getNextReadPosition() const
+{
+	return buffer.getNextReadPosition();
+}
+
+juce::int64 ReadAheadSource::getTotalLength() const
+{
+	return buffer.getTotalLength();
+}
+
+bool ReadAheadSource::isLooping() const
+{
+	return buffer.isLooping();
+}
+
+void ReadAheadSource::setLooping(bool shouldLoop)
+{
+	tracker.setLooping(shouldLoop);
+}
+
+//==============================================================================
+ReadAheadSource::DecodeTracker::DecodeTracker(juce::PositionableAudioSource* _source, int _bufferSizeSamples)
+	: source(_source),
+	  bufferSizeSamples(_bufferSizeSamples)
+{
+}
+
+void ReadAheadSource::DecodeTracker::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+	source->prepareToPlay(samplesPerBlockExpected, sampleRate);
+}
+
+void ReadAheadSource::DecodeTracker::releaseResources()
+{
+	source->releaseResources();
+}
+
+void ReadAheadSource::DecodeTracker::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+	juce::int64 start = source->getNextReadPosition();
+	source->getNextAudioBlock(bufferToFill);
+	juce::int64 end = start + bufferToFill.numSamples;
+
+	// Extend the decoded range when reading on from it, otherwise the buffer has jumped elsewhere
+	if (start >= decodedStart && start <= decodedEnd)
+	{
+		// The buffer only holds its size, older audio has been overwritten.
+		// Move the start up before the end so the range never claims too much.
+		end = juce::jmax(decodedEnd.load(), end);
+		decodedStart = juce::jmax(decodedStart.load(), end - bufferSizeSamples);
+		decodedEnd = end;
+	}
+	else
+	{
+		// Empty the range first so the audio thread never sees the old end with the new start
+		decodedEnd = -1;
+		decodedStart = start;
+		decodedEnd = end;
+	}
+}
+
+void ReadAheadSource::DecodeTracker::setNextReadPosition(juce::int64 newPosition)
+{
+	source->setNextReadPosition(newPosition);
+}
+
+juce::int64 ReadAheadSource::DecodeTracker::getNextReadPosition() const
+{
+	return source->getNextReadPosition();
+}
+
+juce::int64 ReadAheadSource::DecodeTracker::getTotalLength() const
+{
+	return source->getTotalLength();
+}
+
+bool ReadAheadSource::DecodeTracker::isLooping() const
+{
+	return source->isLooping();
+}
+
+void ReadAheadSource::DecodeTracker::setLooping(bool shouldLoop)
+{
+	source->setLooping(shouldLoop);
+}
+
+bool ReadAheadSource::DecodeTracker::hasDecoded(juce::int64 start, juce::int64 end) const
+{
+	return start >= decodedStart && end <= decodedEnd;
+}
+
+void ReadAheadSource::DecodeTracker::resetTo(juce::int64 position)
+{
+	// Empty the range before moving it, as when the buffer jumps
+	decodedEnd = -1;
+	decodedStart = position;
+	decodedEnd = position;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+
+// Decodes a track ahead of the playhead on a shared background thread, so the
+// audio callback only copies from memory. Blocks that ask for audio the
+// background thread has not decoded yet are counted as underruns.
+class ReadAheadSource : public juce::PositionableAudioSource
+{
+public:
+    ReadAheadSource(juce::PositionableAudioSource* _source,
+                    juce::TimeSliceThread& backgroundThread,
+                    int bufferSizeSamples,
+                    std::atomic<int>& _underrunCounter);
+    ~ReadAheadSource() override;
+
+    //==============================================================================
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+    void setNextReadPosition(juce::int64 newPosition) override;
+    juce::int64 getNextReadPosition() const override;
+    juce::int64 getTotalLength() const override;
+    bool isLooping() const override;
+    void setLooping(bool shouldLoop) override;
+
+private:
+    // Sits between the buffer and the decoder and remembers the range the buffer
+    // still holds: what was decoded since the last jump, at most a buffer long
+    class DecodeTracker : public juce::PositionableAudioSource
+    {
+    public:
+        DecodeTracker(juce::PositionableAudioSource* _source, int _bufferSizeSamples);
+
+        void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+        void releaseResources() override;
+        void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+        void setNextReadPosition(juce::int64 newPosition) override;
+        juce::int64 getNextReadPosition() const override;
+        juce::int64 getTotalLength() const override;
+        bool isLooping() const override;
+        void setLooping(bool shouldLoop) override;
+
+        // True if every sample in the range has been decoded
+        bool hasDecoded(juce::int64 start, juce::int64 end) const;
+        // Forget the decoded range, the buffer starts again from the position
+        void resetTo(juce::int64 position);
+
+    private:
+        juce::PositionableAudioSource* source;
+        juce::int64 bufferSizeSamples;
+        std::atomic<juce::int64> decodedStart{ 0 };
+        std::atomic<juce::int64> decodedEnd{ 0 };
+    };
+
+    DecodeTracker tracker;
+    juce::BufferingAudioSource buffer;
+    std::atomic<int>& underrunCounter;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ReadAheadSource)
+};
@@ -0,0 +1,156 @@
+#include "ScrollingWaveform.h"
+
+ScrollingWaveform::ScrollingWaveform()
+{
+	// Every pixel is covered by a tile, nothing behind needs painting
+	setOpaque(true);
+}
+
+ScrollingWaveform::~ScrollingWaveform()
+{
+}
+
+void ScrollingWaveform::paint(juce::Graphics& g)
+{
+	juce::int64 startTicks = juce::Time::getHighResolutionTicks();
+
+	if (waveform == nullptr)
+	{
+		g.fillAll(getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId));
+	}
+	else
+	{
+		// Only the tiles under the area being repainted
+		juce::Rectangle<int> clip = g.getClipBounds();
+		int first = (int) std::floor((scrollPixel + clip.getX()) / (double) tileWidth);
+		int last = (int) std::floor((scrollPixel + clip.getRight() - 1) / (double) tileWidth);
+		for (int index = first; index <= last; ++index)
+		{
+			g.drawImageAt(getTile(index), index * tileWidth - scrollPixel, 0);
+		}
+	}
+
+	// Playhead
+	g.setColour(juce::Colours::floralwhite);
+	g.fillRect(getWidth() / 2 - 1, 0, 2, getHeight());
+	g.setColour(juce::Colours::grey);
+	g.drawRect(getLocalBounds(), 1);
+
+	double paintMs = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks) * 1000.0;
+	averagePaintMs += (paintMs - averagePaintMs) * 0.1;
+}
+
+void ScrollingWaveform::resized()
+{
+	// Tiles are as tall as the view and drawn at its zoom, which depends on the width
+	clearTiles();
+	scrollPixel = getScrollPixel();
+}
+
+void ScrollingWaveform::mouseWheelMove(const juce::MouseEvent& event, const juce::MouseWheelDetails& wheel)
+{
+	if (wheel.deltaY == 0.0f)
+	{
+		return;
+	}
+
+	// Wheel up zooms in
+	double zoomed = visibleSeconds * (wheel.deltaY > 0 ? 0.8 : 1.25);
+	zoomed = juce::jlimit(minVisibleSeconds, maxVisibleSeconds, zoomed);
+	if (zoomed != visibleSeconds)
+	{
+		visibleSeconds = zoomed;
+		clearTiles();
+		scrollPixel = getScrollPixel();
+		repaint();
+	}
+}
+
+void ScrollingWaveform::setWaveform(std::shared_ptr<const WaveformPyramid> newWaveform)
+{
+	if (newWaveform != waveform)
+	{
+		waveform = std::move(newWaveform);
+		clearTiles();
+		scrollPixel = getScrollPixel();
+		repaint();
+	}
+}
+
+void ScrollingWaveform::setPositionRelative(double pos)
+{
+	positionSeconds = waveform != nullptr ? pos * waveform->getLengthInSeconds() : 0.0;
+
+	int newScrollPixel = getScrollPixel();
+	if (newScrollPixel != scrollPixel)
+	{
+		scrollPixel = newScrollPixel;
+		repaint();
+	}
+}
+
+double ScrollingWaveform::getAveragePaintMs() const
+{
+	return averagePaintMs;
+}
+
+const juce::Image& ScrollingWaveform::getTile(int index)
+{
+	for (Tile& tile : tiles)
+	{
+		if (tile.index == index)
+		{
+			tile.lastUsed = ++tileCounter;
+			return tile.image;
+		}
+	}
+
+	// Enough tiles for the view twice over, so scrubbing back and forth stays cached
+	size_t maxTiles = (size_t) (getWidth() / tileWidth + 2) * 2;
+	Tile* tile = nullptr;
+	if (tiles.size() < maxTiles)
+	{
+		tiles.emplace_back();
+		tile = &tiles.back();
+	}
+	else
+	{
+		tile = &tiles.front();
+		for (Tile& candidate : tiles)
+		{
+			if (candidate.lastUsed < tile->lastUsed)
+			{
+				tile = &candidate;
+			}
+		}
+	}
+
+	tile->index = index;
+	tile->lastUsed = ++tileCounter;
+	if (! tile->image.isValid() || tile->image.getHeight() != getHeight())
+	{
+		tile->image = juce::Image(juce::Image::RGB, tileWidth, juce::jmax(1, getHeight()), false);
+	}
+
+	juce::Graphics g(tile->image);
+	g.fillAll(getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId));
+	double secondsPerPixel = 1.0 / getPixelsPerSecond();
+	waveform->draw(g, tile->image.getBounds(), index * tileWidth * secondsPerPixel, (index + 1) * tileWidth * secondsPerPixel,
+		juce::Colours::rosybrown, juce::Colours::rosybrown.brighter(0.4f));
+	return tile->image;
+}
+
+void ScrollingWaveform::clearTiles()
+{
+	tiles.clear();
+}
+
+double ScrollingWaveform::getPixelsPerSecond() const
+{
+	return juce::jmax(1, getWidth()) / visibleSeconds;
+}
+
+int ScrollingWaveform::getScrollPixel() const
+{
+	return juce::roundToInt(positionSeconds * getPixelsPerSecond()) - getWidth() / 2;
+}
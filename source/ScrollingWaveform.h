@@ -0,0 +1,61 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory>
+#include <vector>
+#include "WaveformPyramid.h"
+
+// Zoomed view of the waveform that scrolls under a playhead fixed in the
+// middle. The waveform is rendered once into fixed width image tiles and
+// each frame only blits the tiles in view, so following the playhead costs
+// a few image copies rather than redrawing the waveform. Scroll the mouse
+// wheel to zoom.
+class ScrollingWaveform : public juce::Component
+{
+public:
+    ScrollingWaveform();
+    ~ScrollingWaveform() override;
+
+    void paint(juce::Graphics&) override;
+    void resized() override;
+    void mouseWheelMove(const juce::MouseEvent& event, const juce::MouseWheelDetails& wheel) override;
+
+    void setWaveform(std::shared_ptr<const WaveformPyramid> newWaveform);
+    // Only repaints when the view has moved by at least a pixel
+    void setPositionRelative(double pos);
+
+    // Smoothed time taken by paint, in milliseconds
+    double getAveragePaintMs() const;
+
+    static constexpr double defaultVisibleSeconds = 8.0;
+    static constexpr double minVisibleSeconds = 2.0;
+    static constexpr double maxVisibleSeconds = 32.0;
+    static constexpr int tileWidth = 256;
+
+private:
+    struct Tile
+    {
+        int index = 0;
+        juce::Image image;
+        juce::uint32 lastUsed = 0;
+    };
+
+    const juce::Image& getTile(int index);
+    void clearTiles();
+    double getPixelsPerSecond() const;
+    int getScrollPixel() const;
+
+    std::shared_ptr<const WaveformPyramid> waveform;
+    double positionSeconds = 0.0;
+    double visibleSeconds = defaultVisibleSeconds;
+    // Left edge of the view, in pixels from the start of the track
+    int scrollPixel = 0;
+
+    // Tiles rendered at the current zoom and height, least recently drawn dropped first
+    std::vector<Tile> tiles;
+    juce::uint32 tileCounter = 0;
+
+    double averagePaintMs = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ScrollingWaveform)
+};
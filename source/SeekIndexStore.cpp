@@ -0,0 +1,93 @@
+#include "SeekIndexStore.h"
+#include "TrackKey.h"
+
+namespace
+{
+	const char* const entryExtension = ".seek";
+}
+
+SeekIndexStore::SeekIndexStore(const juce::File& _directory)
+	: directory(_directory)
+{
+}
+
+juce::File SeekIndexStore::getDefaultDirectory()
+{
+	return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+		.getChildFile("Otodecks")
+		.getChildFile("SeekIndexes");
+}
+
+std::shared_ptr<const Mp3SeekIndex> SeekIndexStore::load(const juce::String& key) const
+{
+	juce::MemoryBlock data;
+	if (key.isEmpty() || ! getEntryFile(key).loadFileAsData(data))
+	{
+		return nullptr;
+	}
+
+	juce::MemoryInputStream in(data, false);
+	return Mp3SeekIndex::readFrom(in);
+}
+
+bool SeekIndexStore::store(const juce::String& key, const Mp3SeekIndex& index)
+{
+	const juce::ScopedLock sl(writeLock);
+	if (key.isEmpty() || directory.createDirectory().failed())
+	{
+		return false;
+	}
+
+	// Write next to the entry and swap it in, so a crash never leaves a half written file
+	juce::File file = getEntryFile(key);
+	juce::TemporaryFile temp(file);
+	{
+		juce::FileOutputStream out(temp.getFile());
+		if (out.failedToOpen())
+		{
+			return false;
+		}
+
+		index.writeTo(out);
+		out.flush();
+		if (out.getStatus().failed())
+		{
+			return false;
+		}
+	}
+
+	return temp.overwriteTargetFileWithTemporary();
+}
+
+std::shared_ptr<const Mp3SeekIndex> SeekIndexStore::getIndexFor(const juce::File& file)
+{
+	if (! file.hasFileExtension("mp3"))
+	{
+		return nullptr;
+	}
+
+	juce::String key = TrackKey::forFile(file);
+	std::shared_ptr<const Mp3SeekIndex> index = load(key);
+	if (index != nullptr && index->getFileSize() == file.getSize())
+	{
+		return index;
+	}
+
+	juce::FileInputStream in(file);
+	if (! in.openedOk())
+	{
+		return nullptr;
+	}
+	std::unique_ptr<Mp3SeekIndex> built = Mp3SeekIndex::build(in);
+	if (built == nullptr)
+	{
+		return nullptr;
+	}
+	store(key, *built);
+	return std::shared_ptr<const Mp3SeekIndex>(std::move(built));
+}
+
+juce::File SeekIndexStore::getEntryFile(const juce::String& key) const
+{
+	return directory.getChildFile(key + entryExtension);
+}
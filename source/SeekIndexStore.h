@@ -0,0 +1,36 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory>
+#include "Mp3SeekIndex.h"
+
+// MP3 seek indexes kept on disk, one file per track named after its TrackKey,
+// so the library only has to remember which tracks have one. An index is read
+// back when its track is prepared for a deck or analysed, never all at once.
+class SeekIndexStore
+{
+public:
+    SeekIndexStore(const juce::File& _directory);
+
+    // Default location of the store in the user's application data folder
+    static juce::File getDefaultDirectory();
+
+    // The stored index for the key, or nullptr if there is none (any thread)
+    std::shared_ptr<const Mp3SeekIndex> load(const juce::String& key) const;
+
+    // Returns false if the index could not be written (any thread)
+    bool store(const juce::String& key, const Mp3SeekIndex& index);
+
+    // The index of an MP3 file, built from the file and stored when there is none
+    // or it no longer matches. nullptr for anything that is not MP3 audio (any thread).
+    std::shared_ptr<const Mp3SeekIndex> getIndexFor(const juce::File& file);
+
+private:
+    juce::File getEntryFile(const juce::String& key) const;
+
+    juce::File directory;
+    // Held while writing so two workers do not swap in the same entry at once
+    juce::CriticalSection writeLock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SeekIndexStore)
+};
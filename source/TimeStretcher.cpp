@@ -0,0 +1,280 @@
+#include "TimeStretcher.h"
+#include <cstring>
+
+TimeStretcher::TimeStretcher(juce::AudioSource* _input, int _numChannels)
+	: input(_input),
+	  numChannels(_numChannels)
+{
+	jassert(input != nullptr);
+}
+
+TimeStretcher::~TimeStretcher()
+{
+}
+
+void TimeStretcher::setEnabled(bool shouldBeEnabled)
+{
+	// Start from a clean state each time, whatever was buffered belongs to the old setting
+	if (shouldBeEnabled != enabled)
+	{
+		enabled = shouldBeEnabled;
+		reset();
+	}
+}
+
+void TimeStretcher::setTempo(double tempoRatio)
+{
+	tempo = juce::jlimit(minTempo, maxTempo, tempoRatio);
+}
+
+void TimeStretcher::flush()
+{
+	if (enabled)
+	{
+		reset();
+	}
+}
+
+//==============================================================================
+void TimeStretcher::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+	blockSize = juce::jmax(1, samplesPerBlockExpected);
+	input->prepareToPlay(blockSize, sampleRate);
+
+	// About 20 ms frames at half overlap, searched a quarter frame either way
+	frameLength = juce::nextPowerOfTwo(juce::roundToInt(sampleRate * 0.02));
+	hopLength = frameLength / 2;
+	searchRange = frameLength / 4;
+
+	// Enough input for a frame at the furthest a transient lets it drift, plus a block being pulled
+	int capacity = frameLength * 6 + searchRange * 2 + blockSize;
+	history.setSize(numChannels, capacity);
+	monoHistory.allocate((size_t) capacity, true);
+	overlap.setSize(numChannels, frameLength);
+	output.setSize(numChannels, hopLength + blockSize);
+
+	// Periodic Hann, copies at half a frame apart add up to exactly one
+	window.allocate((size_t) frameLength, true);
+	for (int i = 0; i < frameLength; ++i)
+	{
+		window[i] = 0.5f - 0.5f * std::cos(juce::MathConstants<float>::twoPi * i / frameLength);
+	}
+
+	reset();
+}
+
+void TimeStretcher::releaseResources()
+{
+	input->releaseResources();
+	history.setSize(0, 0);
+	overlap.setSize(0, 0);
+	output.setSize(0, 0);
+	monoHistory.free();
+	window.free();
+	frameLength = 0;
+}
+
+void TimeStretcher::reset()
+{
+	if (frameLength == 0)
+	{
+		return;
+	}
+
+	// Start as if a frame of silence had just played, so the input fades in over the first hop
+	history.clear();
+	juce::FloatVectorOperations::clear(monoHistory, history.getNumSamples());
+	historyLength = hopLength;
+	previousFrame = 0;
+	idealPosition = 0.0;
+	overlap.clear();
+	outputLength = 0;
+}
+
+void TimeStretcher::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+	if (! enabled || frameLength == 0)
+	{
+		input->getNextAudioBlock(bufferToFill);
+		return;
+	}
+
+	int outputChannels = juce::jmin(numChannels, bufferToFill.buffer->getNumChannels());
+	for (int channel = outputChannels; channel < bufferToFill.buffer->getNumChannels(); ++channel)
+	{
+		bufferToFill.buffer->clear(channel, bufferToFill.startSample, bufferToFill.numSamples);
+	}
+
+	// Hand out finished output, making more a frame at a time
+	for (int done = 0; done < bufferToFill.numSamples;)
+	{
+		if (outputLength == 0)
+		{
+			processFrame();
+		}
+		int numSamples = juce::jmin(outputLength, bufferToFill.numSamples - done);
+		for (int channel = 0; channel < outputChannels; ++channel)
+		{
+			bufferToFill.buffer->copyFrom(channel, bufferToFill.startSample + done, output, channel, 0, numSamples);
+		}
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			float* samples = output.getWritePointer(channel);
+			std::memmove(samples, samples + numSamples, sizeof(float) * (size_t) (outputLength - numSamples));
+		}
+		outputLength -= numSamples;
+		done += numSamples;
+	}
+}
+
+//==============================================================================
+void TimeStretcher::processFrame()
+{
+	// The input that would follow the previous frame, and where the tempo wants this frame
+	int natural = previousFrame + hopLength;
+	idealPosition += hopLength * tempo;
+	int centre = juce::roundToInt(idealPosition);
+
+	int needed = juce::jmax(natural, centre + searchRange) + frameLength;
+	fillHistory(needed);
+
+	// Only follow a transient while the drift from the tempo stays within a frame
+	int frameStart;
+	if (std::abs(centre - natural) <= frameLength && isTransient(natural))
+	{
+		// Carry on from the previous frame untouched; the tempo catches up at the next search
+		frameStart = natural;
+	}
+	else
+	{
+		frameStart = centre + findBestOffset(natural, centre);
+	}
+
+	// Overlap-add the windowed frame
+	for (int channel = 0; channel < numChannels; ++channel)
+	{
+		float* sum = overlap.getWritePointer(channel);
+		const float* frame = history.getReadPointer(channel, frameStart);
+		for (int i = 0; i < frameLength; ++i)
+		{
+			sum[i] += frame[i] * window[i];
+		}
+	}
+
+	// The first hop now has every frame it will get, move it to the output
+	for (int channel = 0; channel < numChannels; ++channel)
+	{
+		output.copyFrom(channel, outputLength, overlap, channel, 0, hopLength);
+		float* sum = overlap.getWritePointer(channel);
+		std::memmove(sum, sum + hopLength, sizeof(float) * (size_t) (frameLength - hopLength));
+		juce::FloatVectorOperations::clear(sum + frameLength - hopLength, hopLength);
+	}
+	outputLength += hopLength;
+
+	previousFrame = frameStart;
+	discardHistory();
+}
+
+int TimeStretcher::findBestOffset(int natural, int centre) const
+{
+	// Compare candidates against the start of the natural continuation, first every
+	// fourth offset on every fourth sample, then every offset around the best one
+	const float* target = monoHistory + natural;
+	int length = hopLength;
+
+	auto correlate = [&](int offset, int step)
+	{
+		const float* candidate = monoHistory + centre + offset;
+		float sum = 0.0f;
+		for (int i = 0; i < length; i += step)
+		{
+			sum += candidate[i] * target[i];
+		}
+		return sum;
+	};
+
+	int lowest = juce::jmax(-searchRange, -centre);
+	int best = lowest;
+	float bestScore = correlate(lowest, 4);
+	for (int offset = lowest; offset <= searchRange; offset += 4)
+	{
+		float score = correlate(offset, 4);
+		if (score > bestScore)
+		{
+			bestScore = score;
+			best = offset;
+		}
+	}
+
+	int coarse = best;
+	bestScore = correlate(coarse, 1);
+	for (int offset = juce::jmax(lowest, coarse - 3); offset <= juce::jmin(searchRange, coarse + 3); ++offset)
+	{
+		float score = correlate(offset, 1);
+		if (score > bestScore)
+		{
+			bestScore = score;
+			best = offset;
+		}
+	}
+	return best;
+}
+
+bool TimeStretcher::isTransient(int natural) const
+{
+	// A jump in energy from the hop just played to the one coming up
+	float before = getEnergy(natural - hopLength, hopLength);
+	float after = getEnergy(natural, hopLength);
+	return after > 1.0e-4f * hopLength && after > before * 4.0f;
+}
+
+float TimeStretcher::getEnergy(int start, int length) const
+{
+	float sum = 0.0f;
+	for (int i = 0; i < length; i += 2)
+	{
+		sum += monoHistory[start + i] * monoHistory[start + i];
+	}
+	return sum * 2.0f;
+}
+
+void TimeStretcher::fillHistory(int length)
+{
+	jassert(length <= history.getNumSamples());
+	length = juce::jmin(length, history.getNumSamples());
+
+	while (historyLength < length)
+	{
+		int numSamples = juce::jmin(blockSize, length - historyLength);
+		juce::AudioSourceChannelInfo info(&history, historyLength, numSamples);
+		input->getNextAudioBlock(info);
+
+		// Mono mix for the search
+		juce::FloatVectorOperations::copy(monoHistory + historyLength, history.getReadPointer(0, historyLength), numSamples);
+		for (int channel = 1; channel < numChannels; ++channel)
+		{
+			juce::FloatVectorOperations::add(monoHistory + historyLength, history.getReadPointer(channel, historyLength), numSamples);
+		}
+		historyLength += numSamples;
+	}
+}
+
+void TimeStretcher::discardHistory()
+{
+	// The next frame needs the hop before its natural start and the search range before its centre
+	int keepFrom = juce::jmin(previousFrame, (int) idealPosition - searchRange);
+	if (keepFrom <= 0)
+	{
+		return;
+	}
+	keepFrom = juce::jmin(keepFrom, historyLength);
+	for (int channel = 0; channel < numChannels; ++channel)
+	{
+		float* samples = history.getWritePointer(channel);
+		std::memmove(samples, samples + keepFrom, sizeof(float) * (size_t) (historyLength - keepFrom));
+	}
+	std::memmove(monoHistory.get(), monoHistory + keepFrom, sizeof(float) * (size_t) (historyLength - keepFrom));
+	historyLength -= keepFrom;
+	previousFrame -= keepFrom;
+	idealPosition -= keepFrom;
+}
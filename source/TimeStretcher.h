@@ -0,0 +1,72 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+
+// Changes tempo without changing pitch using WSOLA: windowed frames are read
+// from the input at the tempo's pace and overlap-added at a fixed hop, each
+// frame nudged within a small search range to line up with the waveform of
+// the one before. The search is coarse then fine over a fixed range, so the
+// cost per output sample does not depend on the tempo. Frames starting on a
+// transient skip ahead with the input instead of being stretched, so drum
+// hits are not smeared or doubled.
+class TimeStretcher : public juce::AudioSource
+{
+public:
+    TimeStretcher(juce::AudioSource* _input, int _numChannels = 2);
+    ~TimeStretcher() override;
+
+    // When disabled the input passes straight through. Audio thread only.
+    void setEnabled(bool shouldBeEnabled);
+    // Input samples consumed per output sample, clamped to 0.25 - 4. Audio thread only.
+    void setTempo(double tempoRatio);
+    // Drop buffered input and output after the input jumps, so audio from before
+    // the jump is not played after it. Audio thread only.
+    void flush();
+
+    //==============================================================================
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+    static constexpr double minTempo = 0.25;
+    static constexpr double maxTempo = 4.0;
+
+private:
+    void reset();
+    void processFrame();
+    void fillHistory(int length);
+    void discardHistory();
+    int findBestOffset(int natural, int centre) const;
+    bool isTransient(int natural) const;
+    float getEnergy(int start, int length) const;
+
+    juce::AudioSource* input;
+    int numChannels;
+
+    bool enabled = false;
+    double tempo = 1.0;
+
+    // Frame sizes, picked in prepareToPlay so a frame lasts about 20 ms
+    int frameLength = 0;
+    int hopLength = 0;
+    int searchRange = 0;
+    int blockSize = 0;
+
+    // Input waiting to be read, with a mono copy for the alignment search
+    juce::AudioBuffer<float> history;
+    juce::HeapBlock<float> monoHistory;
+    int historyLength = 0;
+
+    // Where the previous frame started, and where the tempo says the next should
+    int previousFrame = 0;
+    double idealPosition = 0.0;
+
+    // Overlap-added frames, and finished output waiting to be handed out
+    juce::AudioBuffer<float> overlap;
+    juce::AudioBuffer<float> output;
+    int outputLength = 0;
+    juce::HeapBlock<float> window;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TimeStretcher)
+};
@@ -0,0 +1,162 @@
+#include "TrackAnalyser.h"
+#include "BeatDetector.h"
+#include "KeyDetector.h"
+#include "LoudnessMeter.h"
+#include "Mp3SeekingReader.h"
+
+//==============================================================================
+// Decodes one track and runs it through the detectors
+class TrackAnalyser::AnalysisJob : public juce::ThreadPoolJob
+{
+public:
+	AnalysisJob(TrackAnalyser& _owner, const ScannedTrack& _track)
+		: juce::ThreadPoolJob("Analyse " + _track.filepath),
+		  owner(_owner),
+		  filepath(_track.filepath),
+		  hasSeekIndex(_track.hasSeekIndex)
+	{
+	}
+
+	JobStatus runJob() override
+	{
+		// Read the way the decks do, so times in the results line up with playback
+		juce::File file{ filepath };
+		std::shared_ptr<const Mp3SeekIndex> seekIndex = hasSeekIndex ? owner.seekIndexStore.getIndexFor(file) : nullptr;
+		std::unique_ptr<juce::AudioFormatReader> reader = Mp3SeekingReader::createReaderFor(file, seekIndex, owner.formatManager);
+		if (reader == nullptr || reader->sampleRate <= 0)
+		{
+			// Left unanalysed, so it is tried again next session
+			DBG("TrackAnalyser - could not open " << filepath);
+		}
+		else if (! shouldExit())
+		{
+			Result result;
+			result.filepath = filepath;
+			result.analysis = TrackAnalyser::analyse(*reader, [this] { return shouldExit(); });
+			if (result.analysis.isAnalysed)
+			{
+				owner.addResult(std::move(result));
+			}
+		}
+
+		owner.jobFinished();
+		return jobHasFinished;
+	}
+
+private:
+	TrackAnalyser& owner;
+	juce::String filepath;
+	bool hasSeekIndex;
+};
+
+//==============================================================================
+TrackAnalyser::TrackAnalyser(juce::AudioFormatManager& _formatManager, SeekIndexStore& _seekIndexStore)
+	: formatManager(_formatManager),
+	  seekIndexStore(_seekIndexStore),
+	  pool(juce::SystemStats::getNumCpus())
+{
+}
+
+TrackAnalyser::~TrackAnalyser()
+{
+	cancel();
+}
+
+void TrackAnalyser::addTracks(const std::vector<ScannedTrack>& tracks)
+{
+	// Jobs start at once, without formats every track would fail to open
+	jassert(formatManager.getNumKnownFormats() > 0);
+
+	// Start counting progress again once the previous batch has completed
+	if (! isAnalysing())
+	{
+		numQueued = 0;
+		numFinished = 0;
+	}
+
+	for (const ScannedTrack& track : tracks)
+	{
+		if (! track.analysis.isAnalysed)
+		{
+			++numQueued;
+			pool.addJob(new AnalysisJob(*this, track), true);
+		}
+	}
+}
+
+void TrackAnalyser::cancel()
+{
+	// Removes jobs that have not started and waits for running ones to notice shouldExit().
+	// No time out, a job still running afterwards would count itself finished too late.
+	pool.removeAllJobs(true, -1);
+	numQueued = numFinished.load();
+}
+
+bool TrackAnalyser::isAnalysing() const
+{
+	return numFinished < numQueued;
+}
+
+double TrackAnalyser::getProgress() const
+{
+	int queued = numQueued;
+	return queued > 0 ? juce::jmin(1.0, (double) numFinished / queued) : 1.0;
+}
+
+std::vector<TrackAnalyser::Result> TrackAnalyser::takeResults()
+{
+	std::vector<Result> finished;
+	const juce::ScopedLock sl(resultLock);
+	finished.swap(results);
+	return finished;
+}
+
+TrackAnalysis TrackAnalyser::analyse(juce::AudioFormatReader& reader, const std::function<bool()>& shouldStop)
+{
+	TrackAnalysis analysis;
+	BeatDetector beatDetector(reader.sampleRate);
+	KeyDetector keyDetector(reader.sampleRate);
+
+	int numChannels = (int) juce::jlimit(1u, 2u, reader.numChannels);
+	LoudnessMeter loudnessMeter(reader.sampleRate, numChannels);
+	juce::AudioBuffer<float> buffer(numChannels, blockSize);
+	for (juce::int64 position = 0; position < reader.lengthInSamples; position += blockSize)
+	{
+		if (shouldStop())
+		{
+			return analysis;
+		}
+
+		int numSamples = (int) juce::jmin((juce::int64) blockSize, reader.lengthInSamples - position);
+		reader.read(&buffer, 0, numSamples, position, true, true);
+
+		// Loudness is measured on every channel, before the mix down
+		loudnessMeter.process(buffer.getArrayOfReadPointers(), numSamples);
+
+		// Mix down to mono in the first channel
+		if (numChannels > 1)
+		{
+			buffer.addFrom(0, 0, buffer, 1, 0, numSamples);
+			buffer.applyGain(0, 0, numSamples, 0.5f);
+		}
+		beatDetector.process(buffer.getReadPointer(0), numSamples);
+		keyDetector.process(buffer.getReadPointer(0), numSamples);
+	}
+
+	analysis.beatGrid = beatDetector.getBeatGrid();
+	analysis.key = keyDetector.getKey();
+	analysis.loudness = loudnessMeter.getLoudness();
+	analysis.isAnalysed = true;
+	return analysis;
+}
+
+void TrackAnalyser::addResult(Result result)
+{
+	const juce::ScopedLock sl(resultLock);
+	results.push_back(std::move(result));
+}
+
+void TrackAnalyser::jobFinished()
+{
+	++numFinished;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include "LibraryScanner.h"
+
+// Analyses library tracks on a pool with a thread per core. Each track is
+// decoded once, in blocks, and streamed through the detectors so memory stays
+// flat however long the track or large the library. Results are handed back
+// in batches through takeResults() to be stored with the tracks.
+class TrackAnalyser
+{
+public:
+    // MP3s are read through their index in _seekIndexStore
+    TrackAnalyser(juce::AudioFormatManager& _formatManager, SeekIndexStore& _seekIndexStore);
+    ~TrackAnalyser();
+
+    // Queue the tracks that have not been analysed yet
+    void addTracks(const std::vector<ScannedTrack>& tracks);
+
+    // Drop every queued analysis and stop the ones in flight
+    void cancel();
+
+    bool isAnalysing() const;
+
+    // Fraction of the queued tracks that have been analysed (0 - 1)
+    double getProgress() const;
+
+    struct Result
+    {
+        juce::String filepath;
+        TrackAnalysis analysis;
+    };
+
+    // Hand over the analyses finished since the last call (message thread)
+    std::vector<Result> takeResults();
+
+    // Analyse a whole track on the calling thread, the result is left
+    // unmarked as analysed if shouldStop returns true part way through
+    static TrackAnalysis analyse(juce::AudioFormatReader& reader, const std::function<bool()>& shouldStop);
+
+    // Samples decoded per read
+    static constexpr int blockSize = 16384;
+
+private:
+    class AnalysisJob;
+
+    void addResult(Result result);
+    void jobFinished();
+
+    juce::AudioFormatManager& formatManager;
+    SeekIndexStore& seekIndexStore;
+    juce::ThreadPool pool;
+
+    juce::CriticalSection resultLock;
+    std::vector<Result> results;
+
+    std::atomic<int> numQueued{ 0 };
+    std::atomic<int> numFinished{ 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TrackAnalyser)
+};
@@ -0,0 +1,27 @@
+#include "TrackKey.h"
+
+namespace
+{
+	// Bytes hashed from each end of a track, enough to tell tracks apart without reading them whole
+	const int hashedBytes = 256 * 1024;
+}
+
+juce::String TrackKey::forFile(const juce::File& audioFile)
+{
+	juce::FileInputStream in(audioFile);
+	if (in.failedToOpen())
+	{
+		return {};
+	}
+
+	juce::int64 size = in.getTotalLength();
+	juce::MemoryBlock content;
+	in.readIntoMemoryBlock(content, hashedBytes);
+	if (size > hashedBytes * 2)
+	{
+		in.setPosition(size - hashedBytes);
+	}
+	in.readIntoMemoryBlock(content, hashedBytes);
+
+	return juce::MD5(content).toHexString() + "-" + juce::String(size);
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Identifies a track by what is in it rather than where it is, so caches
+// still find a file after it has been renamed or moved
+namespace TrackKey
+{
+    // Hash of the start and end of the file plus its size, empty if the file cannot be read
+    juce::String forFile(const juce::File& audioFile);
+}
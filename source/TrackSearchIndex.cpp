@@ -0,0 +1,267 @@
+#include "TrackSearchIndex.h"
+#include <algorithm>
+
+namespace
+{
+	// Base letters for U+00E0 - U+00FF, '*' leaves the character as it is
+	const char latin1Folds[] = "aaaaaa*ceeeeiiiidnooooo*ouuuuy*y";
+
+	// Base letters for U+0100 - U+017F (Latin Extended-A), upper and lower case alike
+	const char latinExtendedFolds[] =
+		"aaaaaa" "cccccccc" "dddd" "eeeeeeeeee" "gggggggg" "hhhh" "iiiiiiiiii" "**" "jj" "kkk"
+		"llllllllll" "nnnnnnn" "nn" "oooooo" "**" "rrrrrr" "ssssssss" "tttttt" "uuuuuuuuuuuu"
+		"ww" "yyy" "zzzzzz" "s";
+
+	static_assert(sizeof(latin1Folds) == 33, "one entry per character from U+00E0 to U+00FF");
+	static_assert(sizeof(latinExtendedFolds) == 129, "one entry per character from U+0100 to U+017F");
+
+	juce::juce_wchar stripAccent(juce::juce_wchar c)
+	{
+		char folded = '*';
+		if (c >= 0xe0 && c <= 0xff)
+		{
+			folded = latin1Folds[c - 0xe0];
+		}
+		else if (c >= 0x100 && c <= 0x17f)
+		{
+			folded = latinExtendedFolds[c - 0x100];
+		}
+		return folded == '*' ? c : (juce::juce_wchar) folded;
+	}
+
+	std::vector<juce::juce_wchar> toCharacters(const juce::String& text)
+	{
+		std::vector<juce::juce_wchar> characters;
+		characters.reserve((size_t) text.getNumBytesAsUTF8());
+		for (auto p = text.getCharPointer(); ! p.isEmpty();)
+		{
+			characters.push_back(p.getAndAdvance());
+		}
+		return characters;
+	}
+
+	// Insert a row into a posting list, keeping it sorted and free of duplicates
+	void insertRow(std::vector<int>& rows, int row)
+	{
+		if (! rows.empty() && rows.back() < row)
+		{
+			rows.push_back(row);
+			return;
+		}
+		auto it = std::lower_bound(rows.begin(), rows.end(), row);
+		if (it == rows.end() || *it != row)
+		{
+			rows.insert(it, row);
+		}
+	}
+}
+
+//==============================================================================
+TrackSearchIndex::TrackSearchIndex()
+{
+}
+
+void TrackSearchIndex::addTitle(const juce::String& title)
+{
+	int row = (int) foldedTitles.size();
+	foldedTitles.push_back(fold(title));
+	removedRows.push_back(0);
+	indexRow(row);
+
+	// Keep the cached results of the last query valid for the new row
+	if (lastResultsValid && foldedTitles.back().contains(lastQuery))
+	{
+		lastResults.push_back(row);
+	}
+}
+
+void TrackSearchIndex::setTitle(int row, const juce::String& title)
+{
+	jassert(row >= 0 && row < getNumTitles());
+
+	juce::String folded = fold(title);
+	if (removedRows[(size_t) row] != 0 || folded == foldedTitles[(size_t) row])
+	{
+		return;
+	}
+
+	unindexRow(row);
+	foldedTitles[(size_t) row] = folded;
+	indexRow(row);
+	lastResultsValid = false;
+}
+
+void TrackSearchIndex::removeTitle(int row)
+{
+	jassert(row >= 0 && row < getNumTitles());
+
+	unindexRow(row);
+	foldedTitles[(size_t) row].clear();
+	removedRows[(size_t) row] = 1;
+	lastResultsValid = false;
+}
+
+void TrackSearchIndex::clear()
+{
+	foldedTitles.clear();
+	removedRows.clear();
+	postings.clear();
+	lastQuery.clear();
+	lastResults.clear();
+	lastResultsValid = false;
+}
+
+int TrackSearchIndex::getNumTitles() const
+{
+	return (int) foldedTitles.size();
+}
+
+const std::vector<int>& TrackSearchIndex::search(const juce::String& query)
+{
+	juce::String foldedQuery = fold(query);
+
+	if (lastResultsValid && foldedQuery == lastQuery)
+	{
+		return lastResults;
+	}
+
+	// A query that contains the previous one can only match a subset of its results
+	if (lastResultsValid && lastQuery.isNotEmpty() && foldedQuery.contains(lastQuery))
+	{
+		refine(foldedQuery);
+	}
+	else
+	{
+		searchAll(foldedQuery);
+	}
+
+	lastQuery = foldedQuery;
+	lastResultsValid = true;
+	return lastResults;
+}
+
+juce::String TrackSearchIndex::fold(const juce::String& text)
+{
+	juce::String folded;
+	folded.preallocateBytes((size_t) text.getNumBytesAsUTF8());
+	for (auto p = text.getCharPointer(); ! p.isEmpty();)
+	{
+		folded += stripAccent(juce::CharacterFunctions::toLowerCase(p.getAndAdvance()));
+	}
+	return folded;
+}
+
+//==============================================================================
+TrackSearchIndex::Trigram TrackSearchIndex::makeTrigram(juce::juce_wchar a, juce::juce_wchar b, juce::juce_wchar c)
+{
+	// Unicode code points fit in 21 bits, so three of them pack into one key
+	return ((Trigram) a << 42) | ((Trigram) b << 21) | (Trigram) c;
+}
+
+std::vector<TrackSearchIndex::Trigram> TrackSearchIndex::getKeys(const std::vector<juce::juce_wchar>& characters)
+{
+	std::vector<Trigram> keys;
+	keys.reserve(characters.size() * 3);
+	for (size_t i = 0; i < characters.size(); ++i)
+	{
+		keys.push_back(makeTrigram(0, 0, characters[i]));
+		if (i + 1 < characters.size())
+		{
+			keys.push_back(makeTrigram(0, characters[i], characters[i + 1]));
+		}
+		if (i + 2 < characters.size())
+		{
+			keys.push_back(makeTrigram(characters[i], characters[i + 1], characters[i + 2]));
+		}
+	}
+	return keys;
+}
+
+void TrackSearchIndex::indexRow(int row)
+{
+	for (Trigram key : getKeys(toCharacters(foldedTitles[(size_t) row])))
+	{
+		insertRow(postings[key], row);
+	}
+}
+
+void TrackSearchIndex::unindexRow(int row)
+{
+	for (Trigram key : getKeys(toCharacters(foldedTitles[(size_t) row])))
+	{
+		auto found = postings.find(key);
+		if (found == postings.end())
+		{
+			continue;
+		}
+		std::vector<int>& rows = found->second;
+		auto it = std::lower_bound(rows.begin(), rows.end(), row);
+		if (it != rows.end() && *it == row)
+		{
+			rows.erase(it);
+		}
+	}
+}
+
+void TrackSearchIndex::searchAll(const juce::String& foldedQuery)
+{
+	lastResults.clear();
+	std::vector<juce::juce_wchar> characters = toCharacters(foldedQuery);
+
+	// The empty query matches every title still in the index
+	if (characters.empty())
+	{
+		for (int row = 0; row < getNumTitles(); ++row)
+		{
+			if (removedRows[(size_t) row] == 0)
+			{
+				lastResults.push_back(row);
+			}
+		}
+		return;
+	}
+
+	// One or two characters are indexed on their own, their posting list is the answer
+	if (characters.size() < 3)
+	{
+		Trigram key = characters.size() == 1 ? makeTrigram(0, 0, characters[0])
+											 : makeTrigram(0, characters[0], characters[1]);
+		auto found = postings.find(key);
+		if (found != postings.end())
+		{
+			lastResults = found->second;
+		}
+		return;
+	}
+
+	// Start from the rarest trigram of the query, a title missing any trigram cannot match
+	const std::vector<int>* candidates = nullptr;
+	for (size_t i = 0; i + 2 < characters.size(); ++i)
+	{
+		auto found = postings.find(makeTrigram(characters[i], characters[i + 1], characters[i + 2]));
+		if (found == postings.end() || found->second.empty())
+		{
+			return;
+		}
+		if (candidates == nullptr || found->second.size() < candidates->size())
+		{
+			candidates = &found->second;
+		}
+	}
+
+	// Confirm the candidates, the trigrams may appear in a different order
+	for (int row : *candidates)
+	{
+		if (foldedTitles[(size_t) row].contains(foldedQuery))
+		{
+			lastResults.push_back(row);
+		}
+	}
+}
+
+void TrackSearchIndex::refine(const juce::String& foldedQuery)
+{
+	auto end = std::remove_if(lastResults.begin(), lastResults.end(),
+		[this, &foldedQuery](int row) { return ! foldedTitles[(size_t) row].contains(foldedQuery); });
+	lastResults.erase(end, lastResults.end());
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Trigram index over track titles, with the single characters and pairs of
+// characters of each title indexed too so one and two character queries are
+// answered straight from their posting list. Titles are folded to lower case without
+// accents when added, so queries match regardless of case or accents, and a
+// query that only extends the previous one refines the previous results
+// instead of searching the whole library again.
+class TrackSearchIndex
+{
+public:
+    TrackSearchIndex();
+
+    // Index the title of the next row, rows must be added in order starting at 0
+    void addTitle(const juce::String& title);
+
+    // Change the title of a row that has already been added
+    void setTitle(int row, const juce::String& title);
+
+    // Stop a row from matching any query, the row number stays taken
+    void removeTitle(int row);
+
+    // Remove every title from the index
+    void clear();
+
+    int getNumTitles() const;
+
+    // Rows whose title contains the query, in ascending order. An empty query matches every row.
+    const std::vector<int>& search(const juce::String& query);
+
+    // Lower case the text and strip accents from latin letters
+    static juce::String fold(const juce::String& text);
+
+private:
+    using Trigram = std::uint64_t;
+
+    static Trigram makeTrigram(juce::juce_wchar a, juce::juce_wchar b, juce::juce_wchar c);
+    // Keys of every character, pair and trigram in the text. Pairs and single
+    // characters are keyed as trigrams padded with zeros, which no title contains.
+    static std::vector<Trigram> getKeys(const std::vector<juce::juce_wchar>& characters);
+    void indexRow(int row);
+    void unindexRow(int row);
+    void searchAll(const juce::String& foldedQuery);
+    void refine(const juce::String& foldedQuery);
+
+    // Folded copy of every title, used to confirm candidate rows
+    std::vector<juce::String> foldedTitles;
+    std::vector<std::uint8_t> removedRows;
+    // Rows containing each key, kept in ascending order
+    std::unordered_map<Trigram, std::vector<int>> postings;
+
+    // Previous query and its results, used to refine queries that only grow
+    juce::String lastQuery;
+    std::vector<int> lastResults;
+    bool lastResultsValid = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TrackSearchIndex)
+};
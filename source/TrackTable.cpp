@@ -0,0 +1,171 @@
+#include "TrackTable.h"
+
+TrackTable::TrackTable()
+{
+}
+
+TrackId TrackTable::addOrUpdate(const ScannedTrack& track)
+{
+	TrackId id = find(track.filepath);
+	if (id == invalidTrack)
+	{
+		juce::File file{ track.filepath };
+		id = getNumIds();
+		idsByPathHash.emplace(file.getFullPathName().hashCode64(), id);
+
+		folderColumn.push_back(internFolder(juce::File::addTrailingSeparator(file.getParentDirectory().getFullPathName())));
+		fileNameColumn.push_back(file.getFileName());
+		titleColumn.emplace_back();
+		durationColumn.push_back(0.0);
+		fileSizeColumn.push_back(0);
+		modificationTimeColumn.push_back(0);
+		seekIndexColumn.push_back(0);
+		analysisColumn.emplace_back();
+		hotCuesColumn.push_back(track.hotCues);
+		removedColumn.push_back(0);
+	}
+
+	titleColumn[(size_t) id] = titlePool.getPooledString(track.title);
+	durationColumn[(size_t) id] = track.durationSeconds;
+	fileSizeColumn[(size_t) id] = track.fileSize;
+	modificationTimeColumn[(size_t) id] = track.modificationTime;
+	seekIndexColumn[(size_t) id] = track.hasSeekIndex ? 1 : 0;
+	analysisColumn[(size_t) id] = track.analysis;
+	return id;
+}
+
+void TrackTable::remove(TrackId id)
+{
+	if (isValid(id))
+	{
+		auto range = idsByPathHash.equal_range(getFilepath(id).hashCode64());
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			if (it->second == id)
+			{
+				idsByPathHash.erase(it);
+				break;
+			}
+		}
+		removedColumn[(size_t) id] = 1;
+	}
+}
+
+TrackId TrackTable::find(const juce::String& filepath) const
+{
+	// Paths are compared in the same normalised form they were added with
+	juce::File file{ filepath };
+	juce::String folder = juce::File::addTrailingSeparator(file.getParentDirectory().getFullPathName());
+	juce::String fileName = file.getFileName();
+
+	auto range = idsByPathHash.equal_range(file.getFullPathName().hashCode64());
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		if (hasPath(it->second, folder, fileName))
+		{
+			return it->second;
+		}
+	}
+	return invalidTrack;
+}
+
+bool TrackTable::hasPath(TrackId id, const juce::String& folder, const juce::String& fileName) const
+{
+	return fileNameColumn[(size_t) id] == fileName && folders[folderColumn[(size_t) id]] == folder;
+}
+
+bool TrackTable::isValid(TrackId id) const
+{
+	return id >= 0 && id < getNumIds() && removedColumn[(size_t) id] == 0;
+}
+
+int TrackTable::getNumIds() const
+{
+	return (int) removedColumn.size();
+}
+
+juce::String TrackTable::getFilepath(TrackId id) const
+{
+	// Folders end in a separator, so the path is the two joined
+	return folders[folderColumn[(size_t) id]] + fileNameColumn[(size_t) id];
+}
+
+const juce::String& TrackTable::getTitle(TrackId id) const
+{
+	return titleColumn[(size_t) id];
+}
+
+double TrackTable::getDuration(TrackId id) const
+{
+	return durationColumn[(size_t) id];
+}
+
+juce::int64 TrackTable::getFileSize(TrackId id) const
+{
+	return fileSizeColumn[(size_t) id];
+}
+
+juce::int64 TrackTable::getModificationTime(TrackId id) const
+{
+	return modificationTimeColumn[(size_t) id];
+}
+
+bool TrackTable::hasSeekIndex(TrackId id) const
+{
+	return seekIndexColumn[(size_t) id] != 0;
+}
+
+const TrackAnalysis& TrackTable::getAnalysis(TrackId id) const
+{
+	return analysisColumn[(size_t) id];
+}
+
+const HotCues& TrackTable::getHotCues(TrackId id) const
+{
+	return hotCuesColumn[(size_t) id];
+}
+
+void TrackTable::setAnalysis(TrackId id, const TrackAnalysis& analysis)
+{
+	analysisColumn[(size_t) id] = analysis;
+}
+
+void TrackTable::setHotCues(TrackId id, const HotCues& hotCues)
+{
+	hotCuesColumn[(size_t) id] = hotCues;
+}
+
+std::vector<ScannedTrack> TrackTable::getTracks() const
+{
+	std::vector<ScannedTrack> tracks;
+	tracks.reserve((size_t) getNumIds());
+	for (TrackId id = 0; id < getNumIds(); ++id)
+	{
+		if (! isValid(id))
+		{
+			continue;
+		}
+		ScannedTrack track;
+		track.filepath = getFilepath(id);
+		track.title = getTitle(id);
+		track.durationSeconds = getDuration(id);
+		track.fileSize = getFileSize(id);
+		track.modificationTime = getModificationTime(id);
+		track.hasSeekIndex = hasSeekIndex(id);
+		track.analysis = getAnalysis(id);
+		track.hotCues = getHotCues(id);
+		tracks.push_back(std::move(track));
+	}
+	return tracks;
+}
+
+int TrackTable::internFolder(const juce::String& folder)
+{
+	if (folderIndices.contains(folder))
+	{
+		return folderIndices[folder];
+	}
+	folders.add(folder);
+	folderIndices.set(folder, folders.size() - 1);
+	return folders.size() - 1;
+}
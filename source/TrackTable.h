@@ -0,0 +1,85 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "LibraryScanner.h"
+
+// Identifies a track in the TrackTable. Ids are never reused or moved
+// while the application runs, so views and deck queues can hold on to them.
+using TrackId = int;
+
+// Column store holding the library, one vector per field indexed by TrackId.
+// Folder names and titles are interned so repeated strings share storage, and
+// paths are looked up by hash so no full path is stored anywhere.
+class TrackTable
+{
+public:
+    static constexpr TrackId invalidTrack = -1;
+
+    TrackTable();
+
+    // Add a probed file, or update its details if the path is already in the table.
+    // The hot cues of a track already in the table are kept.
+    TrackId addOrUpdate(const ScannedTrack& track);
+
+    // Remove a track, its id stays reserved so existing references simply become invalid
+    void remove(TrackId id);
+
+    // Id of the track with the given path, or invalidTrack
+    TrackId find(const juce::String& filepath) const;
+
+    bool isValid(TrackId id) const;
+
+    // Number of ids handed out, including removed tracks
+    int getNumIds() const;
+
+    juce::String getFilepath(TrackId id) const;
+    const juce::String& getTitle(TrackId id) const;
+    double getDuration(TrackId id) const;
+    juce::int64 getFileSize(TrackId id) const;
+    juce::int64 getModificationTime(TrackId id) const;
+    // Whether the track's MP3 seek index is in the SeekIndexStore
+    bool hasSeekIndex(TrackId id) const;
+    const TrackAnalysis& getAnalysis(TrackId id) const;
+    const HotCues& getHotCues(TrackId id) const;
+
+    // Store the analysis of a track, a new probe of its file clears it again
+    void setAnalysis(TrackId id, const TrackAnalysis& analysis);
+    // Hot cues are set by hand, so unlike the analysis they survive a new probe
+    void setHotCues(TrackId id, const HotCues& hotCues);
+
+    // Details of every track still in the table, in id order
+    std::vector<ScannedTrack> getTracks() const;
+
+private:
+    int internFolder(const juce::String& folder);
+    // Whether the track was added with this folder, as interned, and file name
+    bool hasPath(TrackId id, const juce::String& folder, const juce::String& fileName) const;
+
+    juce::StringPool titlePool;
+
+    // Distinct folders with a trailing separator, tracks refer to them by index
+    juce::StringArray folders;
+    juce::HashMap<juce::String, int> folderIndices;
+
+    // One entry per TrackId
+    std::vector<int> folderColumn;
+    std::vector<juce::String> fileNameColumn;
+    std::vector<juce::String> titleColumn;
+    std::vector<double> durationColumn;
+    std::vector<juce::int64> fileSizeColumn;
+    std::vector<juce::int64> modificationTimeColumn;
+    std::vector<std::uint8_t> seekIndexColumn;
+    std::vector<TrackAnalysis> analysisColumn;
+    std::vector<HotCues> hotCuesColumn;
+    std::vector<std::uint8_t> removedColumn;
+
+    // Hash of each track's full path, confirmed against the folder and file name
+    // columns since different paths can share a hash
+    std::unordered_multimap<juce::int64, TrackId> idsByPathHash;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TrackTable)
+};
@@ -0,0 +1,110 @@
+#include "WaveformDiskCache.h"
+#include <algorithm>
+
+namespace
+{
+	const char* const entryExtension = ".wfp";
+}
+
+WaveformDiskCache::WaveformDiskCache(const juce::File& _directory, juce::int64 _maxBytes)
+	: directory(_directory),
+	  maxBytes(_maxBytes)
+{
+}
+
+juce::File WaveformDiskCache::getDefaultDirectory()
+{
+	return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+		.getChildFile("Otodecks")
+		.getChildFile("WaveformCache");
+}
+
+std::unique_ptr<WaveformPyramid> WaveformDiskCache::load(const juce::String& key)
+{
+	juce::File file = getEntryFile(key);
+	std::unique_ptr<WaveformPyramid> pyramid = WaveformPyramid::mapFile(file);
+	if (pyramid != nullptr)
+	{
+		// The modification time doubles as the last use for eviction
+		file.setLastModificationTime(juce::Time::getCurrentTime());
+	}
+	return pyramid;
+}
+
+bool WaveformDiskCache::store(const juce::String& key, const WaveformPyramid& pyramid)
+{
+	const juce::ScopedLock sl(writeLock);
+	if (directory.createDirectory().failed())
+	{
+		return false;
+	}
+
+	// Write next to the entry and swap it in, so a crash never leaves a half written file
+	juce::File file = getEntryFile(key);
+	juce::TemporaryFile temp(file);
+	{
+		juce::FileOutputStream out(temp.getFile());
+		if (out.failedToOpen() || ! pyramid.writeTo(out))
+		{
+			return false;
+		}
+
+		out.flush();
+		if (out.getStatus().failed())
+		{
+			return false;
+		}
+	}
+
+	if (! temp.overwriteTargetFileWithTemporary())
+	{
+		return false;
+	}
+	evict();
+	return true;
+}
+
+void WaveformDiskCache::setMaxBytes(juce::int64 newMaxBytes)
+{
+	maxBytes = juce::jmax((juce::int64) 0, newMaxBytes);
+	const juce::ScopedLock sl(writeLock);
+	evict();
+}
+
+juce::File WaveformDiskCache::getEntryFile(const juce::String& key) const
+{
+	return directory.getChildFile(key + entryExtension);
+}
+
+void WaveformDiskCache::evict()
+{
+	juce::Array<juce::File> entries = directory.findChildFiles(juce::File::findFiles, false, juce::String("*") + entryExtension);
+
+	juce::int64 total = 0;
+	for (const juce::File& entry : entries)
+	{
+		total += entry.getSize();
+	}
+	if (total <= maxBytes)
+	{
+		return;
+	}
+
+	// Oldest use first. A file still mapped elsewhere may refuse to go, it is tried again next time.
+	std::sort(entries.begin(), entries.end(), [](const juce::File& a, const juce::File& b)
+	{
+		return a.getLastModificationTime() < b.getLastModificationTime();
+	});
+	for (const juce::File& entry : entries)
+	{
+		if (total <= maxBytes)
+		{
+			break;
+		}
+		juce::int64 size = entry.getSize();
+		if (entry.deleteFile())
+		{
+			total -= size;
+		}
+	}
+}
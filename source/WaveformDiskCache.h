@@ -0,0 +1,40 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <memory>
+#include "WaveformPyramid.h"
+
+// Waveform pyramids kept on disk between launches. Entries are named after the
+// track's TrackKey, so a renamed or moved file still finds its waveform, and
+// read back through a memory-mapped file. When the
+// cache grows past its byte budget the least recently used entries go first.
+class WaveformDiskCache
+{
+public:
+    WaveformDiskCache(const juce::File& _directory, juce::int64 _maxBytes = defaultMaxBytes);
+
+    // Default location of the cache in the user's application data folder
+    static juce::File getDefaultDirectory();
+
+    // The cached pyramid for the key, or nullptr if there is none (any thread)
+    std::unique_ptr<WaveformPyramid> load(const juce::String& key);
+
+    // Add a pyramid and evict old entries past the budget, returns false if it could not be written (any thread)
+    bool store(const juce::String& key, const WaveformPyramid& pyramid);
+
+    void setMaxBytes(juce::int64 newMaxBytes);
+
+    static constexpr juce::int64 defaultMaxBytes = 256 * 1024 * 1024;
+
+private:
+    juce::File getEntryFile(const juce::String& key) const;
+    void evict();
+
+    juce::File directory;
+    std::atomic<juce::int64> maxBytes;
+    // Held while writing or evicting so two workers do not delete under each other
+    juce::CriticalSection writeLock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveformDiskCache)
+};
@@ -2,21 +2,24 @@
 #include "WaveformDisplay.h"
 
 //==============================================================================
-WaveformDisplay::WaveformDisplay(juce::AudioFormatManager& formatManagerToUse,
-                                 juce::AudioThumbnailCache& cacheToUse
-                                ) : audioThumb(1000, formatManagerToUse, cacheToUse), 
+WaveformDisplay::WaveformDisplay(WaveformLoader& loaderToUse
+                                ) : loader(loaderToUse),
                                     fileLoaded(false), 
                                     position(0)
 {
-    audioThumb.addChangeListener(this);
+    addAndMakeVisible(zoomedView);
+    loader.addChangeListener(this);
 }
 
 WaveformDisplay::~WaveformDisplay()
 {
+    loader.removeChangeListener(this);
 }
 
 void WaveformDisplay::paint(juce::Graphics& g)
 {
+    juce::int64 startTicks = juce::Time::getHighResolutionTicks();
+
     g.fillAll(getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId));// Clear the background
 
     g.setColour(juce::Colours::grey);
@@ -25,24 +28,32 @@ void WaveformDisplay::paint(juce::Graphics& g)
     g.setColour(juce::Colours::orange);
     if (fileLoaded) 
     {
-        // Draw the waveforms
-        g.setColour(juce::Colours::rosybrown);
-        audioThumb.drawChannel(g,
-            getLocalBounds(), // Area
-            0, // Start time
-            audioThumb.getTotalLength(), // Length of file as end time
-            0,
-            1.0f
-        );
+        // Draw the waveform, rendered once and copied from then on
+        if (waveform != nullptr)
+        {
+            if (overviewImage.isNull() && ! overviewArea.isEmpty())
+            {
+                overviewImage = juce::Image(juce::Image::ARGB, overviewArea.getWidth(), overviewArea.getHeight(), true);
+                juce::Graphics overview(overviewImage);
+                waveform->draw(overview,
+                    overviewImage.getBounds(), // Area
+                    0, // Start time
+                    waveform->getLengthInSeconds(), // Length of file as end time
+                    juce::Colours::rosybrown,
+                    juce::Colours::rosybrown.brighter(0.4f)
+                );
+            }
+            g.drawImageAt(overviewImage, overviewArea.getX(), overviewArea.getY());
+        }
 
         // Draw the playhead
         g.setColour(juce::Colours::floralwhite);
-        g.fillRect(position * getWidth(), 0, 2, getHeight());
+        g.fillRect(getPlayheadArea(position).withTrimmedLeft(1).withTrimmedRight(1));
 
         // Display the name of currently playing track on the waveform
         g.setColour(juce::Colours::floralwhite);
         g.setFont(16.0f);
-        g.drawText(nowPlaying, getLocalBounds(),
+        g.drawText(nowPlaying, overviewArea,
             juce::Justification::centred, true);
     }
     else 
@@ -50,51 +61,91 @@ void WaveformDisplay::paint(juce::Graphics& g)
         // File is not loaded 
         g.setColour(juce::Colours::rosybrown);
         g.setFont(20.0f);
-        g.drawText("Load File to Channel to Begin...", getLocalBounds(),
+        g.drawText("Load File to Channel to Begin...", overviewArea,
             juce::Justification::centred, true);
     }
+
+    double paintMs = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks) * 1000.0;
+    averagePaintMs += (paintMs - averagePaintMs) * 0.1;
 }
 
 void WaveformDisplay::setPositionRelative(double pos) 
 {
-    if (pos != position) 
+    zoomedView.setPositionRelative(pos);
+
+    // Only the old and new playhead strips need painting, not the whole overview
+    juce::Rectangle<int> oldArea = getPlayheadArea(position);
+    juce::Rectangle<int> newArea = getPlayheadArea(pos);
+    position = pos;
+    if (newArea != oldArea) 
     {
-        position = pos;
-        repaint();
+        repaint(oldArea);
+        repaint(newArea);
     }
 }
 
+double WaveformDisplay::getAveragePaintMs() const
+{
+    return averagePaintMs + zoomedView.getAveragePaintMs();
+}
+
+juce::Rectangle<int> WaveformDisplay::getPlayheadArea(double pos) const
+{
+    // A pixel either side of the 2 pixel line
+    return { overviewArea.getX() + (int) (pos * overviewArea.getWidth()) - 1, overviewArea.getY(), 4, overviewArea.getHeight() };
+}
+
+void WaveformDisplay::setWaveform(std::shared_ptr<const WaveformPyramid> newWaveform)
+{
+    waveform = std::move(newWaveform);
+    zoomedView.setWaveform(waveform);
+    overviewImage = juce::Image();
+    repaint();
+}
+
 void WaveformDisplay::loadURL(juce::URL audioURL)
 {
-    audioThumb.clear();
-    fileLoaded = audioThumb.setSource(new juce::URLInputSource(audioURL));
+    // A preloaded track has been building since it was queued, and may already be done
+    currentURL = audioURL;
+    setWaveform(loader.getWaveform(audioURL));
+    fileLoaded = ! audioURL.isEmpty();
 
     if (fileLoaded)
     {
-        audioThumb.clear();
-        fileLoaded = audioThumb.setSource(new juce::URLInputSource(audioURL));
-        if (fileLoaded)
-        {
-            std::string justFile = audioURL.toString(false).toStdString();
-            std::size_t startFilePos = justFile.find_last_of("/");
-            std::size_t startExtPos = justFile.find_last_of(".");
-            std::string extn = justFile.substr(startExtPos + 1, justFile.length() - startExtPos);
-            std::string file = justFile.substr(startFilePos + 1, justFile.length() - startFilePos - extn.size() - 2);
-
-            nowPlaying = file;
-            repaint();
-        }
-        else
-        {
-        }
+        std::string justFile = audioURL.toString(false).toStdString();
+        std::size_t startFilePos = justFile.find_last_of("/");
+        std::size_t startExtPos = justFile.find_last_of(".");
+        std::string extn = justFile.substr(startExtPos + 1, justFile.length() - startExtPos);
+        std::string file = justFile.substr(startFilePos + 1, justFile.length() - startFilePos - extn.size() - 2);
+
+        nowPlaying = file;
     }
+    repaint();
+}
+
+void WaveformDisplay::preloadURL(juce::URL audioURL)
+{
+    // The loader decodes it on its own threads and keeps it until it is loaded
+    loader.getWaveform(audioURL);
 }
 
 void WaveformDisplay::resized()
 {
+    juce::Rectangle<int> area = getLocalBounds();
+    zoomedView.setBounds(area.removeFromTop(getHeight() * 3 / 5));
+    overviewArea = area.reduced(1);
+    overviewImage = juce::Image();
 }
 
 void WaveformDisplay::changeListenerCallback(juce::ChangeBroadcaster* source) 
 {
-    repaint();
+    // Some waveform has finished, pick ours up if it was still being built
+    if (waveform == nullptr && fileLoaded)
+    {
+        std::shared_ptr<const WaveformPyramid> finished = loader.getWaveform(currentURL);
+        if (finished != nullptr)
+        {
+            setWaveform(std::move(finished));
+        }
+    }
 }
\ No newline at end of file
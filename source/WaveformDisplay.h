@@ -1,13 +1,15 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include <memory>
+#include "WaveformLoader.h"
+#include "ScrollingWaveform.h"
 
 class WaveformDisplay  : public juce::Component, 
                          public juce::ChangeListener
 {
     public:
-        WaveformDisplay(juce::AudioFormatManager& formatManagerToUse,
-                        juce::AudioThumbnailCache& cacheToUse);
+        WaveformDisplay(WaveformLoader& loaderToUse);
         ~WaveformDisplay() override;
 
         void paint (juce::Graphics&) override;
@@ -15,12 +17,32 @@ class WaveformDisplay  : public juce::Component,
 
         void changeListenerCallback(juce::ChangeBroadcaster* source) override;
 
+        // Shows the track's waveform, drawn as soon as the loader has built it
         void loadURL(juce::URL audioURL);
+        // Start building the waveform of the next track in the background
+        void preloadURL(juce::URL audioURL);
+        // Moves the playheads, repainting only the strips they leave and enter
         void setPositionRelative(double pos);
 
+        // Smoothed paint time of the overview and zoomed view together, in milliseconds
+        double getAveragePaintMs() const;
+
     private:
 
-        juce::AudioThumbnail audioThumb;
+        WaveformLoader& loader;
+
+        juce::URL currentURL;
+        std::shared_ptr<const WaveformPyramid> waveform;
+
+        // Zoomed view along the top, the whole track is drawn underneath
+        ScrollingWaveform zoomedView;
+        juce::Rectangle<int> overviewArea;
+        // The overview waveform drawn once per track and size
+        juce::Image overviewImage;
+        double averagePaintMs = 0.0;
+
+        void setWaveform(std::shared_ptr<const WaveformPyramid> newWaveform);
+        juce::Rectangle<int> getPlayheadArea(double pos) const;
         double position;
         std::string nowPlaying;
         bool fileLoaded;
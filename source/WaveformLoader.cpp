@@ -0,0 +1,147 @@
+#include "WaveformLoader.h"
+#include <algorithm>
+#include "TrackKey.h"
+#include "Mp3SeekingReader.h"
+
+//==============================================================================
+// Decodes one track into a pyramid and hands it back to the loader
+class WaveformLoader::BuildJob : public juce::ThreadPoolJob
+{
+public:
+	BuildJob(WaveformLoader& _owner, const juce::URL& _url)
+		: juce::ThreadPoolJob("Waveform " + _url.toString(false)),
+		  owner(_owner),
+		  url(_url)
+	{
+	}
+
+	JobStatus runJob() override
+	{
+		// A track seen before, even under another name, is mapped straight from the cache
+		juce::String key;
+		std::unique_ptr<WaveformPyramid> waveform;
+		if ((owner.diskCache != nullptr || owner.pcmCache != nullptr) && url.isLocalFile())
+		{
+			key = TrackKey::forFile(url.getLocalFile());
+		}
+		if (owner.diskCache != nullptr && key.isNotEmpty())
+		{
+			waveform = owner.diskCache->load(key);
+		}
+
+		if (waveform == nullptr)
+		{
+			// The deck's decoded copy saves decoding the file a second time
+			std::unique_ptr<juce::AudioFormatReader> reader;
+			if (owner.pcmCache != nullptr && key.isNotEmpty())
+			{
+				reader = owner.pcmCache->createReader(key);
+			}
+			if (reader == nullptr && url.isLocalFile())
+			{
+				// Through the seek index, so the encoder delay is trimmed the same as on the decks
+				juce::File file = url.getLocalFile();
+				std::shared_ptr<const Mp3SeekIndex> seekIndex;
+				if (owner.seekIndexStore != nullptr)
+				{
+					seekIndex = owner.seekIndexStore->getIndexFor(file);
+				}
+				reader = Mp3SeekingReader::createReaderFor(file, std::move(seekIndex), owner.formatManager);
+			}
+			else if (reader == nullptr)
+			{
+				reader.reset(owner.formatManager.createReaderFor(url.createInputStream(false)));
+			}
+			if (reader != nullptr)
+			{
+				waveform = WaveformPyramid::build(*reader, [this] { return shouldExit(); });
+			}
+			if (waveform != nullptr && owner.diskCache != nullptr && key.isNotEmpty())
+			{
+				owner.diskCache->store(key, *waveform);
+			}
+		}
+
+		if (! shouldExit())
+		{
+			owner.jobFinished(url, std::move(waveform));
+		}
+		return jobHasFinished;
+	}
+
+private:
+	WaveformLoader& owner;
+	juce::URL url;
+};
+
+//==============================================================================
+WaveformLoader::WaveformLoader(juce::AudioFormatManager& _formatManager,
+							   WaveformDiskCache* _diskCache,
+							   PcmCache* _pcmCache,
+							   SeekIndexStore* _seekIndexStore)
+	: formatManager(_formatManager),
+	  diskCache(_diskCache),
+	  pcmCache(_pcmCache),
+	  seekIndexStore(_seekIndexStore)
+{
+}
+
+WaveformLoader::~WaveformLoader()
+{
+	pool.removeAllJobs(true, 5000);
+}
+
+std::shared_ptr<const WaveformPyramid> WaveformLoader::getWaveform(const juce::URL& url)
+{
+	if (url.isEmpty())
+	{
+		return nullptr;
+	}
+	juce::String key = url.toString(false);
+
+	{
+		const juce::ScopedLock sl(lock);
+		for (size_t i = 0; i < cache.size(); ++i)
+		{
+			if (cache[i].url == url)
+			{
+				// Move it to the front so it is the last to be dropped
+				std::rotate(cache.begin(), cache.begin() + (long) i, cache.begin() + (long) i + 1);
+				return cache.front().waveform;
+			}
+		}
+
+		// Unreadable files are not tried again on every repaint
+		if (building.contains(key) || failed.contains(key))
+		{
+			return nullptr;
+		}
+		building.add(key);
+	}
+
+	pool.addJob(new BuildJob(*this, url), true);
+	return nullptr;
+}
+
+void WaveformLoader::jobFinished(const juce::URL& url, std::shared_ptr<const WaveformPyramid> waveform)
+{
+	{
+		const juce::ScopedLock sl(lock);
+		building.removeString(url.toString(false));
+		if (waveform == nullptr)
+		{
+			failed.addIfNotAlreadyThere(url.toString(false));
+		}
+		else
+		{
+			cache.insert(cache.begin(), Entry{ url, std::move(waveform) });
+			if ((int) cache.size() > maxCachedWaveforms)
+			{
+				cache.pop_back();
+			}
+		}
+	}
+
+	// Safe from any thread, listeners are called back on the message thread
+	sendChangeMessage();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory>
+#include <vector>
+#include "WaveformPyramid.h"
+#include "WaveformDiskCache.h"
+#include "PcmCache.h"
+#include "SeekIndexStore.h"
+
+// Builds waveform pyramids on background threads and keeps the most recently
+// used ones, shared by both decks. With a disk cache, local tracks are looked
+// up there before being decoded and stored there afterwards. A track already
+// in the PCM cache is read from its decoded copy instead of decoded again, and an
+// MP3 is read through its seek index so it lines up with the decks. A change message
+// is sent whenever a pyramid is finished; listeners then ask again for the one
+// they want.
+class WaveformLoader : public juce::ChangeBroadcaster
+{
+public:
+    WaveformLoader(juce::AudioFormatManager& _formatManager,
+                   WaveformDiskCache* _diskCache = nullptr,
+                   PcmCache* _pcmCache = nullptr,
+                   SeekIndexStore* _seekIndexStore = nullptr);
+    ~WaveformLoader() override;
+
+    // The pyramid for the track if it has been built, otherwise nullptr and
+    // the build is started (message thread)
+    std::shared_ptr<const WaveformPyramid> getWaveform(const juce::URL& url);
+
+    static constexpr int maxCachedWaveforms = 8;
+
+private:
+    class BuildJob;
+
+    // Called from a worker thread, waveform is nullptr if the file could not be read
+    void jobFinished(const juce::URL& url, std::shared_ptr<const WaveformPyramid> waveform);
+
+    struct Entry
+    {
+        juce::URL url;
+        std::shared_ptr<const WaveformPyramid> waveform;
+    };
+
+    juce::AudioFormatManager& formatManager;
+    WaveformDiskCache* diskCache;
+    PcmCache* pcmCache;
+    SeekIndexStore* seekIndexStore;
+    juce::ThreadPool pool{ 2 };
+
+    // Most recently used first
+    juce::CriticalSection lock;
+    std::vector<Entry> cache;
+    juce::StringArray building;
+    juce::StringArray failed;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveformLoader)
+};
@@ -0,0 +1,249 @@
+#include "WaveformPyramid.h"
+
+namespace
+{
+	// Identifies a pyramid file, bump the version whenever the layout changes.
+	// Version 1 pyramids of MP3s still had the encoder delay at the start.
+	const juce::int32 pyramidMagic = 0x50574f44; // "DOWP"
+	const juce::int32 pyramidVersion = 2;
+	// Magic, version, levels, bin size, factor, spare, length, sample rate
+	const int headerSize = 6 * 4 + 8 + 8;
+}
+
+WaveformPyramid::WaveformPyramid(juce::int64 _lengthInSamples, double _sampleRate)
+	: lengthInSamples(juce::jmax((juce::int64) 0, _lengthInSamples)),
+	  sampleRate(_sampleRate)
+{
+	static_assert(sizeof(Bin) == 3 * sizeof(float), "Bins are written to disk as three floats");
+
+	int samplesPerBin = baseSamplesPerBin;
+	for (Level& level : levels)
+	{
+		level.samplesPerBin = samplesPerBin;
+		level.offset = totalBins;
+		level.numBins = (size_t) ((lengthInSamples + samplesPerBin - 1) / samplesPerBin);
+		totalBins += level.numBins;
+		samplesPerBin *= levelFactor;
+	}
+}
+
+std::unique_ptr<WaveformPyramid> WaveformPyramid::build(juce::AudioFormatReader& reader,
+														const std::function<bool()>& shouldStop)
+{
+	if (reader.sampleRate <= 0 || reader.lengthInSamples <= 0)
+	{
+		return nullptr;
+	}
+
+	std::unique_ptr<WaveformPyramid> pyramid(new WaveformPyramid(reader.lengthInSamples, reader.sampleRate));
+	pyramid->storage.resize(pyramid->totalBins);
+	pyramid->bins = pyramid->storage.data();
+
+	// Whole bins per read, so a bin never straddles two blocks
+	const int blockSize = baseSamplesPerBin * 1024;
+	juce::AudioBuffer<float> buffer((int) juce::jlimit((unsigned int) 1, (unsigned int) 2, reader.numChannels), blockSize);
+
+	for (juce::int64 position = 0; position < reader.lengthInSamples; position += blockSize)
+	{
+		if (shouldStop != nullptr && shouldStop())
+		{
+			return nullptr;
+		}
+
+		int numSamples = (int) juce::jmin((juce::int64) blockSize, reader.lengthInSamples - position);
+		if (! reader.read(&buffer, 0, numSamples, position, true, true))
+		{
+			return nullptr;
+		}
+		pyramid->addBlock(buffer, numSamples, position);
+	}
+
+	pyramid->buildUpperLevels();
+	return pyramid;
+}
+
+void WaveformPyramid::addBlock(const juce::AudioBuffer<float>& buffer, int numSamples, juce::int64 startSample)
+{
+	Bin* base = storage.data() + levels[0].offset;
+	size_t firstBin = (size_t) (startSample / baseSamplesPerBin);
+	int numChannels = buffer.getNumChannels();
+
+	for (int offset = 0; offset < numSamples; offset += baseSamplesPerBin)
+	{
+		int binLength = juce::jmin(baseSamplesPerBin, numSamples - offset);
+		Bin& bin = base[firstBin + (size_t) (offset / baseSamplesPerBin)];
+		float sumOfSquares = 0.0f;
+
+		for (int channel = 0; channel < numChannels; ++channel)
+		{
+			const float* samples = buffer.getReadPointer(channel, offset);
+			juce::Range<float> range = juce::FloatVectorOperations::findMinAndMax(samples, binLength);
+			bin.min = channel == 0 ? range.getStart() : juce::jmin(bin.min, range.getStart());
+			bin.max = channel == 0 ? range.getEnd() : juce::jmax(bin.max, range.getEnd());
+
+			for (int i = 0; i < binLength; ++i)
+			{
+				sumOfSquares += samples[i] * samples[i];
+			}
+		}
+		bin.meanSquare = sumOfSquares / (float) (binLength * numChannels);
+	}
+}
+
+void WaveformPyramid::buildUpperLevels()
+{
+	// Each bin merges the bins below it, so no level needs the audio again
+	for (int index = 1; index < numLevels; ++index)
+	{
+		const Bin* below = storage.data() + levels[index - 1].offset;
+		Bin* merging = storage.data() + levels[index].offset;
+
+		for (size_t i = 0; i < levels[index].numBins; ++i)
+		{
+			size_t first = i * levelFactor;
+			size_t last = juce::jmin(first + levelFactor, levels[index - 1].numBins);
+			Bin merged = below[first];
+			float sumOfSquares = 0.0f;
+			for (size_t j = first; j < last; ++j)
+			{
+				merged.min = juce::jmin(merged.min, below[j].min);
+				merged.max = juce::jmax(merged.max, below[j].max);
+				sumOfSquares += below[j].meanSquare;
+			}
+			merged.meanSquare = sumOfSquares / (float) (last - first);
+			merging[i] = merged;
+		}
+	}
+}
+
+bool WaveformPyramid::writeTo(juce::OutputStream& out) const
+{
+	out.writeInt(pyramidMagic);
+	out.writeInt(pyramidVersion);
+	out.writeInt(numLevels);
+	out.writeInt(baseSamplesPerBin);
+	out.writeInt(levelFactor);
+	out.writeInt(0);
+	out.writeInt64(lengthInSamples);
+	out.writeDouble(sampleRate);
+
+	// The bins go out as they are in memory so they can be mapped straight back
+	return out.write(bins, totalBins * sizeof(Bin));
+}
+
+std::unique_ptr<WaveformPyramid> WaveformPyramid::mapFile(const juce::File& file)
+{
+	std::unique_ptr<juce::MemoryMappedFile> mapped(new juce::MemoryMappedFile(file, juce::MemoryMappedFile::readOnly));
+	if (mapped->getData() == nullptr || mapped->getSize() < (size_t) headerSize)
+	{
+		return nullptr;
+	}
+
+	juce::MemoryInputStream in(mapped->getData(), (size_t) headerSize, false);
+	if (in.readInt() != pyramidMagic || in.readInt() != pyramidVersion || in.readInt() != numLevels
+		|| in.readInt() != baseSamplesPerBin || in.readInt() != levelFactor)
+	{
+		DBG("WaveformPyramid::mapFile - " << file.getFullPathName() << " is not a waveform of this version");
+		return nullptr;
+	}
+	in.readInt();
+	juce::int64 length = in.readInt64();
+	double rate = in.readDouble();
+
+	std::unique_ptr<WaveformPyramid> pyramid(new WaveformPyramid(length, rate));
+	if (length <= 0 || rate <= 0 || mapped->getSize() != headerSize + pyramid->totalBins * sizeof(Bin))
+	{
+		return nullptr;
+	}
+
+	pyramid->bins = reinterpret_cast<const Bin*>(static_cast<const char*>(mapped->getData()) + headerSize);
+	pyramid->mappedFile = std::move(mapped);
+	return pyramid;
+}
+
+const WaveformPyramid::Bin* WaveformPyramid::getBins(const Level& level) const
+{
+	return bins + level.offset;
+}
+
+juce::int64 WaveformPyramid::getLengthInSamples() const
+{
+	return lengthInSamples;
+}
+
+double WaveformPyramid::getSampleRate() const
+{
+	return sampleRate;
+}
+
+double WaveformPyramid::getLengthInSeconds() const
+{
+	return sampleRate > 0 ? lengthInSamples / sampleRate : 0.0;
+}
+
+WaveformPyramid::Peak WaveformPyramid::getPeak(juce::int64 startSample, juce::int64 endSample) const
+{
+	Peak peak;
+	startSample = juce::jmax((juce::int64) 0, startSample);
+	endSample = juce::jmin(lengthInSamples, endSample);
+	if (endSample <= startSample)
+	{
+		return peak;
+	}
+
+	// The coarsest level whose bins are no wider than the range, so a few bins cover it
+	int index = 0;
+	while (index + 1 < numLevels && levels[index + 1].samplesPerBin <= endSample - startSample)
+	{
+		++index;
+	}
+
+	const Level& level = levels[index];
+	const Bin* levelBins = getBins(level);
+	size_t first = (size_t) (startSample / level.samplesPerBin);
+	size_t last = juce::jmin(level.numBins, (size_t) ((endSample + level.samplesPerBin - 1) / level.samplesPerBin));
+	if (first >= last)
+	{
+		return peak;
+	}
+
+	peak.min = levelBins[first].min;
+	peak.max = levelBins[first].max;
+	float sumOfSquares = 0.0f;
+	for (size_t i = first; i < last; ++i)
+	{
+		peak.min = juce::jmin(peak.min, levelBins[i].min);
+		peak.max = juce::jmax(peak.max, levelBins[i].max);
+		sumOfSquares += levelBins[i].meanSquare;
+	}
+	peak.rms = std::sqrt(sumOfSquares / (float) (last - first));
+	return peak;
+}
+
+void WaveformPyramid::draw(juce::Graphics& g, juce::Rectangle<int> area, double startTime, double endTime,
+						   juce::Colour peakColour, juce::Colour rmsColour) const
+{
+	if (area.isEmpty() || endTime <= startTime)
+	{
+		return;
+	}
+
+	double samplesPerPixel = (endTime - startTime) * sampleRate / area.getWidth();
+	float centre = (float) area.getCentreY();
+	float halfHeight = area.getHeight() * 0.5f;
+
+	for (int x = 0; x < area.getWidth(); ++x)
+	{
+		juce::int64 start = (juce::int64) (startTime * sampleRate + x * samplesPerPixel);
+		juce::int64 end = juce::jmax(start + 1, (juce::int64) (startTime * sampleRate + (x + 1) * samplesPerPixel));
+		Peak peak = getPeak(start, end);
+		float top = centre - juce::jlimit(-1.0f, 1.0f, peak.max) * halfHeight;
+		float bottom = centre - juce::jlimit(-1.0f, 1.0f, peak.min) * halfHeight;
+		float rms = juce::jmin(1.0f, peak.rms) * halfHeight;
+
+		g.setColour(peakColour);
+		g.drawVerticalLine(area.getX() + x, top, juce::jmax(top + 1.0f, bottom));
+		g.setColour(rmsColour);
+		g.drawVerticalLine(area.getX() + x, centre - rms, centre + rms);
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Min, max and RMS of a track at several zoom levels, built in one pass over
+// the decoded audio. The finest level summarises every 64 samples and each
+// level above it is four times coarser, so any width can be drawn from the
+// level closest to one bin per pixel without going back to the file.
+class WaveformPyramid
+{
+public:
+    // Both channels together over a range of samples
+    struct Peak
+    {
+        float min = 0.0f;
+        float max = 0.0f;
+        float rms = 0.0f;
+    };
+
+    static constexpr int baseSamplesPerBin = 64;
+    static constexpr int levelFactor = 4;
+    static constexpr int numLevels = 6;
+
+    WaveformPyramid(juce::int64 _lengthInSamples, double _sampleRate);
+
+    // Decodes the reader from start to end. Returns nullptr if the reader fails
+    // or shouldStop returns true part way through.
+    static std::unique_ptr<WaveformPyramid> build(juce::AudioFormatReader& reader,
+                                                  const std::function<bool()>& shouldStop);
+
+    // Write the pyramid as a file that mapFile can read back without copying the bins
+    bool writeTo(juce::OutputStream& out) const;
+    // Returns nullptr if the file is missing or was not written by writeTo
+    static std::unique_ptr<WaveformPyramid> mapFile(const juce::File& file);
+
+    juce::int64 getLengthInSamples() const;
+    double getSampleRate() const;
+    double getLengthInSeconds() const;
+
+    Peak getPeak(juce::int64 startSample, juce::int64 endSample) const;
+
+    // One vertical line per pixel from startTime to endTime, peaks behind RMS
+    void draw(juce::Graphics& g, juce::Rectangle<int> area, double startTime, double endTime,
+              juce::Colour peakColour, juce::Colour rmsColour) const;
+
+private:
+    struct Bin
+    {
+        float min = 0.0f;
+        float max = 0.0f;
+        float meanSquare = 0.0f;
+    };
+
+    // Bins of every level one after the other, finest first
+    struct Level
+    {
+        int samplesPerBin = 0;
+        size_t offset = 0;
+        size_t numBins = 0;
+    };
+
+    const Bin* getBins(const Level& level) const;
+    void addBlock(const juce::AudioBuffer<float>& buffer, int numSamples, juce::int64 startSample);
+    void buildUpperLevels();
+
+    juce::int64 lengthInSamples;
+    double sampleRate;
+    Level levels[numLevels];
+    size_t totalBins = 0;
+
+    // The bins live in storage when built, or in the mapped file when read from disk
+    std::vector<Bin> storage;
+    std::unique_ptr<juce::MemoryMappedFile> mappedFile;
+    const Bin* bins = nullptr;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveformPyramid)
+};